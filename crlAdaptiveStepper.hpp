@@ -0,0 +1,313 @@
+/***************************************************************************
+ * crlAdaptiveStepper.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * エージェントごとに刻み幅を変える適応的な駆動（マルチレート）
+ *   crlAdaptiveStepper stepper;
+ *   stepper.set_contact(true);             // 刻みごとに接触を解決する
+ *   stepper.drive(world, SAMPLING_TIME, [&](crlAgentArray &w, const std::vector<int> &active, double h) {
+ *       for (int i : active) w.u(0)[i] = ...; // 刻み h で駆動する直前に，active の入力を現在の状態から計算し直す
+ *   });
+ * 1ステップ (smpl_time) の間に進み得る距離と，近傍のエージェントとの隙間から
+ * エージェントごとの刻み数 (1, 2, 4, ..., 2^max_level) を決める。
+ * 刻みごとにコールバックで入力（相互作用の力）を計算し直し，接触も刻みごとに解決するので，
+ * 近接したエージェントほど細かい刻みで相互作用・接触を評価する。各エージェントは1ステップに1回だけ駆動され，
+ * drive() の終了時には全エージェントが同じ時刻にそろう（smpl_time より粗い刻みは使わない）。
+ *****************************************************************************/
+
+#ifndef CRL_ADAPTIVE_STEPPER_HPP
+#define CRL_ADAPTIVE_STEPPER_HPP
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "crlAgentArray.hpp"
+#include "crlSpatialGrid.hpp"
+#include "crlCollision.hpp"
+
+#define ADAPTIVE_LEVEL_MAX 8 // 刻み数の上限 2^ADAPTIVE_LEVEL_MAX
+
+template<int DIM>
+class crlAdaptiveStepperT {
+    crlSpatialGridT<DIM> m_grid; // ステップ開始時の位置
+    bool m_grid_valid;
+    int m_max_level; // 刻み数の上限 2^m_max_level
+    double m_ratio; // 1刻みで進む距離の上限（隙間に対する比）
+    bool m_contact; // 刻みごとに接触を解決する
+    double m_restitution; // 反発係数
+    std::vector<int> m_level; // エージェントごとの刻み数 2^level
+    std::vector<double> m_reach; // 1ステップで進み得る距離
+    std::vector<double> m_ext; // 半径 + 1ステップで進み得る距離
+    double m_reach_max; // m_ext の最大値
+    std::vector<double> m_p0[DIM]; // ステップ開始位置
+    std::vector<double> m_q0[DIM], m_dr[DIM]; // 刻みの開始位置・移動量
+    std::vector<long> m_mark; // 刻みで駆動中の印
+    long m_stamp;
+    std::vector<int> m_group[ADAPTIVE_LEVEL_MAX + 1]; // level ごとのエージェント
+    std::vector<double> m_toi;
+    std::vector<int> m_partner;
+    int m_level_num[ADAPTIVE_LEVEL_MAX + 1]; // level ごとのエージェント数
+    int m_contact_num;
+
+public:
+    crlAdaptiveStepperT() {
+        m_grid_valid = false;
+        m_max_level = 4;
+        m_ratio = 0.5;
+        m_contact = false;
+        m_restitution = 0.0;
+        m_reach_max = 0.0;
+        m_stamp = 0;
+        for (int l = 0; l <= ADAPTIVE_LEVEL_MAX; l++)
+            m_level_num[l] = 0;
+        m_contact_num = 0;
+    }
+
+    bool set_max_level(int level) {
+        if (level < 0 || level > ADAPTIVE_LEVEL_MAX) {
+            std::cerr << "#error: level: " << level << " is out of [0, " << ADAPTIVE_LEVEL_MAX << "]";
+            std::cerr << " @crlAdaptiveStepper::set_max_level()" << std::endl;
+            return false;
+        }
+        m_max_level = level;
+        return true;
+    }
+
+    bool set_ratio(double ratio) {
+        if (ratio <= 0.0 || ratio > 1.0) {
+            std::cerr << "#error: ratio: " << ratio << " is out of (0, 1]. @crlAdaptiveStepper::set_ratio()";
+            std::cerr << std::endl;
+            return false;
+        }
+        m_ratio = ratio;
+        return true;
+    }
+
+    void set_contact(bool contact) { m_contact = contact; }
+
+    bool set_restitution(double e) {
+        if (e < 0.0 || e > 1.0) {
+            std::cerr << "#error: restitution: " << e << " is out of [0, 1]. @crlAdaptiveStepper::set_restitution()";
+            std::cerr << std::endl;
+            return false;
+        }
+        m_restitution = e;
+        return true;
+    }
+
+    int get_max_level() const { return m_max_level; }
+
+    // 直前の drive() での i 番目のエージェントの刻み数
+    int get_substep(int i) const { return 1 << m_level[i]; }
+
+    // 直前の drive() で刻み数 2^level だったエージェント数
+    int get_level_num(int level) const { return m_level_num[level]; }
+
+    // 直前の drive() で接触を解決した回数
+    int get_contact_num() const { return m_contact_num; }
+
+    // i の現在位置から距離 r 以内にあり得るエージェント j（i 自身を含む）について f(j)
+    //   drive() のコールバック内で使う（候補のみ・距離判定は呼び出し側）
+    template<class F>
+    void query(const crlAgentArrayT<DIM> &world, const int i, const double r, F f) const {
+        if (!m_grid_valid) {
+            for (int j = 0; j < world.size(); j++)
+                f(j);
+            return;
+        }
+        double p[DIM];
+        for (int d = 0; d < DIM; d++)
+            p[d] = m_p0[d][i];
+        m_grid.query(p, r + m_ext[i] + m_reach_max, f); // ステップ開始からの移動分を広げる
+    }
+
+    // 刻み数を決める（drive() から呼ばれる。入力 u(d) を書き込んだ後に呼ぶこと）
+    void schedule(const crlAgentArrayT<DIM> &world, const double smpl_time) {
+        const int num = world.size();
+        const ac::field_environment_t &env = world.get_env();
+        double f_size[DIM];
+        for (int d = 0; d < DIM; d++)
+            f_size[d] = ac::field_max(env, d) - ac::field_min(env, d);
+        m_level.assign(num, 0);
+        m_reach.resize(num);
+        m_ext.resize(num);
+        for (int l = 0; l <= ADAPTIVE_LEVEL_MAX; l++) {
+            m_group[l].clear();
+            m_level_num[l] = 0;
+        }
+        m_grid_valid = false;
+
+        // 1ステップで進み得る距離: min(V_MAX, |v| + (G U_MAX / M) smpl_time) smpl_time
+        m_reach_max = 0.0;
+        for (int i = 0; i < num; i++) {
+            double v = 0.0;
+            for (int d = 0; d < DIM; d++)
+                v += world.vel(d)[i] * world.vel(d)[i];
+            v = sqrt(v) + world.get_input_gain(i) * world.get_u_max(i) / world.get_M(i) * smpl_time;
+            m_reach[i] = std::min(world.get_v_max(i), v) * smpl_time;
+            m_ext[i] = world.get_radius(i) + m_reach[i];
+            if (m_ext[i] > m_reach_max) m_reach_max = m_ext[i];
+        }
+        const bool use_grid = m_max_level > 0 || m_contact;
+        if (num >= 2 && use_grid && m_reach_max > 0.0 && m_grid.init(env, 2.0 * m_reach_max)) {
+            m_grid.build(world);
+            for (int d = 0; d < DIM; d++)
+                m_p0[d].assign(world.pos(d), world.pos(d) + num);
+            m_grid_valid = true;
+        }
+
+        for (int i = 0; i < num; i++) {
+            // 近傍との隙間 gap に対して reach / 2^level <= ratio * gap となる最小の level
+            bool near = false;
+            double gap = 0.0;
+            if (m_grid_valid) {
+                const double ri = m_ext[i];
+                double p[DIM];
+                for (int d = 0; d < DIM; d++)
+                    p[d] = world.pos(d)[i];
+                m_grid.query(p, m_ext[i] + m_reach_max, [&](int j) {
+                    if (j == i) return;
+                    double n = 0.0;
+                    for (int d = 0; d < DIM; d++) {
+                        double dx = ac::min_image(world.pos(d)[j] - p[d], f_size[d]);
+                        n += dx * dx;
+                    }
+                    n = sqrt(n);
+                    if (n >= ri + world.get_radius(j) + m_reach[j]) return; // このステップ中には接近しない
+                    double g = n - world.get_radius(i) - world.get_radius(j);
+                    if (!near || g < gap) gap = g;
+                    near = true;
+                });
+            }
+            int level = 0;
+            if (near) {
+                if (gap <= 0.0) gap = 0.0; // 既に重なっている: 上限の刻み数
+                while (level < m_max_level && m_reach[i] / (1 << level) > m_ratio * gap)
+                    level++;
+            }
+            m_level[i] = level;
+            m_level_num[level]++;
+            m_group[level].push_back(i);
+        }
+    }
+
+    // 全エージェントを smpl_time だけ進める
+    //   刻み h で駆動する直前に substep(world, active, h) を呼ぶ（active: これから駆動するエージェント）
+    //   level l のエージェントは刻み smpl_time / 2^l で 2^l 回，細かい刻みほど後に駆動する
+    template<class F>
+    bool drive(crlAgentArrayT<DIM> &world, const double smpl_time, F substep) {
+        schedule(world, smpl_time);
+        const int num = world.size();
+        m_contact_num = 0;
+        if ((int) m_group[0].size() == num) { // 全員が1刻み: 一括駆動
+            substep(world, m_group[0], smpl_time);
+            if (m_contact) begin_group(world, m_group[0]);
+            if (!world.drive_all(smpl_time)) return false;
+            if (m_contact) m_contact_num += resolve_group(world, m_group[0], smpl_time);
+        } else {
+            int top = 0;
+            for (int l = 0; l <= m_max_level; l++)
+                if (!m_group[l].empty()) top = l;
+            const int S = 1 << top;
+            for (int s = 0; s < S; s++) {
+                for (int l = 0; l <= top; l++) {
+                    if (m_group[l].empty() || s % (S >> l) != 0) continue;
+                    const double h = smpl_time / (1 << l);
+                    substep(world, m_group[l], h);
+                    if (m_contact) begin_group(world, m_group[l]);
+                    for (int i : m_group[l]) {
+                        if (l == 0) world.drive_scalar(i, smpl_time);
+                        else world.drive_substeps(i, h, 1);
+                    }
+                    if (m_contact) m_contact_num += resolve_group(world, m_group[l], h);
+                }
+            }
+        }
+        return true;
+    }
+
+    // 入力 u(d) は呼び出し側で書き込み済み（刻みごとに計算し直さない）
+    bool drive(crlAgentArrayT<DIM> &world, const double smpl_time) {
+        return drive(world, smpl_time, [](crlAgentArrayT<DIM> &, const std::vector<int> &, double) {});
+    }
+
+private:
+    // 刻みの開始位置を保存
+    void begin_group(const crlAgentArrayT<DIM> &world, const std::vector<int> &active) {
+        const int num = world.size();
+        for (int d = 0; d < DIM; d++) {
+            m_q0[d].resize(num);
+            m_dr[d].resize(num);
+            for (int i : active)
+                m_q0[d][i] = world.pos(d)[i];
+        }
+    }
+
+    // 刻み h の間に active が他のエージェントに接触したら解決する（crlCollision::resolve() と同じ応答）
+    //   active 以外のエージェントは現在位置に止まっているものとして扱う
+    int resolve_group(crlAgentArrayT<DIM> &world, const std::vector<int> &active, const double h) {
+        if (!m_grid_valid) return 0;
+        const int num = world.size();
+        const ac::field_environment_t &env = world.get_env();
+        double f_min[DIM], f_size[DIM];
+        for (int d = 0; d < DIM; d++) {
+            f_min[d] = ac::field_min(env, d);
+            f_size[d] = ac::field_max(env, d) - ac::field_min(env, d);
+        }
+        m_mark.resize(num, 0);
+        m_stamp++;
+        for (int i : active) {
+            m_mark[i] = m_stamp;
+            for (int d = 0; d < DIM; d++)
+                m_dr[d][i] = ac::min_image(world.pos(d)[i] - m_q0[d][i], f_size[d]);
+        }
+        // 相手 j の刻みの開始位置（i からの相対位置）と移動量
+        auto relative = [&](int i, int j, double *r0, double *drj) {
+            const bool moving = (m_mark[j] == m_stamp);
+            for (int d = 0; d < DIM; d++) {
+                r0[d] = ac::min_image((moving ? m_q0[d][j] : world.pos(d)[j]) - m_q0[d][i], f_size[d]);
+                drj[d] = moving ? m_dr[d][j] : 0.0;
+            }
+        };
+        const int n = (int) active.size();
+        m_toi.assign(n, 2.0);
+        m_partner.assign(n, -1);
+        for (int k = 0; k < n; k++) {
+            const int i = active[k];
+            query(world, i, 0.0, [&](int j) {
+                if (j == i) return;
+                double r0[DIM], drj[DIM], v[DIM];
+                relative(i, j, r0, drj);
+                for (int d = 0; d < DIM; d++)
+                    v[d] = drj[d] - m_dr[d][i];
+                const double t = crlCollisionT<DIM>::contact_time(r0, v, world.get_radius(i) + world.get_radius(j));
+                if (t > 1.0) return;
+                if (t < m_toi[k] || (t == m_toi[k] && j < m_partner[k])) {
+                    m_toi[k] = t;
+                    m_partner[k] = j;
+                }
+            });
+        }
+        int contact = 0;
+        for (int k = 0; k < n; k++) {
+            if (m_partner[k] < 0) continue;
+            const int i = active[k];
+            double p0[DIM], dri[DIM], r0[DIM], drj[DIM];
+            relative(i, m_partner[k], r0, drj);
+            for (int d = 0; d < DIM; d++) {
+                p0[d] = m_q0[d][i];
+                dri[d] = m_dr[d][i];
+            }
+            crlCollisionT<DIM>::slide(world, i, p0, dri, r0, drj, m_toi[k], h, m_restitution, f_min, f_size);
+            contact++;
+        }
+        return contact;
+    }
+};
+
+typedef crlAdaptiveStepperT<U_SIZE> crlAdaptiveStepper; // 2次元
+
+#endif // CRL_ADAPTIVE_STEPPER_HPP
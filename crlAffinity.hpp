@@ -0,0 +1,120 @@
+/***************************************************************************
+ * crlAffinity.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * スレッドの CPU への固定 (affinity) と NUMA のファーストタッチ配置
+ *   std::vector<int> cpu;
+ *   ac::parse_cpu_list("0-3,8", cpu);   // CPU 番号の並び（"0-3,8" → 0, 1, 2, 3, 8）
+ *   ac::set_affinity(th, cpu);          // std::thread th を cpu のいずれかで実行する
+ *   ac::set_affinity_self(cpu);         // 呼び出したスレッドを固定
+ * Linux 以外では固定しない（警告を出して false を返す）。
+ * Linux はメモリのページを最初に書き込んだスレッドの NUMA ノードに割り当てる（ファーストタッチ）。
+ * ac::first_touch_allocator<T> は resize() で要素を初期化しない（ページに触れない）ので，
+ * 確保した後で各ワーカーが自分の受け持ち範囲を書き込めば，その範囲はワーカーのノードに置かれる。
+ *****************************************************************************/
+
+#ifndef CRL_AFFINITY_HPP
+#define CRL_AFFINITY_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <memory>
+#include <utility>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define CPU_LIST_MAX 1024 // CPU 番号の上限（CPU_SETSIZE）
+
+namespace agentcore {
+
+    // CPU 番号の並び "0-3,8" を読む（空文字列なら空の並び）
+    bool parse_cpu_list(const char *s, std::vector<int> &cpu) {
+        cpu.clear();
+        if (s == nullptr) return true;
+        const std::string str(s);
+        size_t p = 0;
+        while (p < str.size()) {
+            size_t q = str.find(',', p);
+            if (q == std::string::npos) q = str.size();
+            const std::string tok = str.substr(p, q - p);
+            p = q + 1;
+            if (tok.empty()) continue;
+            char *end;
+            long lo = strtol(tok.c_str(), &end, 10), hi = lo;
+            if (*end == '-') hi = strtol(end + 1, &end, 10);
+            if (end == tok.c_str() || *end != '\0' || lo < 0 || hi < lo || hi >= CPU_LIST_MAX) {
+                std::cerr << "#error: invalid cpu list: \"" << str << "\" @ac::parse_cpu_list()" << std::endl;
+                cpu.clear();
+                return false;
+            }
+            for (long c = lo; c <= hi; c++)
+                cpu.push_back((int) c);
+        }
+        return true;
+    }
+
+    // スレッド th を cpu のいずれかで実行する（cpu が空なら何もしない）
+    bool set_affinity(std::thread::native_handle_type th, const std::vector<int> &cpu) {
+        if (cpu.empty()) return true;
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : cpu)
+            CPU_SET(c, &set);
+        const int err = pthread_setaffinity_np(th, sizeof(set), &set);
+        if (err != 0) {
+            std::cerr << "#error: pthread_setaffinity_np: " << err << " @ac::set_affinity()" << std::endl;
+            return false;
+        }
+        return true;
+#else
+        (void) th;
+        std::cerr << "#warning: thread affinity is not supported. @ac::set_affinity()" << std::endl;
+        return false;
+#endif
+    }
+
+    bool set_affinity(std::thread &th, const std::vector<int> &cpu) {
+        return set_affinity(th.native_handle(), cpu);
+    }
+
+    bool set_affinity_self(const std::vector<int> &cpu) {
+#ifdef __linux__
+        return set_affinity(pthread_self(), cpu);
+#else
+        if (cpu.empty()) return true;
+        std::cerr << "#warning: thread affinity is not supported. @ac::set_affinity_self()" << std::endl;
+        return false;
+#endif
+    }
+
+    // 要素を初期化せずに確保するアロケータ（値を指定した assign() などは通常どおり書き込む）
+    template<class T>
+    struct first_touch_allocator : std::allocator<T> {
+        template<class U>
+        struct rebind {
+            typedef first_touch_allocator<U> other;
+        };
+
+        first_touch_allocator() noexcept {}
+
+        template<class U>
+        first_touch_allocator(const first_touch_allocator<U> &) noexcept {}
+
+        template<class U>
+        void construct(U *p) noexcept { ::new((void *) p) U; }
+
+        template<class U, class... Args>
+        void construct(U *p, Args &&... args) { ::new((void *) p) U(std::forward<Args>(args)...); }
+    };
+}
+
+#endif // CRL_AFFINITY_HPP
@@ -38,14 +38,14 @@ public:
 
     // エージェントのランダムウォーク
     const std::vector<double> & get_random_walk_gauss(double ave, double sigma) {
-        static std::vector<double> u(U_SIZE);
+        static thread_local std::vector<double> u(U_SIZE);
         u[0] = g_rand_gauss(ave, sigma);
         u[1] = g_rand_gauss(ave, sigma);
         return u;
     }
     // エージェントのランダムウォーク
     const std::vector<double> & get_random_walk(double range) {
-        static std::vector<double> u(U_SIZE);
+        static thread_local std::vector<double> u(U_SIZE);
         u[0] = g_rand(-range, range);
         u[1] = g_rand(-range, range);
         return u;
@@ -87,7 +87,7 @@ public:
     }
 
     std::vector<double> &get_vect(const crlAgent &other) {
-        static std::vector<double> vect(U_SIZE);
+        static thread_local std::vector<double> vect(U_SIZE);
         get_toroidal_vector2(vect, other, 0.0);
         return vect;
     }
@@ -0,0 +1,662 @@
+/***************************************************************************
+ * crlAgentArray.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * 全エージェントの状態を成分ごとの連続配列 (SoA) で保持し，一括で駆動する
+ *   crlAgentArray world;
+ *   world.gather(agent);          // std::vector<crlAgent> から取り込み
+ *   world.u(0)[i] = ...;          // 入力を書き込む
+ *   world.drive_all(SAMPLING_TIME);
+ *   world.scatter(agent);         // std::vector<crlAgent> へ書き戻し
+ * drive_all() は crlAgentCore::drive_core() と同じ計算を AVX-512 (8体) / AVX2 (4体) で行う。
+ * （-march=native などで __AVX512F__ / __AVX2__ が定義されたとき。それ以外はスカラ処理）
+ * FMA への縮約を無効 (-ffp-contract=off) にすればスカラ処理とビット単位で一致する。
+ * 状態の配列は ac::real_t（CRL_PRECISION_FLOAT のとき float）で保持し，計算は double で行う。
+ * place(pool) は配列を確保し直して drive_all(dt, pool) の受け持ち範囲ごとにワーカーの NUMA ノードへ置く。
+ *****************************************************************************/
+
+#ifndef CRL_AGENT_ARRAY_HPP
+#define CRL_AGENT_ARRAY_HPP
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "crlAgentCore.hpp"
+#include "crlThreadPool.hpp"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace agentcore {
+
+#if defined(__AVX512F__)
+    // AVX-512: 8体同時
+    struct simd_avx512 {
+        typedef __m512d reg;
+        typedef __mmask8 mask;
+        static const int WIDTH = 8;
+
+        static reg load(const double *p) { return _mm512_loadu_pd(p); }
+
+        static reg load(const float *p) { return _mm512_cvtps_pd(_mm256_loadu_ps(p)); }
+
+        static void store(double *p, reg a) { _mm512_storeu_pd(p, a); }
+
+        static void store(float *p, reg a) { _mm256_storeu_ps(p, _mm512_cvtpd_ps(a)); }
+
+        static reg set1(double a) { return _mm512_set1_pd(a); }
+
+        static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+
+        static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+
+        static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+
+        static reg div(reg a, reg b) { return _mm512_div_pd(a, b); }
+
+        static reg sqrt(reg a) { return _mm512_sqrt_pd(a); }
+
+        static reg neg(reg a) { return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a),
+                                                                             _mm512_set1_epi64(INT64_MIN))); }
+
+        static mask lt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+
+        static mask gt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+
+        // |a| < inf（nan, inf でない）
+        static mask finite(reg a) {
+            reg abs_a = _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a), _mm512_set1_epi64(INT64_MAX)));
+            return _mm512_cmp_pd_mask(abs_a, _mm512_set1_pd(INFINITY), _CMP_LT_OQ);
+        }
+
+        static mask and_mask(mask a, mask b) { return a & b; }
+
+        // m ? a : b
+        static reg select(mask m, reg a, reg b) { return _mm512_mask_blend_pd(m, b, a); }
+    };
+    typedef simd_avx512 simd_t;
+#define CRL_SIMD_ENABLED
+#elif defined(__AVX2__)
+    // AVX2: 4体同時
+    struct simd_avx2 {
+        typedef __m256d reg;
+        typedef __m256d mask;
+        static const int WIDTH = 4;
+
+        static reg load(const double *p) { return _mm256_loadu_pd(p); }
+
+        static reg load(const float *p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+
+        static void store(double *p, reg a) { _mm256_storeu_pd(p, a); }
+
+        static void store(float *p, reg a) { _mm_storeu_ps(p, _mm256_cvtpd_ps(a)); }
+
+        static reg set1(double a) { return _mm256_set1_pd(a); }
+
+        static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+
+        static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+
+        static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+
+        static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+
+        static reg sqrt(reg a) { return _mm256_sqrt_pd(a); }
+
+        static reg neg(reg a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+
+        static mask lt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+
+        static mask gt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+
+        // |a| < inf（nan, inf でない）
+        static mask finite(reg a) {
+            reg abs_a = _mm256_andnot_pd(_mm256_set1_pd(-0.0), a);
+            return _mm256_cmp_pd(abs_a, _mm256_set1_pd(INFINITY), _CMP_LT_OQ);
+        }
+
+        static mask and_mask(mask a, mask b) { return _mm256_and_pd(a, b); }
+
+        // m ? a : b
+        static reg select(mask m, reg a, reg b) { return _mm256_blendv_pd(b, a, m); }
+    };
+    typedef simd_avx2 simd_t;
+#define CRL_SIMD_ENABLED
+#endif
+}
+
+// DIM 次元のエージェント（crlAgentCoreT<DIM>）の配列
+template<int DIM>
+class crlAgentArrayT {
+    template<class T>
+    using array_t = std::vector<T, ac::first_touch_allocator<T> >; // place() で配置し直せる配列
+
+    int m_num;
+    array_t<ac::real_t> m_pos[DIM]; // 位置 (x, y)
+    array_t<ac::real_t> m_vel[DIM]; // 速度 (dx, dy)
+    array_t<ac::real_t> m_acc[DIM]; // 加速度 (ddx, ddy)
+    array_t<ac::real_t> m_u[DIM]; // 入力 (ux, uy)：drive_all() の前に指令値を書き込み，飽和後の値が残る
+    array_t<double> m_M, m_inv_M, m_D, m_G; // 質量, 1/M, 粘性, 入力ゲイン
+    array_t<double> m_U_MAX, m_V_MAX, m_RADIUS;
+    array_t<double> m_SIGHT_RANGE, m_SIGHT_ANGLE, m_SIGHT_SIGMA; // 視野範囲, 視野角度 [deg], 観測のばらつき
+    array_t<double> m_c[4]; // 積分法の係数 (ac::integrator_t::coef())
+    double m_c_dt; // m_c を計算した刻み幅（負なら未計算）
+    double m_f_max[DIM], m_f_min[DIM]; // フィールドの範囲
+    ac::field_environment_t m_env;
+
+public:
+    static const int STAT = 4 * DIM; // 状態の次元
+#ifdef CRL_SIMD_ENABLED
+    static const int SIMD_WIDTH = ac::simd_t::WIDTH; // 一度に駆動するエージェント数
+#else
+    static const int SIMD_WIDTH = 1;
+#endif
+
+    crlAgentArrayT() {
+        m_num = 0;
+        m_c_dt = -1.0;
+        ac::init(m_env);
+        set_env(m_env);
+    }
+
+    bool init(int num, const ac::field_environment_t &env) {
+        if (num < 0) {
+            std::cerr << "#error: num: " << num << " is negative. @crlAgentArray::init()" << std::endl;
+            return false;
+        }
+        m_num = num;
+        for (int d = 0; d < DIM; d++) {
+            m_pos[d].assign(num, 0.0);
+            m_vel[d].assign(num, 0.0);
+            m_acc[d].assign(num, 0.0);
+            m_u[d].assign(num, 0.0);
+        }
+        ac::agent_physical_t p;
+        ac::init_physical_param(p);
+        m_M.assign(num, p.M);
+        m_inv_M.assign(num, 1.0 / p.M);
+        m_D.assign(num, p.D);
+        m_G.assign(num, p.G);
+        m_U_MAX.assign(num, p.U_MAX);
+        m_V_MAX.assign(num, p.V_MAX);
+        m_RADIUS.assign(num, p.RADIUS);
+        m_SIGHT_RANGE.assign(num, p.SIGHT_RANGE);
+        m_SIGHT_ANGLE.assign(num, p.SIGHT_ANGLE);
+        m_SIGHT_SIGMA.assign(num, p.SIGHT_SIGMA);
+        m_c_dt = -1.0;
+        return set_env(env);
+    }
+
+    // crlAgentCore 派生クラスの配列から状態・物理パラメータを取り込む
+    template<class T>
+    bool gather(const std::vector<T> &agent) {
+        ac::field_environment_t env;
+        if (agent.empty()) return init(0, m_env);
+        agent[0].get_environment_parameters(env);
+        if ((int) agent.size() != m_num) init((int) agent.size(), env);
+        else set_env(env);
+
+        double st[STAT];
+        for (int i = 0; i < m_num; i++) {
+            if (!agent[i].get_stat(st)) return false;
+            set_stat(i, st);
+            m_M[i] = agent[i].get_M();
+            m_inv_M[i] = 1.0 / m_M[i];
+            m_D[i] = agent[i].get_D();
+            m_G[i] = agent[i].get_input_gain();
+            m_U_MAX[i] = agent[i].get_u_max();
+            m_V_MAX[i] = agent[i].get_v_max();
+            m_RADIUS[i] = agent[i].get_radius();
+            m_SIGHT_RANGE[i] = agent[i].get_sight_range();
+            m_SIGHT_ANGLE[i] = agent[i].get_sight_angle();
+            m_SIGHT_SIGMA[i] = agent[i].get_sight_sigma();
+        }
+        m_c_dt = -1.0;
+        return true;
+    }
+
+    // 状態を crlAgentCore 派生クラスの配列に書き戻す
+    template<class T>
+    bool scatter(std::vector<T> &agent) const {
+        if ((int) agent.size() != m_num) {
+            std::cerr << "#error: agent.size(): " << agent.size() << " != " << m_num;
+            std::cerr << " @crlAgentArray::scatter()" << std::endl;
+            return false;
+        }
+        double st[STAT];
+        for (int i = 0; i < m_num; i++) {
+            get_stat(i, st);
+            if (!agent[i].set_stat(st)) return false;
+        }
+        return true;
+    }
+
+    int size() const { return m_num; }
+
+    ac::real_t *pos(int d) { return m_pos[d].data(); }
+
+    ac::real_t *vel(int d) { return m_vel[d].data(); }
+
+    ac::real_t *acc(int d) { return m_acc[d].data(); }
+
+    ac::real_t *u(int d) { return m_u[d].data(); }
+
+    const ac::real_t *pos(int d) const { return m_pos[d].data(); }
+
+    const ac::real_t *vel(int d) const { return m_vel[d].data(); }
+
+    const ac::real_t *acc(int d) const { return m_acc[d].data(); }
+
+    const ac::real_t *u(int d) const { return m_u[d].data(); }
+
+    double get_radius(int i) const { return m_RADIUS[i]; }
+
+    double get_sight_range(int i) const { return m_SIGHT_RANGE[i]; }
+
+    double get_sight_angle(int i) const { return m_SIGHT_ANGLE[i]; }
+
+    double get_sight_sigma(int i) const { return m_SIGHT_SIGMA[i]; }
+
+    double get_M(int i) const { return m_M[i]; }
+
+    double get_input_gain(int i) const { return m_G[i]; }
+
+    double get_u_max(int i) const { return m_U_MAX[i]; }
+
+    double get_v_max(int i) const { return m_V_MAX[i]; }
+
+    const ac::field_environment_t &get_env() const { return m_env; }
+
+    // i 番目のエージェントの状態 (x, y, dx, dy, ddx, ddy, ux, uy)
+    void get_stat(int i, double *st) const {
+        for (int d = 0; d < DIM; d++) {
+            st[d] = m_pos[d][i];
+            st[DIM + d] = m_vel[d][i];
+            st[2 * DIM + d] = m_acc[d][i];
+            st[3 * DIM + d] = m_u[d][i];
+        }
+    }
+
+    void set_stat(int i, const double *st) {
+        for (int d = 0; d < DIM; d++) {
+            m_pos[d][i] = st[d];
+            m_vel[d][i] = st[DIM + d];
+            m_acc[d][i] = st[2 * DIM + d];
+            m_u[d][i] = st[3 * DIM + d];
+        }
+    }
+
+    // nan, inf を含む最初のエージェントの番号（なければ -1）。stat にその状態成分の番号
+    int find_nonfinite(int &stat) const {
+        stat = -1;
+        bool finite = true;
+        for (int d = 0; d < DIM; d++) {
+            finite = ac::is_finite(m_num, m_pos[d].data()) && ac::is_finite(m_num, m_vel[d].data()) &&
+                     ac::is_finite(m_num, m_acc[d].data()) && ac::is_finite(m_num, m_u[d].data()) && finite;
+        }
+        if (finite) return -1;
+        double st[STAT];
+        for (int i = 0; i < m_num; i++) {
+            get_stat(i, st);
+            for (int k = 0; k < STAT; k++) {
+                if (std::isfinite(st[k])) continue;
+                stat = k;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    bool set_physical_parameters(int i, const ac::agent_physical_t &ap) {
+        if (ap.M <= 0.0 || ap.D < 0.0 || ap.G < 0.0 || ap.U_MAX < 0.0 || ap.V_MAX < 0.0 || ap.RADIUS < 0.0 ||
+            ap.SIGHT_RANGE < 0.0 || ap.SIGHT_SIGMA < 0.0) {
+            std::cerr << "#error: invalid physical parameters for agent " << i;
+            std::cerr << " @crlAgentArray::set_physical_parameters()" << std::endl;
+            return false;
+        }
+        m_M[i] = ap.M;
+        m_inv_M[i] = 1.0 / ap.M;
+        m_D[i] = ap.D;
+        m_G[i] = ap.G;
+        m_U_MAX[i] = ap.U_MAX;
+        m_V_MAX[i] = ap.V_MAX;
+        m_RADIUS[i] = ap.RADIUS;
+        m_SIGHT_RANGE[i] = ap.SIGHT_RANGE;
+        m_SIGHT_ANGLE[i] = ap.SIGHT_ANGLE;
+        m_SIGHT_SIGMA[i] = ap.SIGHT_SIGMA;
+        m_c_dt = -1.0;
+        return true;
+    }
+
+    bool set_env(const ac::field_environment_t &env) {
+        for (int d = 0; d < DIM; d++) {
+            if (ac::field_max(env, d) < ac::field_min(env, d)) {
+                std::cerr << "#error: field_max < field_min (axis " << d << ") @crlAgentArray::set_env()" << std::endl;
+                return false;
+            }
+        }
+        ac::copy(env, m_env);
+        for (int d = 0; d < DIM; d++) {
+            m_f_max[d] = ac::field_max(env, d);
+            m_f_min[d] = ac::field_min(env, d);
+        }
+        return true;
+    }
+
+    // 全エージェントを smpl_time だけ駆動する（入力は u(d) に書き込んでおく）
+    //   入力の飽和 (U_MAX) → 加速度 (M, D, G) → 速度の飽和 (V_MAX) → 位置 → トロイダル補正
+    bool drive_all(const double smpl_time) {
+        update_coef(smpl_time);
+        drive_range(0, m_num, smpl_time);
+        return true;
+    }
+
+    // drive_all() をスレッドプールで並列に行う（結果は drive_all() とビット単位で一致）
+    bool drive_all(const double smpl_time, crlThreadPool &pool) {
+        update_coef(smpl_time);
+        const int width = SIMD_WIDTH;
+        const long block = (m_num + width - 1) / width; // SIMD 幅ごとのまとまりで分割
+        pool.parallel_for(0, block, [&](long b, long e, int) {
+            drive_range((int) b * width, (e * width < m_num) ? (int) e * width : m_num, smpl_time);
+        }, 256 / width);
+        return true;
+    }
+
+    // 配列を確保し直し，drive_all(dt, pool) で各ワーカーが最初に受け持つ範囲をそのワーカーが書き込む
+    //   （NUMA のファーストタッチでワーカーのノードに置かれる。pool のワーカーは CPU に固定しておく）
+    //   init(), gather() でエージェント数が変わると呼び出したスレッドのノードに戻るので，その後に呼ぶ
+    void place(crlThreadPool &pool) {
+        for (int d = 0; d < DIM; d++) {
+            place(pool, m_pos[d]);
+            place(pool, m_vel[d]);
+            place(pool, m_acc[d]);
+            place(pool, m_u[d]);
+        }
+        place(pool, m_M);
+        place(pool, m_inv_M);
+        place(pool, m_D);
+        place(pool, m_G);
+        place(pool, m_U_MAX);
+        place(pool, m_V_MAX);
+        place(pool, m_RADIUS);
+        place(pool, m_SIGHT_RANGE);
+        place(pool, m_SIGHT_ANGLE);
+        place(pool, m_SIGHT_SIGMA);
+        if constexpr (ac::integrator_t::LINEAR) {
+            for (int k = 0; k < 4; k++) {
+                if ((int) m_c[k].size() != m_num) m_c_dt = -1.0; // 未計算
+                m_c[k].resize(m_num);
+                place(pool, m_c[k]);
+            }
+        }
+    }
+
+    // begin ~ end - 1 番目のエージェントを駆動（begin は SIMD 幅の倍数）
+    void drive_range(const int begin, const int end, const double smpl_time) {
+        int i = begin;
+#ifdef CRL_SIMD_ENABLED
+        for (; i + ac::simd_t::WIDTH <= end; i += ac::simd_t::WIDTH) {
+            drive_simd<ac::simd_t>(i, smpl_time);
+        }
+#endif
+        for (; i < end; i++) {
+            drive_scalar(i, smpl_time);
+        }
+    }
+
+    // i 番目のエージェントを駆動（crlAgentCore::drive_core() と同じ演算順序）
+    void drive_scalar(const int i, const double smpl_time) {
+        double c[4] = {0.0, 0.0, 0.0, 0.0};
+        update_coef(smpl_time);
+        if constexpr (ac::integrator_t::LINEAR) {
+            for (int k = 0; k < 4; k++)
+                c[k] = m_c[k][i];
+        }
+        drive_one(i, smpl_time, c);
+    }
+
+    // i 番目のエージェントを smpl_time / substep の刻みで substep 回駆動（入力 u(d) は一定）
+    //   積分法の係数はこのエージェントの分だけ計算する（刻み幅が毎回変わっても全員分を計算し直さない）
+    void drive_substeps(const int i, const double smpl_time, const int substep) {
+        const double h = (substep > 1) ? smpl_time / substep : smpl_time;
+        const int n = (substep > 1) ? substep : 1;
+        double c[4] = {0.0, 0.0, 0.0, 0.0};
+        if constexpr (ac::integrator_t::LINEAR)
+            ac::integrator_t::coef(m_inv_M[i], m_D[i], m_G[i], h, c);
+        for (int k = 0; k < n; k++)
+            drive_one(i, h, c);
+    }
+
+private:
+    // i 番目のエージェントを刻み幅 smpl_time・積分法の係数 c で1回駆動
+    void drive_one(const int i, const double smpl_time, const double *c) {
+        double u[DIM], v[DIM], dp[DIM];
+
+        // 入力の飽和
+        double n = 0.0;
+        for (int d = 0; d < DIM; d++) {
+            u[d] = m_u[d][i];
+            n += u[d] * u[d];
+        }
+        n = sqrt(n);
+        double un = 0.0;
+        if (fabs(n) >= 0.001) {
+            for (int d = 0; d < DIM; d++)
+                u[d] /= n;
+            un = n;
+        }
+        if (un > m_U_MAX[i]) un = m_U_MAX[i];
+        for (int d = 0; d < DIM; d++)
+            u[d] = un * u[d];
+        bool finite = true;
+        for (int d = 0; d < DIM; d++)
+            finite = finite && std::isfinite(u[d]);
+        if (!finite) {
+            for (int d = 0; d < DIM; d++)
+                u[d] = 0.0;
+        }
+
+        // 加速度・速度
+        n = 0.0;
+        for (int d = 0; d < DIM; d++) {
+            const double v0 = m_vel[d][i];
+            const double a = m_inv_M[i] * (-m_D[i] * v0 + m_G[i] * u[d]);
+            m_u[d][i] = u[d];
+            m_acc[d][i] = a;
+            if constexpr (ac::integrator_t::LINEAR) {
+                dp[d] = c[2] * v0 + c[3] * u[d];
+                v[d] = c[0] * v0 + c[1] * u[d];
+            } else {
+                v[d] = v0 + a * smpl_time;
+            }
+            n += v[d] * v[d];
+        }
+
+        // 速度の飽和
+        n = sqrt(n);
+        double vn = 0.0;
+        if (fabs(n) >= 0.001) {
+            for (int d = 0; d < DIM; d++)
+                v[d] /= n;
+            vn = n;
+        }
+        if (vn > m_V_MAX[i]) vn = m_V_MAX[i];
+        for (int d = 0; d < DIM; d++) {
+            v[d] = vn * v[d];
+            m_vel[d][i] = v[d];
+        }
+
+        if constexpr (ac::integrator_t::LINEAR) {
+            // 速度を飽和させた場合は移動量も V_MAX * smpl_time 以下にする
+            double dn = 0.0;
+            for (int d = 0; d < DIM; d++)
+                dn += dp[d] * dp[d];
+            dn = sqrt(dn);
+            if (dn > m_V_MAX[i] * smpl_time) {
+                for (int d = 0; d < DIM; d++)
+                    dp[d] *= m_V_MAX[i] * smpl_time / dn;
+            }
+        } else {
+            for (int d = 0; d < DIM; d++)
+                dp[d] = v[d] * smpl_time;
+        }
+
+        // 位置・トロイダル補正
+        for (int d = 0; d < DIM; d++) {
+            double p = m_pos[d][i] + dp[d];
+            if (p > m_f_max[d])
+                p -= (m_f_max[d] - m_f_min[d]);
+            else if (p < m_f_min[d])
+                p += (m_f_max[d] - m_f_min[d]);
+            m_pos[d][i] = p;
+        }
+    }
+
+    // 配列 a を確保し直し，drive_all(dt, pool) と同じ SIMD 幅のまとまりの等分で各ワーカーが複写する
+    template<class T>
+    void place(crlThreadPool &pool, array_t<T> &a) {
+        array_t<T> b;
+        b.resize(m_num); // 初期化しない（ページに触れない）
+        const int width = SIMD_WIDTH;
+        const long block = (m_num + width - 1) / width;
+        pool.parallel_for_static(0, block, [&](long s, long e, int) {
+            const long lo = s * width, hi = (e * width < m_num) ? e * width : m_num;
+            for (long i = lo; i < hi; i++)
+                b[i] = a[i];
+        });
+        a.swap(b);
+    }
+
+    // 積分法の係数を刻み幅 smpl_time で計算し直す（LINEAR な積分法のみ）
+    void update_coef(const double smpl_time) {
+        if constexpr (ac::integrator_t::LINEAR) {
+            if (smpl_time == m_c_dt) return;
+            for (int k = 0; k < 4; k++)
+                m_c[k].resize(m_num);
+            double c[4];
+            for (int i = 0; i < m_num; i++) {
+                ac::integrator_t::coef(m_inv_M[i], m_D[i], m_G[i], smpl_time, c);
+                for (int k = 0; k < 4; k++)
+                    m_c[k][i] = c[k];
+            }
+            m_c_dt = smpl_time;
+        }
+    }
+
+#ifdef CRL_SIMD_ENABLED
+
+    // i から simd_t::WIDTH 体分を駆動（drive_scalar() と同じ演算を分岐なしで行う）
+    template<class S>
+    void drive_simd(const int i, const double smpl_time) {
+        typedef typename S::reg reg;
+        typedef typename S::mask mask;
+        const reg eps = S::set1(0.001);
+        const reg zero = S::set1(0.0);
+        const reg dt = S::set1(smpl_time);
+        reg u[DIM], v[DIM], dp[DIM];
+
+        // 入力の飽和
+        reg n = zero;
+        for (int d = 0; d < DIM; d++) {
+            u[d] = S::load(&m_u[d][i]);
+            n = (d == 0) ? S::mul(u[d], u[d]) : S::add(n, S::mul(u[d], u[d]));
+        }
+        n = S::sqrt(n);
+        mask small = S::lt(n, eps);
+        reg un = S::select(small, zero, n);
+        reg u_max = S::load(&m_U_MAX[i]);
+        un = S::select(S::gt(un, u_max), u_max, un);
+        for (int d = 0; d < DIM; d++) {
+            reg q = S::select(small, u[d], S::div(u[d], n));
+            u[d] = S::mul(un, q);
+        }
+        mask finite = S::finite(u[0]);
+        for (int d = 1; d < DIM; d++)
+            finite = S::and_mask(finite, S::finite(u[d]));
+
+        // 加速度・速度
+        const reg inv_M = S::load(&m_inv_M[i]);
+        const reg neg_D = S::neg(S::load(&m_D[i]));
+        const reg G = S::load(&m_G[i]);
+        n = zero;
+        for (int d = 0; d < DIM; d++) {
+            u[d] = S::select(finite, u[d], zero);
+            S::store(&m_u[d][i], u[d]);
+            reg v0 = S::load(&m_vel[d][i]);
+            reg a = S::mul(inv_M, S::add(S::mul(neg_D, v0), S::mul(G, u[d])));
+            S::store(&m_acc[d][i], a);
+            if constexpr (ac::integrator_t::LINEAR) {
+                dp[d] = S::add(S::mul(S::load(&m_c[2][i]), v0), S::mul(S::load(&m_c[3][i]), u[d]));
+                v[d] = S::add(S::mul(S::load(&m_c[0][i]), v0), S::mul(S::load(&m_c[1][i]), u[d]));
+            } else {
+                v[d] = S::add(v0, S::mul(a, dt));
+            }
+            n = (d == 0) ? S::mul(v[d], v[d]) : S::add(n, S::mul(v[d], v[d]));
+        }
+
+        // 速度の飽和
+        n = S::sqrt(n);
+        small = S::lt(n, eps);
+        reg vn = S::select(small, zero, n);
+        reg v_max = S::load(&m_V_MAX[i]);
+        vn = S::select(S::gt(vn, v_max), v_max, vn);
+
+        for (int d = 0; d < DIM; d++) {
+            reg q = S::select(small, v[d], S::div(v[d], n));
+            v[d] = S::mul(vn, q);
+            S::store(&m_vel[d][i], v[d]);
+        }
+
+        if constexpr (ac::integrator_t::LINEAR) {
+            // 速度を飽和させた場合は移動量も V_MAX * smpl_time 以下にする
+            reg dn = S::mul(dp[0], dp[0]);
+            for (int d = 1; d < DIM; d++)
+                dn = S::add(dn, S::mul(dp[d], dp[d]));
+            dn = S::sqrt(dn);
+            reg lim = S::mul(v_max, dt);
+            mask over = S::gt(dn, lim);
+            reg scale = S::div(lim, dn);
+            for (int d = 0; d < DIM; d++)
+                dp[d] = S::select(over, S::mul(dp[d], scale), dp[d]);
+        } else {
+            for (int d = 0; d < DIM; d++)
+                dp[d] = S::mul(v[d], dt);
+        }
+
+        // 位置・トロイダル補正
+        for (int d = 0; d < DIM; d++) {
+            reg p = S::add(S::load(&m_pos[d][i]), dp[d]);
+            const reg f_max = S::set1(m_f_max[d]);
+            const reg f_min = S::set1(m_f_min[d]);
+            const reg f_size = S::set1(m_f_max[d] - m_f_min[d]);
+            p = S::select(S::gt(p, f_max), S::sub(p, f_size),
+                          S::select(S::lt(p, f_min), S::add(p, f_size), p));
+            S::store(&m_pos[d][i], p);
+        }
+    }
+
+#endif
+};
+
+typedef crlAgentArrayT<U_SIZE> crlAgentArray; // 2次元
+
+namespace agentcore {
+    // crlAgentArray 版（std::vector<T> 版は crlAgentCore.hpp）
+    template<int DIM>
+    int validate_tick(const crlAgentArrayT<DIM> &world, const long tick) {
+        if constexpr (CRL_VALIDATION == CRL_VALIDATION_OFF) return -1;
+        int k;
+        int n = world.find_nonfinite(k);
+        if (n < 0) return -1;
+        double st[crlAgentArrayT<DIM>::STAT];
+        world.get_stat(n, st);
+        std::cerr << "#error: tick " << tick << ": agent " << n << ": stat[" << k << "] is " << st[k];
+        std::cerr << ". @ac::validate_tick()" << std::endl;
+        return n;
+    }
+}
+
+#endif // CRL_AGENT_ARRAY_HPP
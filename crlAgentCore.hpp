@@ -18,13 +18,20 @@
 namespace ac = agentcore;
 
 
-class crlAgentCore {
+// DIM 次元のエージェント（状態は [位置, 速度, 加速度, 入力] の 4 * DIM 次元）
+template<int DIM>
+class crlAgentCoreT {
+    static_assert(DIM == 2 || DIM == 3, "crlAgentCoreT: DIM must be 2 or 3");
+
+public:
+    static const int STAT = 4 * DIM; // 状態の次元
+
 private:
     typedef std::vector<double> vecd;
 
 
 protected:
-    double m_stat[STAT_SIZE]; // 現在の位置・速度・加速度・操作入力 (x, y, dx, dy, ddx, ddy, ux, uy) /in R^8
+    ac::real_t m_stat[STAT]; // 現在の位置・速度・加速度・操作入力 (2次元: x, y, dx, dy, ddx, ddy, ux, uy) /in R^(4 DIM)
     bool m_init_flg; // 初期化したら true
     int m_id, m_type;
     std::string m_label; // type:id
@@ -32,18 +39,18 @@ protected:
     ac::field_environment_t m_env;
 
 public:
-    crlAgentCore() {
+    crlAgentCoreT() {
         m_init_flg = false;
         m_label = "NULL";
     };
 
-    ~crlAgentCore() {
+    ~crlAgentCoreT() {
         m_label.clear();
 
     };
 
     // コピーコンストラクタ
-    crlAgentCore(const crlAgentCore &ac) {
+    crlAgentCoreT(const crlAgentCoreT &ac) {
         if (!ac.check_core()) {
             std::cerr << "#error[" << ac.label() << "]: .check_core() returns false. ";
             std::cerr << "@agentCore::agentCore() --copy constructor--" << std::endl;
@@ -52,14 +59,33 @@ public:
         m_id = ac.m_id;
         m_type = ac.m_type;
         m_init_flg = ac.m_init_flg;
-        for (int i = 0; i < STAT_SIZE; i++)
+        for (int i = 0; i < STAT; i++)
+            m_stat[i] = ac.m_stat[i];
+        m_label = ac.m_label;
+        copy(ac.m_pys, m_pys);
+        copy(ac.m_env, m_env);
+    };
+
+    // 代入演算子（コピーコンストラクタと同じ内容を複写）
+    crlAgentCoreT &operator=(const crlAgentCoreT &ac) {
+        if (this == &ac) return *this;
+        if (!ac.check_core()) {
+            std::cerr << "#error[" << ac.label() << "]: .check_core() returns false. ";
+            std::cerr << "@agentCore::operator=()" << std::endl;
+            exit(1);
+        }
+        m_id = ac.m_id;
+        m_type = ac.m_type;
+        m_init_flg = ac.m_init_flg;
+        for (int i = 0; i < STAT; i++)
             m_stat[i] = ac.m_stat[i];
         m_label = ac.m_label;
         copy(ac.m_pys, m_pys);
         copy(ac.m_env, m_env);
+        return *this;
     };
 
-    bool set(const crlAgentCore &ac) {
+    bool set(const crlAgentCoreT &ac) {
         if (!ac.check_core()) {
             std::cerr << "#error[" << m_label << "]: [" << ac.label() << "].check_core() returns false. ";
             std::cerr << "@agentCore::set()" << std::endl;
@@ -68,7 +94,7 @@ public:
         m_id = ac.m_id;
         m_type = ac.m_type;
         m_init_flg = ac.m_init_flg;
-        for (int i = 0; i < STAT_SIZE; i++)
+        for (int i = 0; i < STAT; i++)
             m_stat[i] = ac.m_stat[i];
         m_label = ac.m_label;
         copy(ac.m_pys, m_pys);
@@ -77,29 +103,39 @@ public:
     };
 
     bool init(int id, int type, double field_x_max, double field_x_min, double field_y_max, double field_y_min) {
+        return init(id, type, field_x_max, field_x_min, field_y_max, field_y_min, DEFAULT_FIELD_Z_MAX,
+                    DEFAULT_FIELD_Z_MIN);
+    }
+
+    // 3次元用（2次元では z の範囲は使わない）
+    bool init(int id, int type, double field_x_max, double field_x_min, double field_y_max, double field_y_min,
+              double field_z_max, double field_z_min) {
         if (id < 0) {
             std::cerr << "#error[" << m_label << "]: id is negative! ";
             std::cerr << "@agentCore::init()" << std::endl;
             exit(1);
         }
-        if (field_x_max < field_x_min || field_y_max < field_y_min) {
-            std::cerr << "#error[" << m_label << "]: field_x_max < field_x_min or field_y_max < field_y_min! ";
-            std::cerr << "@agentCore::init()" << std::endl;
+        if (field_x_max < field_x_min || field_y_max < field_y_min || (DIM > 2 && field_z_max < field_z_min)) {
+            std::cerr << "#error[" << m_label << "]: field_x_max < field_x_min or field_y_max < field_y_min";
+            std::cerr << " or field_z_max < field_z_min! @agentCore::init()" << std::endl;
             exit(1);
         }
         m_env.X_MAX = field_x_max;
         m_env.X_MIN = field_x_min;
         m_env.Y_MAX = field_y_max;
         m_env.Y_MIN = field_y_min;
+        m_env.Z_MAX = field_z_max;
+        m_env.Z_MIN = field_z_min;
         m_env.X_SIZE = field_x_max - field_x_min;
         m_env.Y_SIZE = field_y_max - field_y_min;
+        m_env.Z_SIZE = field_z_max - field_z_min;
         m_id = id;
         m_type = type;
         m_pys.U_MAX = DEFAULT_U_MAX;
         m_pys.V_MAX = DEFAULT_V_MAX;
-        m_stat[0] = g_rand(m_env.X_MIN * 0.85, m_env.X_MAX * 0.85);
-        m_stat[1] = g_rand(m_env.Y_MIN * 0.85, m_env.Y_MAX * 0.85);
-        for (int i = 2; i < STAT_SIZE; i++) {
+        for (int d = 0; d < DIM; d++)
+            m_stat[d] = g_rand(ac::field_min(m_env, d) * 0.85, ac::field_max(m_env, d) * 0.85);
+        for (int i = DIM; i < STAT; i++) {
             m_stat[i] = g_rand_gauss(0.0, 1.0);
         }
 
@@ -123,31 +159,31 @@ public:
     }
 
     double get_veloc_x() const {
-        return m_stat[2];
+        return m_stat[DIM];
     }
 
     double get_veloc_y() const {
-        return m_stat[3];
+        return m_stat[DIM + 1];
     }
 
     double get_accel_x() const {
-        return m_stat[4];
+        return m_stat[2 * DIM];
     }
 
     double get_accel_y() const {
-        return m_stat[5];
+        return m_stat[2 * DIM + 1];
     }
 
     double get_u_x() const {
-        return m_stat[6];
+        return m_stat[3 * DIM];
     }
 
     double get_u_y() const {
-        return m_stat[7];
+        return m_stat[3 * DIM + 1];
     }
 
     double get_stat(int id) const {
-        if (id < 0 || id >= STAT_SIZE) {
+        if (id < 0 || id >= STAT) {
             std::cerr << "#error[" << m_label << "]: id: " << id << " is out of range! ";
             std::cerr << "@agentCore::get_stat()" << std::endl;
             exit(1);
@@ -156,10 +192,10 @@ public:
     }
 
     const std::vector<double> &get_stat_vect() const {
-        static std::vector<double> stat;
-        stat.resize(STAT_SIZE);
-        if (ac::check_isnan(STAT_SIZE, m_stat)) {
-            for (int i = 0; i < STAT_SIZE; i++) {
+        static thread_local std::vector<double> stat;
+        stat.resize(STAT);
+        if (ac::validate(STAT, m_stat)) {
+            for (int i = 0; i < STAT; i++) {
                 stat[i] = m_stat[i];
             }
         } else {
@@ -171,23 +207,23 @@ public:
     }
 
     bool get_stat(double *stat_) const {
-        if (!ac::check_isnan(STAT_SIZE, m_stat)) {
+        if (!ac::validate(STAT, m_stat)) {
             std::cerr << "#error[" << m_label << "]: m_stat: [" << m_stat << "] is nan or inf! ";
             exit(1);
         }
-        for (int i = 0; i < STAT_SIZE; i++)
+        for (int i = 0; i < STAT; i++)
             stat_[i] = m_stat[i];
 
         return true;
     };
 
     bool get_stat(std::vector<double> &stv) const {
-        if (stv.size() != STAT_SIZE) {
+        if (stv.size() != STAT) {
             stv.clear();
-            stv.assign(STAT_SIZE, 0.0);
+            stv.assign(STAT, 0.0);
         }
-        if (ac::check_isnan(STAT_SIZE, m_stat)) {
-            for (int i = 0; i < STAT_SIZE; i++) {
+        if (ac::validate(STAT, m_stat)) {
+            for (int i = 0; i < STAT; i++) {
                 stv[i] = m_stat[i];
             }
         } else {
@@ -200,8 +236,8 @@ public:
 
     bool set_stat(const std::vector<double> &stv) {
 
-        if (ac::check_isnan(stv)) {
-            for (int i = 0; i < STAT_SIZE; i++) {
+        if (ac::validate(stv)) {
+            for (int i = 0; i < STAT; i++) {
                 m_stat[i] = stv[i];
             }
         } else {
@@ -215,12 +251,12 @@ public:
 
     bool set_stat(const double *st) {
 
-        if (!ac::check_isnan(STAT_SIZE, st)) {
-            std::cerr << "#error[" << label() << "]: st: [" << st << "] st.size(): " << STAT_SIZE;
+        if (!ac::validate(STAT, st)) {
+            std::cerr << "#error[" << label() << "]: st: [" << st << "] st.size(): " << STAT;
             std::cerr << " or check_isnan(st) error, agentCore::set_stat()" << std::endl;
             return false;
         }
-        for (int i = 0; i < STAT_SIZE; i++) {
+        for (int i = 0; i < STAT; i++) {
             m_stat[i] = st[i];
         }
         return true;
@@ -228,7 +264,7 @@ public:
 
     bool check_stat(const std::vector<double> &stat) const {
 
-        if (stat.size() != STAT_SIZE || !ac::check_isnan(stat)) {
+        if (stat.size() != STAT || !ac::validate(stat)) {
             std::cerr << "#error[" << m_label << "]: stat: [" << stat << "] stat.size(): " << stat.size();
             std::cerr << " or check_isnan(stat) error, agentCore::check_stat()" << std::endl;
             return false;
@@ -237,9 +273,9 @@ public:
     }
 
     bool get_pos_now(vecd &pos_) const {
-        pos_.resize(U_SIZE);
-        pos_[0] = m_stat[0];
-        pos_[1] = m_stat[1];
+        pos_.resize(DIM);
+        for (int d = 0; d < DIM; d++)
+            pos_[d] = m_stat[d];
         return true;
     }
 
@@ -250,46 +286,46 @@ public:
             std::cerr << "@agentCore::get_pos()" << std::endl;
             exit(1);
         }
-        static vecd pos(2, 0.0);
-        pos[0] = m_stat[0];
-        pos[1] = m_stat[1];
+        static thread_local vecd pos(DIM, 0.0);
+        for (int d = 0; d < DIM; d++)
+            pos[d] = m_stat[d];
         return pos;
     };
 
 
     static const std::vector<double> &get_pos(const std::vector<double> &_stat) {
-        static std::vector<double> pos(2, 0.0);
-        pos[0] = _stat[0];
-        pos[1] = _stat[1];
+        static thread_local std::vector<double> pos(DIM, 0.0);
+        for (int d = 0; d < DIM; d++)
+            pos[d] = _stat[d];
         return pos;
     };
 
     const std::vector<double> &get_pos(const double *_stat) const {
-        static std::vector<double> pos(2, 0.0);
-        pos[0] = _stat[0];
-        pos[1] = _stat[1];
+        static thread_local std::vector<double> pos(DIM, 0.0);
+        for (int d = 0; d < DIM; d++)
+            pos[d] = _stat[d];
         return pos;
     };
 
 
     bool set_pos(const std::vector<double> &x) {
-        if ((int) x.size() != U_SIZE) {
+        if ((int) x.size() != DIM) {
             std::cerr << "#warning[" << m_label << "]: x: [" << x << "] x.size(): " << x.size();
-            std::cerr << " : not " << U_SIZE << " @agentCore::set_pos()" << std::endl;
+            std::cerr << " : not " << DIM << " @agentCore::set_pos()" << std::endl;
         }
-        if (!ac::check_isnan(x)) {
+        if (!ac::validate(x)) {
             std::cerr << "#error[" << label() << "]: check_isnan(x) error. ";
             std::cerr << "@agentCore::set_pos()" << std::endl;
             return false;
         }
-        m_stat[0] = x[0];
-        m_stat[1] = x[1];
+        for (int d = 0; d < DIM; d++)
+            m_stat[d] = x[d];
         return true;
     };
 
     bool set_pos(const double *x) {
-        m_stat[0] = x[0];
-        m_stat[1] = x[1];
+        for (int d = 0; d < DIM; d++)
+            m_stat[d] = x[d];
         return true;
     };
 
@@ -299,34 +335,34 @@ public:
             std::cerr << "@agentCore::get_veloc()" << std::endl;
             exit(1);
         }
-        static std::vector<double> accel(2);
-        accel[0] = m_stat[2];
-        accel[1] = m_stat[3];
+        static thread_local std::vector<double> accel(DIM);
+        for (int d = 0; d < DIM; d++)
+            accel[d] = m_stat[DIM + d];
         return accel;
     };
 
     const std::vector<double> &get_veloc(const std::vector<double> &_stat) const {
-        static std::vector<double> vel(2, 0.0);
-        vel[0] = _stat[2];
-        vel[1] = _stat[3];
+        static thread_local std::vector<double> vel(DIM, 0.0);
+        for (int d = 0; d < DIM; d++)
+            vel[d] = _stat[DIM + d];
         return vel;
     };
 
     bool set_veloc(const std::vector<double> &v) {
 
-        if (v.size() != U_SIZE || !ac::check_isnan(v)) {
+        if (v.size() != DIM || !ac::validate(v)) {
             std::cerr << "#error[" << m_label << "]: v: [" << v << "] x.size(): " << v.size();
             std::cerr << " or check_isnan(v) error, agentCore::set_veloc()" << std::endl;
             return false;
         }
-        m_stat[2] = v[0];
-        m_stat[3] = v[1];
+        for (int d = 0; d < DIM; d++)
+            m_stat[DIM + d] = v[d];
         return true;
     };
 
     bool set_veloc(const double *v) {
-        m_stat[2] = v[0];
-        m_stat[3] = v[1];
+        for (int d = 0; d < DIM; d++)
+            m_stat[DIM + d] = v[d];
         return true;
     };
 
@@ -336,43 +372,43 @@ public:
             std::cerr << "@agentCore::get_force()" << std::endl;
             exit(1);
         }
-        static std::vector<double> a(2);
-        a[0] = m_stat[4];
-        a[1] = m_stat[5];
+        static thread_local std::vector<double> a(DIM);
+        for (int d = 0; d < DIM; d++)
+            a[d] = m_stat[2 * DIM + d];
         return a;
     };
 
     bool get_accel(double *acc) const {
-        acc[0] = m_stat[4];
-        acc[1] = m_stat[5];
+        for (int d = 0; d < DIM; d++)
+            acc[d] = m_stat[2 * DIM + d];
         return true;
     };
 
     bool set_accel(const std::vector<double> &a) {
-        if (a.size() != STAT_SIZE || !ac::check_isnan(a)) {
+        if (a.size() != STAT || !ac::validate(a)) {
             std::cerr << "#error[" << m_label << "]: near: [" << a << "] near.size(): " << a.size();
             std::cerr << " or check_isnan(x) error, agentCore::set_accel()" << std::endl;
             return false;
         }
-        m_stat[4] = a[0];
-        m_stat[5] = a[1];
+        for (int d = 0; d < DIM; d++)
+            m_stat[2 * DIM + d] = a[d];
         return true;
     };
 
     bool set_accel(const double *a) {
-        m_stat[4] = a[0];
-        m_stat[5] = a[1];
+        for (int d = 0; d < DIM; d++)
+            m_stat[2 * DIM + d] = a[d];
         return true;
     };
 
     bool set_force(const std::vector<double> &u) {
-        if (u.size() != 2 || !ac::check_isnan(u)) {
+        if (u.size() != DIM || !ac::validate(u)) {
             std::cerr << "#error[" << m_label << "]: cog: [" << u << "] x.size(): " << u.size();
             std::cerr << " or check_isnan(cog) error, agentCore::set_force()" << std::endl;
             return false;
         }
-        m_stat[6] = u[0];
-        m_stat[7] = u[1];
+        for (int d = 0; d < DIM; d++)
+            m_stat[3 * DIM + d] = u[d];
         return true;
     };
 
@@ -381,15 +417,15 @@ public:
             std::cerr << "#error[" << label() << "]: check_core returns false. @agentCore::get_force()" << std::endl;
             exit(1);
         }
-        static std::vector<double> u(2);
-        u[0] = m_stat[6];
-        u[1] = m_stat[7];
+        static thread_local std::vector<double> u(DIM);
+        for (int d = 0; d < DIM; d++)
+            u[d] = m_stat[3 * DIM + d];
         return u;
     };
 
     bool get_force(double *f) const {
-        f[0] = m_stat[6];
-        f[1] = m_stat[7];
+        for (int d = 0; d < DIM; d++)
+            f[d] = m_stat[3 * DIM + d];
         return true;
     };
 
@@ -404,6 +440,8 @@ public:
             return false;
         }
         m_pys.SIGHT_RANGE = ap.SIGHT_RANGE;
+        m_pys.SIGHT_ANGLE = ap.SIGHT_ANGLE;
+        m_pys.SIGHT_SIGMA = ap.SIGHT_SIGMA;
         m_pys.RADIUS = ap.RADIUS;
         m_pys.M = ap.M;
         m_pys.D = ap.D;
@@ -415,6 +453,8 @@ public:
 
     bool get_physical_parameters(ac::agent_physical_t &ap_) const {
         ap_.SIGHT_RANGE = m_pys.SIGHT_RANGE;
+        ap_.SIGHT_ANGLE = m_pys.SIGHT_ANGLE;
+        ap_.SIGHT_SIGMA = m_pys.SIGHT_SIGMA;
         ap_.RADIUS = m_pys.RADIUS;
         ap_.M = m_pys.M;
         ap_.D = m_pys.D;
@@ -425,8 +465,8 @@ public:
     }
 
     bool set_environment_parameters(const ac::field_environment_t &fe) {
-        if (fe.X_MAX < fe.X_MIN || fe.Y_MAX < fe.Y_MIN) {
-            std::cerr << "#error[" << label() << "]: fe.X_MAX < fe.X_MIN || fe.Y_MAX < fe.Y_MIN ";
+        if (fe.X_MAX < fe.X_MIN || fe.Y_MAX < fe.Y_MIN || (DIM > 2 && fe.Z_MAX < fe.Z_MIN)) {
+            std::cerr << "#error[" << label() << "]: fe.X_MAX < fe.X_MIN || fe.Y_MAX < fe.Y_MIN || fe.Z_MAX < fe.Z_MIN";
             std::cerr << " @agentCore::set_environment_parameters()" << std::endl;
             return false;
         }
@@ -434,8 +474,11 @@ public:
         m_env.X_MIN = fe.X_MIN;
         m_env.Y_MAX = fe.Y_MAX;
         m_env.Y_MIN = fe.Y_MIN;
+        m_env.Z_MAX = fe.Z_MAX;
+        m_env.Z_MIN = fe.Z_MIN;
         m_env.X_SIZE = fe.X_MAX - fe.X_MIN;
         m_env.Y_SIZE = fe.Y_MAX - fe.Y_MIN;
+        m_env.Z_SIZE = fe.Z_MAX - fe.Z_MIN;
         return true;
     };
 
@@ -444,8 +487,11 @@ public:
         fe_.X_MIN = m_env.X_MIN;
         fe_.Y_MAX = m_env.Y_MAX;
         fe_.Y_MIN = m_env.Y_MIN;
+        fe_.Z_MAX = m_env.Z_MAX;
+        fe_.Z_MIN = m_env.Z_MIN;
         fe_.X_SIZE = m_env.X_SIZE;
         fe_.Y_SIZE = m_env.Y_SIZE;
+        fe_.Z_SIZE = m_env.Z_SIZE;
         return true;
     }
 
@@ -572,7 +618,7 @@ public:
         return m_type;
     };
 
-    bool is_collision_occurred(const crlAgentCore &a, const double eps) const {
+    bool is_collision_occurred(const crlAgentCoreT &a, const double eps) const {
         if (is_same(a)) {
             //std::cerr << "#warning[" << label() << "]: same agent_const is checked! ";
             //std::cerr << "@agentCore::is_collision_occurred()" << std::endl;
@@ -585,7 +631,7 @@ public:
             return false;
     };
 
-    bool is_insight(const crlAgentCore &a) const {
+    bool is_insight(const crlAgentCoreT &a) const {
         if (!check_core()) {
             std::cerr << "#error[" << label() << "]: check_core() returns false.";
             std::cerr << " @agentCore::is_insight() " << std::endl;
@@ -603,7 +649,7 @@ public:
             return false;
     }
 
-    double get_sight_angle_elev_deg(const crlAgentCore &a) const {
+    double get_sight_angle_elev_deg(const crlAgentCoreT &a) const {
 
         if (!check_core()) {
             std::cerr << "#error[" << label() << "]: check_core() returns false.";
@@ -616,8 +662,7 @@ public:
             return 0.0;
         }
         vecd dlt(2, 0.0);
-        get_toroidal_vector2(dlt, get_pos(), a.get_pos(), m_env.X_MIN, m_env.X_MAX, m_env.Y_MIN, m_env.Y_MAX,
-                             a.get_sight_sigma());
+        get_toroidal_vector2(dlt, get_pos(), a.get_pos(), a.get_sight_sigma());
         double elev_deg = atan2(dlt[1], dlt[0]) * 180.0 / M_PI;
         double velc_deg = atan2(get_veloc_x(), get_veloc_y()) * 180.0 / M_PI;
 
@@ -631,11 +676,11 @@ public:
             std::cerr << " @agentCore::get_sight_angle_elev_deg_on_map() " << std::endl;
             exit(1);
         }
-        vecd tpos(2, 0.0);
+        vecd tpos(get_pos());
         tpos[0] = m_env.X_MIN + (double) map_x;
         tpos[1] = m_env.X_MIN + (double) map_y;
         vecd dlt;
-        get_toroidal_vector2(dlt, get_pos(), tpos, m_env.X_MIN, m_env.X_MAX, m_env.Y_MIN, m_env.Y_MAX, 0.0);
+        get_toroidal_vector2(dlt, get_pos(), tpos, 0.0);
         double elev_deg = atan2(dlt[1], dlt[0]) * 180.0 / M_PI;
         double velc_deg = atan2(get_veloc_x(), get_veloc_y()) * 180.0 / M_PI;
         double dlt_deg = elev_deg - velc_deg;
@@ -645,24 +690,24 @@ public:
 
 
     // トロイダルベクトル（2次元）から距離を計算
-    double get_toroidal_dist2(const crlAgentCore &target, double sigma) const {
+    double get_toroidal_dist2(const crlAgentCoreT &target, double sigma) const {
         vecd dlt;
         get_toroidal_vector2(dlt, target, sigma);
         return norm(dlt);
     };
 
     // トロイダルベクトル（2次元）から距離を計算
-    double get_toroidal_dist2_with_radius(const crlAgentCore &target, double sigma) const {
+    double get_toroidal_dist2_with_radius(const crlAgentCoreT &target, double sigma) const {
         vecd dlt;
         get_toroidal_vector2(dlt, target, sigma);
         return norm(dlt) - get_radius() - target.get_radius();
     };
 
-    bool get_toroidal_vector2(vecd &dlt_vect, const crlAgentCore &target, double sigma) const {
+    bool get_toroidal_vector2(vecd &dlt_vect, const crlAgentCoreT &target, double sigma) const {
 
         const vecd p0(get_pos());
         const vecd p1(target.get_pos());
-        bool ck = get_toroidal_vector2(dlt_vect, p0, p1, m_env.X_MIN, m_env.X_MAX, m_env.Y_MIN, m_env.Y_MAX, sigma);
+        bool ck = get_toroidal_vector2(dlt_vect, p0, p1, sigma);
         //std::cout << "#debug:p0["<<label()<<"]: [" << p0 << "], p1["<<target.label()<<"]: [" << p1 << "], dlt_vect: [" << dlt_vect << "] ";
         //std::cout << "@agentCore::get_toroidal_vector2()" << std::endl;
         if (!ck) {
@@ -675,16 +720,16 @@ public:
 
     // トロイダル距離（2次元）を計算 [x, y] を dlt_x. dlt_y だけ動かした場合（偏微分計算用）
     // x1 は x1[0]とx1[1]の2次元ベクトルのみ使用
-    double get_toroidal_dist2_with_dlt(const crlAgentCore &trg, double dlt_x, double dlt_y) const {
+    double get_toroidal_dist2_with_dlt(const crlAgentCoreT &trg, double dlt_x, double dlt_y) const {
         double d = 0.0;
-        crlAgentCore trg_ = trg;
+        crlAgentCoreT trg_ = trg;
         trg_.m_stat[0] += dlt_x;
         trg_.m_stat[1] += dlt_y;
         d = get_toroidal_dist2_with_radius(trg_, get_sight_sigma());
         return d; // L1
     };
 
-    bool is_same(const crlAgentCore &a) const {
+    bool is_same(const crlAgentCoreT &a) const {
         if (!check_core()) {
             std::cerr << "#error[" << label() << "]: check_core() returns false. @agentCore::is_same() " << std::endl;
             exit(1);
@@ -702,10 +747,24 @@ public:
         }
     }
 
+    // 状態が全て有限か（分岐なし・出力なし）
+    bool is_finite() const {
+        return ac::is_finite(STAT, m_stat);
+    }
+
+    // 有限でない最初の状態成分の番号（全て有限なら -1）
+    int find_nonfinite() const {
+        if (is_finite()) return -1;
+        for (int i = 0; i < STAT; i++) {
+            if (!std::isfinite(m_stat[i])) return i;
+        }
+        return -1;
+    }
+
     void debug() const {
         //std::cout << "#debug: agentCore::debug() [id: " << m_id << ", tyoe: " << m_type << "]" << std::endl;
         std::cout << "#debug[" << m_label << "]: m_stat [";
-        for (int i = 0; i < STAT_SIZE; i++) {
+        for (int i = 0; i < STAT; i++) {
             std::cout.precision(3);
             std::cout << " " << m_stat[i];
         }
@@ -724,7 +783,7 @@ protected:
             std::cerr << "@agentCore::check_core()" << std::endl;
             ck_flg = false;
         }
-        if (!ac::check_isnan((int) STAT_SIZE, (double *) m_stat)) {
+        if (!ac::validate((int) STAT, m_stat)) {
             std::cerr << "#error[" << label() << "]: m_stat includes nan! ";
             std::cerr << "@agentCore::check_core()" << std::endl;
             ck_flg = false;
@@ -734,16 +793,17 @@ protected:
 
     bool drive_core(std::vector<double> &stat, const std::vector<double> &u_final, const double smpl_time) {
 
-        std::vector<double> u(U_SIZE, 0.0);
-        std::vector<double> v(U_SIZE, 0.0);
+        std::vector<double> u(DIM, 0.0);
+        std::vector<double> v(DIM, 0.0);
+        const int V = DIM, A = 2 * DIM, U = 3 * DIM; // stat 内の速度・加速度・入力の先頭
 
-        if ((int) u_final.size() != U_SIZE || !ac::check_isnan(u_final)) {
+        if ((int) u_final.size() != DIM || !ac::validate(u_final)) {
             std::cerr << "#error[" << label() << "]: u_final includes nan! ";
             std::cerr << "@agentCore::drive_core()" << std::endl;
             return false;
         }
-        stat.resize(STAT_SIZE, 0.0);
-        for (int i = 0; i < STAT_SIZE; i++) {
+        stat.resize(STAT, 0.0);
+        for (int i = 0; i < STAT; i++) {
             stat[i] = m_stat[i];
         }
         u = u_final;
@@ -752,64 +812,77 @@ protected:
         if (un > u_max) {
             un = u_max;
         }
-        u[0] = un * u[0];
-        u[1] = un * u[1];
-
-        stat[6] = u[0];
-        stat[7] = u[1];
-        if (!std::isfinite(stat[6]) || !std::isfinite(stat[7])) {
-            std::cerr << "#error[" << label() << "]: [stat[6], stat[7]]: ";
-            std::cerr << "[" << stat[6] << ", " << stat[7] << "] includes nan or inf. ";
-            std::cerr << "@agentCore::drive_core()" << std::endl;
-            stat[6] = 0.0;
-            stat[7] = 0.0;
-
+        bool finite = true;
+        for (int i = 0; i < DIM; i++) {
+            u[i] = un * u[i];
+            stat[U + i] = u[i];
+            finite = finite && std::isfinite(stat[U + i]);
         }
-        stat[4] = (1.0 / m_pys.M) * (-m_pys.D * m_stat[2] + m_pys.G * stat[6]); // ddx
-        stat[5] = (1.0 / m_pys.M) * (-m_pys.D * m_stat[3] + m_pys.G * stat[7]); // ddy
-        if (!std::isfinite(stat[4]) || !std::isfinite(stat[5])) {
-            std::cerr << "#error[" << label() << "]: [stat[4], stat[5]]: ";
-            std::cerr << "[" << stat[4] << ", " << stat[5] << "] includes nan or inf. ";
+        if (!finite) {
+            std::cerr << "#error[" << label() << "]: u: [" << u << "] includes nan or inf. ";
             std::cerr << "@agentCore::drive_core()" << std::endl;
-            std::cerr << "#error[" << label() << "] debug: cog: [" << stat[6] << ", " << stat[7] << "] ";
+            for (int i = 0; i < DIM; i++)
+                stat[U + i] = 0.0;
+        }
+        finite = true;
+        for (int i = 0; i < DIM; i++) {
+            stat[A + i] = (1.0 / m_pys.M) * (-m_pys.D * m_stat[V + i] + m_pys.G * stat[U + i]); // ddx
+            finite = finite && std::isfinite(stat[A + i]);
+        }
+        if (!finite) {
+            std::cerr << "#error[" << label() << "]: accel includes nan or inf. ";
             std::cerr << "@agentCore::drive_core()" << std::endl;
             std::cerr << "#error[" << label() << "] debug: u_final: [" << u_final << "] ";
             std::cerr << "@agentCore::drive_core()" << std::endl;
             return false;
         }
 
-        stat[2] += stat[4] * smpl_time; // dx
-        stat[3] += stat[5] * smpl_time; // dy
+        double dp[DIM]; // 位置の変化量 (LINEAR な積分法のみ)
+        if constexpr (ac::integrator_t::LINEAR) {
+            double c[4];
+            ac::integrator_t::coef(1.0 / m_pys.M, m_pys.D, m_pys.G, smpl_time, c);
+            for (int i = 0; i < DIM; i++) {
+                dp[i] = c[2] * m_stat[V + i] + c[3] * stat[U + i];
+                stat[V + i] = c[0] * m_stat[V + i] + c[1] * stat[U + i];
+            }
+        } else {
+            for (int i = 0; i < DIM; i++)
+                stat[V + i] += stat[A + i] * smpl_time; // dx
+        }
 
         // 速度のMAX値セット
-        v[0] = stat[2];
-        v[1] = stat[3];
+        for (int i = 0; i < DIM; i++)
+            v[i] = stat[V + i];
         double v_max = m_pys.V_MAX;
         double vn = normalize(v);
         if (vn > v_max) {
             vn = v_max;
         }
-        v[0] = vn * v[0];
-        v[1] = vn * v[1];
-        stat[2] = v[0];
-        stat[3] = v[1];
-
+        for (int i = 0; i < DIM; i++) {
+            v[i] = vn * v[i];
+            stat[V + i] = v[i];
+        }
 
-        stat[0] += stat[2] * smpl_time; // x
-        stat[1] += stat[3] * smpl_time; // y
+        if constexpr (ac::integrator_t::LINEAR) {
+            // 速度を飽和させた場合は移動量も V_MAX * smpl_time 以下にする
+            double dn = dp[0] * dp[0];
+            for (int i = 1; i < DIM; i++)
+                dn += dp[i] * dp[i];
+            dn = sqrt(dn);
+            if (dn > v_max * smpl_time) {
+                for (int i = 0; i < DIM; i++)
+                    dp[i] *= v_max * smpl_time / dn;
+            }
+            for (int i = 0; i < DIM; i++)
+                stat[i] += dp[i]; // x
+        } else {
+            for (int i = 0; i < DIM; i++)
+                stat[i] += stat[V + i] * smpl_time; // x
+        }
         modify_into_toroidal(stat);
         set_stat(stat);
-        /*
-        if(get_type()==TYPE_SHEEP && get_id() == 0) {
-            std::cout << "#debug[" << label() << "]: " << std::setprecision(2) << std::fixed << std::showpos;
-            std::cout << "[M, D]: [" << m_pys.M << ", " << m_pys.D << "], ";
-            std::cout << "cog: [" << stat[6] << ", " << stat[7] << "], ";
-            std::cout << "dx: [" << stat[2] << ", " << stat[3] << "] ";
-            std::cout << "ddx: [" << stat[4] << ", " << stat[5] << "] ";
-            std::cout << "@agentCore::drive_core()" << std::endl;
-        }*/
-
-        if (!ac::check_isnan(stat)) {
+
+        if (!ac::validate(stat)) {
             std::cerr << "#error[" << m_label << "]: m_stat is nan finite. ";
             std::cerr << "@agentCore::drive_core()" << std::endl;
             return false;
@@ -818,39 +891,39 @@ protected:
     };
 
     bool modify_into_toroidal(std::vector<double> &x_) const {
-        if (x_[0] > m_env.X_MAX)
-            x_[0] -= (m_env.X_MAX - m_env.X_MIN);
-        else if (x_[0] < m_env.X_MIN)
-            x_[0] += (m_env.X_MAX - m_env.X_MIN);
-        if (x_[1] > m_env.Y_MAX)
-            x_[1] -= (m_env.Y_MAX - m_env.Y_MIN);
-        else if (x_[1] < m_env.Y_MIN)
-            x_[1] += (m_env.Y_MAX - m_env.Y_MIN);
+        for (int d = 0; d < DIM; d++) {
+            const double f_max = ac::field_max(m_env, d);
+            const double f_min = ac::field_min(m_env, d);
+            if (x_[d] > f_max)
+                x_[d] -= (f_max - f_min);
+            else if (x_[d] < f_min)
+                x_[d] += (f_max - f_min);
+        }
         return true;
     };
 
     bool sat_vect2(std::vector<double> &v_, const double max) const {
-        if ((int) v_.size() != 2) {
-            std::cerr << "#error[" << m_label << "]: v_.size() != 2. ";
+        if ((int) v_.size() != DIM) {
+            std::cerr << "#error[" << m_label << "]: v_.size() != " << DIM << ". ";
             std::cerr << "@agentCore::sat_vect2()" << std::endl;
             return false;
         }
-        if (!ac::check_isnan(v_)) {
+        if (!ac::validate(v_)) {
             std::cerr << "#error[" << m_label << "]: v_ includes nan. ";
             std::cerr << "@agentCore::sat_vect2()" << std::endl;
             return false;
         }
         double _nv = normalize(v_);
         if (_nv > -0.001 && _nv < 0.001) {
-            v_[0] = 0.0;
-            v_[1] = 0.0;
+            for (int d = 0; d < DIM; d++)
+                v_[d] = 0.0;
             return true;
         }
         if (_nv > max) {
-            v_[0] = v_[0] * max;
-            v_[1] = v_[1] * max;
+            for (int d = 0; d < DIM; d++)
+                v_[d] = v_[d] * max;
         }
-        if (!ac::check_isnan(v_)) {
+        if (!ac::validate(v_)) {
             std::cerr << "#error[" << m_label << "]: v_ includes nan. _nv: ";
             std::cerr << _nv << ", max: " << max << " @agentCore::sat_vect2()" << std::endl;
             return false;
@@ -860,157 +933,109 @@ protected:
 
 private:
 
-    // トロイダルベクトル（2次元）を計算 [x2 - x1] を返す
-    bool get_toroidal_vector2(vecd &dlt_vect, const vecd &x1, const vecd &x2, double x_min, double x_max, double y_min,
-                              double y_max, double sight_s) const {
+    // トロイダルベクトル（DIM 次元）を計算 [x2 - x1] を返す
+    bool get_toroidal_vector2(vecd &dlt_vect, const vecd &x1, const vecd &x2, double sight_s) const {
 
-        dlt_vect.resize(U_SIZE, 0.0);
-        double x_size = x_max - x_min;
-        double y_size = y_max - y_min;
-        vecd x1_(2, 0.0);
-        vecd x2_(2, 0.0);
+        dlt_vect.resize(DIM, 0.0);
+        vecd x1_(DIM, 0.0);
+        vecd x2_(DIM, 0.0);
 
         //std::cout << "#debug: x1: [" << x1 << "], x2: [" << x2 << "] @get_toroidal_vector2()" << std::endl;
-        for (int i = 0; i < U_SIZE; i++) {
+        for (int i = 0; i < DIM; i++) {
             x1_[i] = x1[i];
             x2_[i] = g_rand_gauss(x2[i], sight_s);
         }
-        for (int i = 0; i < U_SIZE; i++) {
+        for (int i = 0; i < DIM; i++) {
             dlt_vect[i] = x2_[i] - x1_[i];
         }
 
         //std::cout << "#debug: x1_: [" << x1_ << "], x2_: [" << x2_ << "], dlt_vect: [" << dlt_vect << "] @get_toroidal_vector2()" << std::endl;
         double d0 = norm(dlt_vect);
-        if (d0 < 0.5 * sqrt(x_size * x_size + y_size * y_size)) {
-            return ac::check_isnan(dlt_vect);
-        }
-
-
-        double _d;
-        x2_ = x2;
-        x1_[0] = x1[0] + x_size;
-        x1_[1] = x1[1] + y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0] + x_size;
-        x1_[1] = x1[1];
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0] + x_size;
-        x1_[1] = x1[1] - y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0];
-        x1_[1] = x1[1] + y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0];
-        x1_[1] = x1[1] - y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0] - x_size;
-        x1_[1] = x1[1] + y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0] - x_size;
-        x1_[1] = x1[1];
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0] - x_size;
-        x1_[1] = x1[1] - y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        return ac::check_isnan(dlt_vect);
-    }
-
-    // トロイダルベクトル（2次元）を計算 [x2 - x1] を返す
-    const vecd &
-    toroidal_vector2(const vecd &x1, const vecd &x2, const double x_min, const double x_max, const double y_min,
-                     const double y_max, double sight_s) const {
-
-        static vecd dlt_vect(2, 0.0);
-        double x_size = x_max - x_min;
-        double y_size = y_max - y_min;
-
-        for (int i = 0; i < U_SIZE; i++) {
+        if (d0 < 0.5 * field_diagonal()) {
+            return ac::validate(dlt_vect);
+        }
+        search_images(dlt_vect, d0, x1, x2);
+        return ac::validate(dlt_vect);
+    }
+
+    // トロイダルベクトル（DIM 次元）を計算 [x2 - x1] を返す
+    const vecd &toroidal_vector2(const vecd &x1, const vecd &x2, double sight_s) const {
+
+        static thread_local vecd dlt_vect(DIM, 0.0);
+
+        for (int i = 0; i < DIM; i++) {
             dlt_vect[i] = g_rand_gauss(x2[i], sight_s) - x1[i];
         }
         //std::cout << "#debug[" << label() << "]: x1: ["<<x1<<"], x2: ["<<x2<<"], dlt_vect: [" << dlt_vect << "] ";
         //std::cout << "@toroidal_vector2()" << std::endl;
         double d0 = norm(dlt_vect);
-        if (d0 < 0.5 * sqrt(x_size * x_size + y_size * y_size)) return dlt_vect;
-
-        vecd x1_(2, 0.0);
-        vecd x2_(2, 0.0);
-        double _d;
-        x2_ = x2;
-
-        x1_[0] = x1[0] + x_size;
-        x1_[1] = x1[1] + y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0] + x_size;
-        x1_[1] = x1[1];
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0] + x_size;
-        x1_[1] = x1[1] - y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0];
-        x1_[1] = x1[1] + y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0];
-        x1_[1] = x1[1] - y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0] - x_size;
-        x1_[1] = x1[1] + y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0] - x_size;
-        x1_[1] = x1[1];
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
-        x1_[0] = x1[0] - x_size;
-        x1_[1] = x1[1] - y_size;
-        if ((_d = norm(x2_ - x1_)) < d0) {
-            d0 = _d;
-            dlt_vect = x2_ - x1_;
-        }
+        if (d0 < 0.5 * field_diagonal()) return dlt_vect;
+        search_images(dlt_vect, d0, x1, x2);
         return dlt_vect;
     }
+
+    // フィールドの対角線の長さ
+    double field_diagonal() const {
+        double s = 0.0;
+        for (int d = 0; d < DIM; d++) {
+            double size = ac::field_max(m_env, d) - ac::field_min(m_env, d);
+            s += size * size;
+        }
+        return sqrt(s);
+    }
+
+    // x1 を各軸 +size, 0, -size ずらした 3^DIM - 1 個の像から x2 に最も近いものを探す
+    // （軸 0 が最上位の順: 2次元では (+,+), (+,0), (+,-), (0,+), (0,-), (-,+), (-,0), (-,-)）
+    void search_images(vecd &dlt_vect, double d0, const vecd &x1, const vecd &x2) const {
+        static const double sgn[3] = {1.0, 0.0, -1.0};
+        vecd x1_(DIM, 0.0);
+        vecd x2_(x2.begin(), x2.begin() + DIM);
+        int k[DIM];
+        for (int d = 0; d < DIM; d++)
+            k[d] = 0;
+        while (true) {
+            bool self = true;
+            for (int d = 0; d < DIM; d++) {
+                double size = ac::field_max(m_env, d) - ac::field_min(m_env, d);
+                x1_[d] = (k[d] == 1) ? x1[d] : x1[d] + sgn[k[d]] * size;
+                self = self && (k[d] == 1);
+            }
+            double _d;
+            if (!self && (_d = norm(x2_ - x1_)) < d0) {
+                d0 = _d;
+                dlt_vect = x2_ - x1_;
+            }
+            int d = DIM - 1;
+            while (d >= 0 && ++k[d] == 3) {
+                k[d] = 0;
+                d--;
+            }
+            if (d < 0) break;
+        }
+    }
 };
 
+typedef crlAgentCoreT<U_SIZE> crlAgentCore; // 2次元 (STAT_SIZE, U_SIZE)
+
+namespace agentcore {
+    // ステップの終わりに全エージェントの状態をまとめて検査し，nan, inf を含む最初のエージェントを報告する
+    // （CRL_VALIDATION_OFF のときは何もしない）。問題がなければ -1，あればエージェントの番号を返す
+    template<class T>
+    int validate_tick(const std::vector<T> &agent, const long tick) {
+        if constexpr (CRL_VALIDATION == CRL_VALIDATION_OFF) return -1;
+        bool finite = true;
+        for (int n = 0; n < (int) agent.size(); n++)
+            finite = agent[n].is_finite() && finite;
+        if (finite) return -1;
+        for (int n = 0; n < (int) agent.size(); n++) {
+            int i = agent[n].find_nonfinite();
+            if (i < 0) continue;
+            std::cerr << "#error[" << agent[n].label() << "]: tick " << tick << ": agent " << n << ": stat[" << i;
+            std::cerr << "] is " << agent[n].get_stat(i) << ". @ac::validate_tick()" << std::endl;
+            return n;
+        }
+        return -1;
+    }
+}
+
 #endif // AGENT_CORE_HPP
\ No newline at end of file
@@ -13,11 +13,21 @@
 #include <vector>
 #include <random>
 #include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
 
 
 std::random_device seed0;
 std::random_device seed1;     // 非決定的な乱数生成器を生成
 
+// g_set_seed() でシードを固定すると g_rand(), g_rand_gauss() は再現可能な乱数列を返す
+//   シードと乱数列はスレッドごと（g_set_seed() を呼んだスレッドのみ固定される）
+thread_local bool g_seed_fixed = false;
+thread_local unsigned int g_seed = 0; // g_set_seed() で固定したシード
+thread_local std::mt19937 g_engine0;
+thread_local std::mt19937 g_engine1;
+
 
 template<class T>
 std::ostream &operator<<(std::ostream &os, const std::vector<T> &v) {
@@ -74,6 +84,7 @@ std::vector<T> operator*(const double v1, const std::vector<T> &v2) {
 
 #define STAT_SIZE 8 // [x, y, dx, dy, ddx, ddy, ux, uy]
 #define U_SIZE 2 // 最終的な入力ベクトルのサイズ [次元]
+// 3次元などは crlAgentCoreT<DIM> を使う（状態は [位置, 速度, 加速度, 入力] の 4 * DIM 次元）
 
 #define DEFAULT_U_MAX 50.0
 #define DEFAULT_V_MAX 50.0
@@ -96,8 +107,44 @@ std::vector<T> operator*(const double v1, const std::vector<T> &v2) {
 #define DEFAULT_FIELD_X_MIN -100
 #define DEFAULT_FIELD_Y_MAX 100
 #define DEFAULT_FIELD_Y_MIN -100
+#define DEFAULT_FIELD_Z_MAX 100 // 3次元のときのみ使用
+#define DEFAULT_FIELD_Z_MIN -100
+
+// 積分法（コンパイル時に -DCRL_INTEGRATOR=... で選択）
+#define CRL_INTEGRATOR_EULER 0 // 半陰的オイラー法（従来の計算）
+#define CRL_INTEGRATOR_RK4 1 // 4次のルンゲ・クッタ法（入力はステップ内で一定）
+#define CRL_INTEGRATOR_ZOH 2 // 0次ホールドによる M・dv = -D・v + G・u の離散化（線形部分のみ厳密）
+#ifndef CRL_INTEGRATOR
+#define CRL_INTEGRATOR CRL_INTEGRATOR_EULER
+#endif
+
+// 状態（位置・速度・加速度・入力）の保持精度（コンパイル時に -DCRL_PRECISION=... で選択）
+// 計算は常に double で行い，保持するときだけ丸める
+#define CRL_PRECISION_DOUBLE 0 // double（従来の計算）
+#define CRL_PRECISION_FLOAT 1 // float（メモリ量・帯域が半分）
+#ifndef CRL_PRECISION
+#define CRL_PRECISION CRL_PRECISION_DOUBLE
+#endif
+
+// nan, inf の検査（コンパイル時に -DCRL_VALIDATION=... で選択）
+#define CRL_VALIDATION_CHECKED 0 // 状態へのアクセスごとに検査（従来の動作）
+#define CRL_VALIDATION_TICK 1 // ステップの終わりに全エージェントをまとめて検査 (ac::validate_tick())
+#define CRL_VALIDATION_OFF 2 // 検査しない
+#ifndef CRL_VALIDATION
+#ifdef NDEBUG
+#define CRL_VALIDATION CRL_VALIDATION_TICK
+#else
+#define CRL_VALIDATION CRL_VALIDATION_CHECKED
+#endif
+#endif
 
 namespace agentcore {
+#if CRL_PRECISION == CRL_PRECISION_FLOAT
+    typedef float real_t;
+#else
+    typedef double real_t;
+#endif
+
     typedef struct {
         double SIGHT_RANGE; // 視野範囲
         double SIGHT_ANGLE; // 視野角度
@@ -113,8 +160,11 @@ namespace agentcore {
         double X_MIN;
         double Y_MAX;
         double Y_MIN;
+        double Z_MAX; // 3次元のときのみ使用
+        double Z_MIN;
         double X_SIZE;
         double Y_SIZE;
+        double Z_SIZE;
     } field_environment_t;
 
     void init_physical_param(agent_physical_t &p) {
@@ -134,8 +184,11 @@ namespace agentcore {
         env.X_MIN = DEFAULT_FIELD_X_MIN;
         env.Y_MAX = DEFAULT_FIELD_Y_MAX;
         env.Y_MIN = DEFAULT_FIELD_Y_MIN;
+        env.Z_MAX = DEFAULT_FIELD_Z_MAX;
+        env.Z_MIN = DEFAULT_FIELD_Z_MIN;
         env.X_SIZE = env.X_MAX - env.X_MIN;
         env.Y_SIZE = env.Y_MAX - env.Y_MIN;
+        env.Z_SIZE = env.Z_MAX - env.Z_MIN;
     }
 
     bool copy(const agent_physical_t &src, agent_physical_t &dst) {
@@ -156,11 +209,80 @@ namespace agentcore {
         dst.X_MIN = src.X_MIN;
         dst.Y_MAX = src.Y_MAX;
         dst.Y_MIN = src.Y_MIN;
+        dst.Z_MAX = src.Z_MAX;
+        dst.Z_MIN = src.Z_MIN;
         dst.X_SIZE = src.X_SIZE;
         dst.Y_SIZE = src.Y_SIZE;
+        dst.Z_SIZE = src.Z_SIZE;
         return true;
     }
 
+    // 軸 d (0: x, 1: y, 2: z) のフィールドの範囲
+    double field_min(const field_environment_t &env, const int d) {
+        return (d == 0) ? env.X_MIN : (d == 1) ? env.Y_MIN : env.Z_MIN;
+    }
+
+    double field_max(const field_environment_t &env, const int d) {
+        return (d == 0) ? env.X_MAX : (d == 1) ? env.Y_MAX : env.Z_MAX;
+    }
+
+    // 積分法ポリシー
+    //   LINEAR = true の積分法は，入力 u をステップ内で一定として 1軸ごとに
+    //     v_new = c[0] * v + c[1] * u,  dp = c[2] * v + c[3] * u
+    //   の係数 c を coef() で与える（係数はパラメータと刻み幅のみに依存）
+    struct integrator_euler {
+        static const bool LINEAR = false; // drive_core() 内の従来の式で計算
+        static void coef(double, double, double, double, double *c) {
+            c[0] = c[1] = c[2] = c[3] = 0.0;
+        }
+    };
+
+    struct integrator_rk4 {
+        static const bool LINEAR = true;
+        // 線形系に対する RK4 は exp(A・h) の4次までのテイラー展開と一致する
+        static void coef(const double inv_M, const double D, const double G, const double h, double *c) {
+            double z = -D * inv_M * h;
+            double b = G * inv_M;
+            double q1 = 1.0 + z / 2.0 + z * z / 6.0 + z * z * z / 24.0;
+            double q2 = 0.5 + z / 6.0 + z * z / 24.0;
+            c[0] = 1.0 + z * q1;
+            c[1] = h * b * q1;
+            c[2] = h * q1;
+            c[3] = h * h * b * q2;
+        }
+    };
+
+    struct integrator_zoh {
+        static const bool LINEAR = true;
+        // v(h) = e^{-z} v + b h φ1(z) u,  p(h) - p = h φ1(z) v + b h^2 φ2(z) u  (z = D h / M, b = G / M)
+        // φ1(z) = (1 - e^{-z}) / z,  φ2(z) = (z - 1 + e^{-z}) / z^2
+        static void coef(const double inv_M, const double D, const double G, const double h, double *c) {
+            double z = D * inv_M * h;
+            double b = G * inv_M;
+            double phi1, phi2;
+            if (z < 1.0e-3) { // D = 0 を含む（級数展開で桁落ちを避ける）
+                phi1 = 1.0 - z / 2.0 + z * z / 6.0 - z * z * z / 24.0;
+                phi2 = 0.5 - z / 6.0 + z * z / 24.0 - z * z * z / 120.0;
+            } else {
+                double em1 = -expm1(-z); // 1 - e^{-z}
+                phi1 = em1 / z;
+                phi2 = (z - em1) / (z * z);
+            }
+            c[0] = exp(-z);
+            c[1] = h * b * phi1;
+            c[2] = h * phi1;
+            c[3] = h * h * b * phi2;
+        }
+    };
+
+#if CRL_INTEGRATOR == CRL_INTEGRATOR_RK4
+    typedef integrator_rk4 integrator_t;
+#elif CRL_INTEGRATOR == CRL_INTEGRATOR_ZOH
+    typedef integrator_zoh integrator_t;
+#else
+    typedef integrator_euler integrator_t;
+#endif
+
     bool check_isnan(const std::vector<double> &_x) {
 
         bool ck_flg = true;
@@ -179,7 +301,8 @@ namespace agentcore {
         return ck_flg;
     }
 
-    bool check_isnan(const int s, const double *_x) {
+    template<class R>
+    bool check_isnan(const int s, const R *_x) {
         bool ck_flg = true;
         for (int i = 0; i < s; i++) {
             if (std::isnan(_x[i]) || std::isinf(_x[i]) || !std::isfinite(_x[i])) {
@@ -191,7 +314,7 @@ namespace agentcore {
         }
         if(!ck_flg) {
             std::cerr << "#error: _x: nan or inf is detected. ";
-            std::cerr << " @agentcore_config.h::check_isnan(const int s, const double *_x)" << std::endl;
+            std::cerr << " @agentcore_config.h::check_isnan(const int s, const R *_x)" << std::endl;
         }
         return ck_flg;
     }
@@ -210,27 +333,116 @@ namespace agentcore {
         }
         return ck_flg;
     }
+
+    // 状態へのアクセスごとの検査（CRL_VALIDATION_CHECKED のときのみ check_isnan() を呼ぶ）
+    template<class V>
+    bool validate(const V &_x) {
+        if constexpr (CRL_VALIDATION == CRL_VALIDATION_CHECKED)
+            return check_isnan(_x);
+        else
+            return true;
+    }
+
+    template<class R>
+    bool validate(const int s, const R *_x) {
+        if constexpr (CRL_VALIDATION == CRL_VALIDATION_CHECKED)
+            return check_isnan(s, _x);
+        else
+            return true;
+    }
+
+    // 分岐なしの検査: x[0] ~ x[s - 1] が全て有限なら true（指数部が全て 1 のものが nan, inf）
+    template<class R>
+    bool is_finite(const int s, const R *x) {
+        typedef typename std::conditional<sizeof(R) == 8, uint64_t, uint32_t>::type bits_t;
+        const bits_t EXP = (sizeof(R) == 8) ? (bits_t) 0x7ff0000000000000ULL : (bits_t) 0x7f800000U;
+        bits_t bad = 0;
+        for (int i = 0; i < s; i++) {
+            bits_t b;
+            std::memcpy(&b, &x[i], sizeof(R));
+            bad |= (bits_t) ((b & EXP) == EXP);
+        }
+        return bad == 0;
+    }
 }
 
 //-----------------------------
 // for mathematical calculation
 
+// 乱数シードを固定する（呼び出したスレッドの乱数列を初期化）
+void g_set_seed(const unsigned int seed) {
+    g_seed_fixed = true;
+    g_seed = seed;
+    g_engine0.seed(seed);
+    g_engine1.seed(seed + 1);
+}
+
+// 呼び出したスレッドのシード（固定していなければスレッドごとに1回だけ決める）
+//   ac::stream_key(g_get_seed(), 時刻, 番号) はスレッドによらない乱数列になる
+unsigned int g_get_seed() {
+    static thread_local unsigned int seed = seed0();
+    return g_seed_fixed ? g_seed : seed;
+}
+
 double g_rand_gauss(const double mean, const double std) {
     if(std==0.0) return mean;
 
-    std::mt19937 engine(seed0());            // メルセンヌ・ツイスター法
+    std::normal_distribution<> dist(mean, std);
+    if (g_seed_fixed) return dist(g_engine0);
+    static thread_local std::mt19937 engine(seed0());   // メルセンヌ・ツイスター法（スレッドごとに1回だけ初期化）
     // std::minstd_rand0 engine(seed());    // 線形合同法
     // std::ranlux24_base engine(seed());   // キャリー付き減算法
-    std::normal_distribution<> dist(mean, std);
     return dist(engine);
 }
 
 double g_rand(const double min, const double max) {
-    std::mt19937 engine(seed1());     //  メルセンヌ・ツイスタの32ビット版、引数は初期シード値
     std::uniform_real_distribution<> rand_real(min, max);        // [0, 99] 範囲の一様乱数
+    if (g_seed_fixed) return rand_real(g_engine1);
+    static thread_local std::mt19937 engine(seed1());     //  メルセンヌ・ツイスタの32ビット版、引数は初期シード値
     return rand_real(engine);
 }
 
+namespace agentcore {
+    // カウンタ方式の乱数（状態を持たない: 同じ key, n なら常に同じ値を返す）
+    //   観測者・時刻ごとに key を変えると，計算の順序やスレッド数によらず再現可能な乱数列になる
+    inline uint64_t splitmix64(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // 乱数列の key（シード, 時刻, 観測者の番号から作る）
+    inline uint64_t stream_key(uint64_t seed, uint64_t tick, uint64_t id) {
+        return splitmix64(splitmix64(splitmix64(seed) ^ tick) ^ id);
+    }
+
+    // 平均 0, 標準偏差 std の正規乱数を n 個 out に書き込む（Box-Muller 法）
+    //   一様乱数の生成（整数演算のみ）と変換を別のループにしてまとめて計算する
+    void fill_gauss(double *out, int n, uint64_t key, double std) {
+        if (std == 0.0) {
+            for (int k = 0; k < n; k++)
+                out[k] = 0.0;
+            return;
+        }
+        const int m = (n + 1) / 2;
+        thread_local std::vector<double> u1, u2;
+        u1.resize(m);
+        u2.resize(m);
+        const double SCALE = 1.0 / 9007199254740992.0; // 2^-53
+        for (int k = 0; k < m; k++) {
+            u1[k] = ((splitmix64(key + 2 * k) >> 11) + 1) * SCALE; // (0, 1]
+            u2[k] = (splitmix64(key + 2 * k + 1) >> 11) * SCALE; // [0, 1)
+        }
+        for (int k = 0; k < m; k++) {
+            const double r = std * sqrt(-2.0 * log(u1[k]));
+            const double t = 2.0 * M_PI * u2[k];
+            out[2 * k] = r * cos(t);
+            if (2 * k + 1 < n) out[2 * k + 1] = r * sin(t);
+        }
+    }
+}
+
 template<class T>
 double norm(const std::vector<T> &v2) {
     double n = 0;
@@ -266,14 +478,14 @@ double elev(const std::vector<double> &a, const std::vector<double> &b) {
 
 
 std::vector<double> &get_plor_vector_on_x(double rad, double R = 1.0) {
-    static std::vector<double> v(2);
+    static thread_local std::vector<double> v(2);
     v[0] = R * cos(rad);
     v[1] = R * sin(rad);
     return v;
 }
 
 std::vector<double> &get_plor_vector_on_y(double rad, double R = 1.0) {
-    static std::vector<double> v(2);
+    static thread_local std::vector<double> v(2);
     v[0] = -R * sin(rad);
     v[1] = R * cos(rad);
     return v;
@@ -291,7 +503,7 @@ std::vector<double> &get_rot2(const double rad, const std::vector<double> &v2) {
         std::cerr << "#error: v2.size() != 2, @get_rot2()" << std::endl;
         exit(1);
     }
-    static std::vector<double> ans(2);
+    static thread_local std::vector<double> ans(2);
     ans[0] = cos(rad) * v2[0] - sin(rad) * v2[1];
     ans[1] = sin(rad) * v2[0] + cos(rad) * v2[1];
     return ans;
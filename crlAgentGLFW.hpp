@@ -16,6 +16,9 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include <mutex>
+#include <chrono>
+#include <utility>
 
 #define EXP_DIM 2 // 実験環境次元
 
@@ -78,12 +81,31 @@ class crlAgentGLFW : public crlGLFW {
     bool m_shakedown;
     double m_lp[2]; // last mouse position
     std::vector<double> m_mv; // mouse input vector
+    mutable std::mutex m_mv_mtx; // m_mv is written by the GLFW thread
+
+    // snapshot of all objects published by the simulation
+    struct frame_t {
+        double t; // publish time [sec] (steady clock)
+        std::vector<std::vector<double>> pos;
+        std::vector<std::vector<double>> color;
+        std::vector<double> radius;
+        std::vector<bool> fill;
+    };
+    frame_t m_frame[2]; // [0]: previous, [1]: latest
+    int m_frame_num; // number of published frames (up to 2)
+    std::mutex m_frame_mtx;
+    frame_t m_draw; // objects at display time (GLFW thread only)
+    bool m_interp; // interpolate between the two latest snapshots
+    double m_field; // field size (toroidal: [-m_field, m_field])
     bool m_act; // mouse action
 
 public:
     crlAgentGLFW() : crlGLFW() {
         m_init_flg = false;
         m_g_s = 0.95;
+        m_frame_num = 0;
+        m_interp = true;
+        m_field = 1.0;
     }
 
     bool init(int object_num, double field_size) {
@@ -94,6 +116,7 @@ public:
         }
 
         m_s = 1 / (field_size);
+        m_field = field_size;
         m_init_flg = true;
         m_object_num = object_num;
         m_x_pos.assign(object_num, std::vector<double>(EXP_DIM, 0.0));
@@ -196,6 +219,11 @@ public:
         show_background();
 
         glLineWidth(2.0);
+        if (make_draw_frame()) {
+            for (int i = 0; i < (int) m_draw.pos.size(); i++)
+                put_object(m_draw.pos[i], m_draw.radius[i], m_draw.color[i], m_s*m_g_s, m_draw.fill[i]);
+            return;
+        }
         for (int i = 0; i < m_object_num; i++) {
             put_object(m_x_pos[i], m_x_radius[i], m_x_color[i], m_s*m_g_s, m_x_fill[i]);
             //std::cout <<"#debug["<<i<<"]: rad: "<<m_x_radius[i]<< ", pos: (" << m_x_pos[i][0] << ", " << m_x_pos[i][1] << ")" << std::endl;
@@ -221,6 +249,25 @@ public:
         return true;
     }
 
+    // publish the objects set by set_obj() as the latest snapshot (once per simulation step)
+    void publish_frame() {
+        const double t = now_sec();
+        std::lock_guard<std::mutex> lk(m_frame_mtx);
+        std::swap(m_frame[0], m_frame[1]);
+        frame_t &f = m_frame[1];
+        f.t = t;
+        f.pos = m_x_pos;
+        f.color = m_x_color;
+        f.radius = m_x_radius;
+        f.fill = m_x_fill;
+        if (m_frame_num < 2) m_frame_num++;
+    }
+
+    // draw positions interpolated between the two latest snapshots (false: draw the latest snapshot)
+    void set_interpolation(bool flg) {
+        m_interp = flg;
+    }
+
     bool set_ope(const std::vector<double> &pos) {
         if (pos.size() != EXP_DIM) {
             std::cerr << "#error: pos size is not EXP_DIM: " << EXP_DIM << ". @set_ope()" << std::endl;
@@ -258,7 +305,15 @@ public:
         return m_mv;
     }
 
+    // copy of the mouse input vector (safe to call from the simulation thread)
+    void get_mv(double *mv) const {
+        std::lock_guard<std::mutex> lk(m_mv_mtx);
+        mv[0] = m_mv[0];
+        mv[1] = m_mv[1];
+    }
+
     bool set_mv0() {
+        std::lock_guard<std::mutex> lk(m_mv_mtx);
         m_mv[0] = 0.0;
         m_mv[1] = 0.0;
         return true;
@@ -287,6 +342,39 @@ public:
         glfwTerminate();
     }
 
+    static double now_sec() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // objects at display time into m_draw (false: nothing published yet)
+    //   the display runs one publish interval behind the latest snapshot, so that it always lies
+    //   between the previous and the latest one; moves across the field edge are interpolated
+    //   the short way around the torus
+    bool make_draw_frame() {
+        std::lock_guard<std::mutex> lk(m_frame_mtx);
+        if (m_frame_num == 0) return false;
+        const frame_t &f0 = m_frame[0];
+        const frame_t &f1 = m_frame[1];
+        m_draw = f1;
+        if (!m_interp || m_frame_num < 2 || f1.t <= f0.t || f0.pos.size() != f1.pos.size()) return true;
+        double a = (now_sec() - f1.t) / (f1.t - f0.t);
+        if (a < 0.0) a = 0.0;
+        if (a > 1.0) a = 1.0;
+        const double w = 2.0 * m_field;
+        for (int i = 0; i < (int) f1.pos.size(); i++) {
+            for (int d = 0; d < (int) f1.pos[i].size() && d < (int) f0.pos[i].size(); d++) {
+                double dx = f1.pos[i][d] - f0.pos[i][d];
+                if (dx > m_field) dx -= w; // wrapped across the edge
+                else if (dx < -m_field) dx += w;
+                double x = f0.pos[i][d] + a * dx;
+                if (x > m_field) x -= w;
+                else if (x < -m_field) x += w;
+                m_draw.pos[i][d] = x;
+            }
+        }
+        return true;
+    }
+
     void keyFun(int key, int scancode, int action, int mods) {
         if (action == GLFW_PRESS && (key == GLFW_KEY_ESCAPE || key == GLFW_KEY_Q)) {
             glfwTerminate();
@@ -317,6 +405,7 @@ public:
         m_mv[1] = - (y - m_lp[1])/100.0;
         std::cout << "#debug: mv: ["<< m_mv[0] << ", " << m_mv[1] << "]" << std::endl;
 */
+        std::lock_guard<std::mutex> lk(m_mv_mtx);
         if (m_act) {
             m_mv[0] = (x - m_lp[0]) / 2.0;
             m_mv[1] = -(y - m_lp[1]) / 2.0;
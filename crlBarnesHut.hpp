@@ -0,0 +1,464 @@
+/***************************************************************************
+ * crlBarnesHut.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * トロイダルなフィールド上の Barnes-Hut 近似による遠方場の総和（2次元: 四分木, 3次元: 八分木）
+ *   crlBarnesHut bh;
+ *   bh.set_theta(0.5);              // 開き角（小さいほど正確）
+ *   bh.build(world);                // 木の構築（重みは全て 1，build(world, w) で重みを指定）
+ *   bh.compute(world, kernel);      // 全エージェント i について F_i = Σ_j kernel
+ *   bh.to_input(world);             // F を入力 u(d) に書き込む
+ * build(world, w, pool), compute(world, kernel, pool) は crlThreadPool で並列に行う。
+ * （build() の並列化: Morton 符号の計算と基数ソートをブロックごとに分け，木は部分木がワーカー数の数倍になるまで分割して並列に構築する）
+ * kernel(r, r2, w, f) は相対位置 r（i から相手への最小イメージ, r2 = |r|^2）にある重み w の相手からの寄与を f に加える。
+ * 節の幅 s と重心までの距離 d が s < theta * d のとき，節の中身を重心・重みの合計で近似する。
+ * 相対位置は get_toroidal_vector2 と同じく各軸の最小イメージ（|r_d| <= size_d / 2）とし，
+ * 節全体が最小イメージの範囲に収まらないときは近似せずに開く。
+ *****************************************************************************/
+
+#ifndef CRL_BARNES_HUT_HPP
+#define CRL_BARNES_HUT_HPP
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "crlAgentArray.hpp"
+#include "crlSpatialGrid.hpp"
+
+#define BH_LEAF_SIZE 8 // 葉に入れるエージェント数の上限
+#define BH_TASK_PER_WORKER 4 // 並列構築でワーカーあたりに作る部分木・ソートのブロックの数
+#define BH_SORT_BLOCK_MIN 1024 // 基数ソートのブロックの最小要素数
+
+template<int DIM>
+class crlBarnesHutT {
+    static const int CHILD = 1 << DIM; // 子の数
+    static const int BITS = (DIM == 3) ? 21 : 31; // 軸ごとの Morton 符号のビット数（木の深さの上限）
+
+    struct node_t {
+        double com[DIM]; // 重心
+        double w; // 重みの合計
+        double center[DIM], half[DIM]; // 箱の中心・半幅
+        int child[CHILD]; // 子の節番号（なければ -1）
+        int begin, end; // 含まれるエージェント（m_order の範囲）
+        bool leaf;
+    };
+
+    // 並列に構築する部分木
+    struct task_t {
+        node_t box; // 箱と範囲
+        int level; // build_node() の level
+        int parent, q; // 親の節（m_node）と子番号
+    };
+
+    typedef std::pair<uint64_t, int> key_index_t; // (Morton 符号, エージェント番号)
+
+    std::vector<node_t> m_node; // m_node[0] が根
+    std::vector<task_t> m_task; // 並列構築用
+    std::vector<std::vector<node_t> > m_sub; // m_task ごとの部分木
+    std::vector<uint64_t> m_key; // Morton 符号（m_order の順）
+    std::vector<int> m_order; // Morton 符号順のエージェント番号
+    std::vector<double> m_p[DIM]; // m_order 順の位置
+    std::vector<double> m_w; // m_order 順の重み
+    std::vector<double> m_F[DIM]; // compute() の結果
+    double m_min[DIM], m_size[DIM];
+    double m_theta;
+
+public:
+    crlBarnesHutT() {
+        m_theta = 0.5;
+        for (int d = 0; d < DIM; d++)
+            m_min[d] = m_size[d] = 0.0;
+    }
+
+    bool set_theta(double theta) {
+        if (theta < 0.0 || theta > 1.0) {
+            std::cerr << "#error: theta: " << theta << " is out of [0, 1]. @crlBarnesHut::set_theta()" << std::endl;
+            return false;
+        }
+        m_theta = theta;
+        return true;
+    }
+
+    double get_theta() const { return m_theta; }
+
+    int get_node_num() const { return (int) m_node.size(); }
+
+    // compute() の結果（エージェント i, 軸 d）
+    double get_field(int i, int d) const { return m_F[d][i]; }
+
+    const double *field(int d) const { return m_F[d].data(); }
+
+    bool build(const crlAgentArrayT<DIM> &world) {
+        std::vector<double> w(world.size(), 1.0);
+        return build(world, w.data());
+    }
+
+    // 重み w[i] で木を構築する
+    bool build(const crlAgentArrayT<DIM> &world, const double *w) {
+        node_t root;
+        if (!sort_agents(world, w, root)) return false;
+        build_node(m_node, root, BITS);
+        return true;
+    }
+
+    // 重み w[i] で木を構築する（結果は build(world, w) と一致）
+    //   上位の節を逐次に分割して，エージェント数が num / (BH_TASK_PER_WORKER * ワーカー数) 以下の部分木を並列に構築してつなぐ
+    bool build(const crlAgentArrayT<DIM> &world, const double *w, crlThreadPool &pool) {
+        node_t root;
+        if (!sort_agents(world, w, root, &pool)) return false;
+        const int grain = std::max(BH_LEAF_SIZE, root.end / (BH_TASK_PER_WORKER * pool.size()));
+        if (root.end <= grain || pool.size() == 1) {
+            build_node(m_node, root, BITS);
+            return true;
+        }
+        // 上位の節（幅優先で m_node に置く）と部分木の分割
+        m_task.clear();
+        m_task.push_back({root, BITS, -1, 0});
+        for (int t = 0; t < (int) m_task.size();) {
+            task_t k = m_task[t];
+            if (k.box.end - k.box.begin <= grain || k.level == 0) {
+                t++;
+                continue;
+            }
+            m_task.erase(m_task.begin() + t);
+            const int self = (int) m_node.size();
+            node_t n = k.box;
+            n.leaf = false;
+            for (int c = 0; c < CHILD; c++)
+                n.child[c] = -1;
+            m_node.push_back(n);
+            if (k.parent >= 0) m_node[k.parent].child[k.q] = self;
+            int split[CHILD + 1];
+            split_range(n.begin, n.end, k.level - 1, split);
+            for (int q = 0; q < CHILD; q++) {
+                if (split[q] == split[q + 1]) continue;
+                node_t c = child_box(n, q);
+                c.begin = split[q];
+                c.end = split[q + 1];
+                m_task.push_back({c, k.level - 1, self, q});
+            }
+        }
+        const int top_num = (int) m_node.size();
+        m_sub.resize(m_task.size());
+        pool.parallel_for(0, (long) m_task.size(), [&](long b, long e, int) {
+            for (long t = b; t < e; t++) {
+                m_sub[t].clear();
+                build_node(m_sub[t], m_task[t].box, m_task[t].level);
+            }
+        });
+        for (int t = 0; t < (int) m_task.size(); t++) {
+            const int offset = (int) m_node.size();
+            m_node[m_task[t].parent].child[m_task[t].q] = offset;
+            for (const node_t &n : m_sub[t]) {
+                m_node.push_back(n);
+                for (int c = 0; c < CHILD; c++)
+                    if (m_node.back().child[c] >= 0) m_node.back().child[c] += offset;
+            }
+        }
+        // 上位の節の重心（子は親より後にあるので逆順に，build_node() と同じ順序で足す）
+        for (int t = top_num - 1; t >= 0; t--) {
+            node_t &n = m_node[t];
+            n.w = 0.0;
+            for (int d = 0; d < DIM; d++)
+                n.com[d] = 0.0;
+            for (int q = 0; q < CHILD; q++) {
+                if (n.child[q] < 0) continue;
+                const node_t &s = m_node[n.child[q]];
+                n.w += s.w;
+                for (int d = 0; d < DIM; d++)
+                    n.com[d] += s.w * s.com[d];
+            }
+            if (n.w > 0.0) {
+                for (int d = 0; d < DIM; d++)
+                    n.com[d] /= n.w;
+            } else {
+                for (int d = 0; d < DIM; d++)
+                    n.com[d] = n.center[d];
+            }
+        }
+        return true;
+    }
+
+    // 位置 p での F = Σ_j kernel（exclude 番のエージェントを除く）
+    template<class K>
+    void evaluate(const double *p, const K &kernel, double *f, int exclude = -1) const {
+        for (int d = 0; d < DIM; d++)
+            f[d] = 0.0;
+        if (m_node.empty()) return;
+        int stack[64 * CHILD];
+        int top = 0;
+        stack[top++] = 0;
+        const double th2 = m_theta * m_theta;
+        while (top > 0) {
+            const node_t &n = m_node[stack[--top]];
+            double r[DIM];
+            if (n.leaf) {
+                for (int k = n.begin; k < n.end; k++) {
+                    if (m_order[k] == exclude) continue;
+                    double r2 = 0.0;
+                    for (int d = 0; d < DIM; d++) {
+                        r[d] = ac::min_image(m_p[d][k] - p[d], m_size[d]);
+                        r2 += r[d] * r[d];
+                    }
+                    kernel(r, r2, m_w[k], f);
+                }
+                continue;
+            }
+            // 節が最小イメージの範囲に収まり，p を含まず，十分遠ければ重心で近似
+            bool inside = true, far = true;
+            double r2 = 0.0, s = 0.0;
+            for (int d = 0; d < DIM; d++) {
+                double bc = fabs(ac::min_image(n.center[d] - p[d], m_size[d]));
+                far = far && (bc + n.half[d] <= 0.5 * m_size[d]);
+                inside = inside && (bc <= n.half[d]);
+                r[d] = ac::min_image(n.com[d] - p[d], m_size[d]);
+                r2 += r[d] * r[d];
+                if (2.0 * n.half[d] > s) s = 2.0 * n.half[d];
+            }
+            if (far && !inside && s * s < th2 * r2) {
+                kernel(r, r2, n.w, f);
+                continue;
+            }
+            for (int c = 0; c < CHILD; c++)
+                if (n.child[c] >= 0) stack[top++] = n.child[c];
+        }
+    }
+
+    // 全エージェントについて F_i = Σ_{j != i} kernel
+    template<class K>
+    void compute(const crlAgentArrayT<DIM> &world, K kernel) {
+        for (int d = 0; d < DIM; d++)
+            m_F[d].assign(world.size(), 0.0);
+        compute_range(world, kernel, 0, world.size());
+    }
+
+    // compute() をスレッドプールで並列に行う（結果は compute() と一致）
+    template<class K>
+    void compute(const crlAgentArrayT<DIM> &world, K kernel, crlThreadPool &pool) {
+        for (int d = 0; d < DIM; d++)
+            m_F[d].assign(world.size(), 0.0);
+        pool.parallel_for(0, world.size(), [&](long b, long e, int) {
+            compute_range(world, kernel, (int) b, (int) e);
+        }, 16);
+    }
+
+    // F を入力 u(d) に書き込む（add = true なら加える）
+    void to_input(crlAgentArrayT<DIM> &world, bool add = false) const {
+        for (int d = 0; d < DIM; d++) {
+            ac::real_t *u = world.u(d);
+            const double *F = m_F[d].data();
+            for (int i = 0; i < world.size(); i++)
+                u[i] = add ? u[i] + F[i] : F[i];
+        }
+    }
+
+private:
+
+    // エージェントを Morton 符号順に並べ，根の箱を root に設定する（pool があれば並列に行う）
+    bool sort_agents(const crlAgentArrayT<DIM> &world, const double *w, node_t &root, crlThreadPool *pool = nullptr) {
+        const int num = world.size();
+        const ac::field_environment_t &env = world.get_env();
+        for (int d = 0; d < DIM; d++) {
+            m_min[d] = ac::field_min(env, d);
+            m_size[d] = ac::field_max(env, d) - ac::field_min(env, d);
+            if (m_size[d] <= 0.0) {
+                std::cerr << "#error: field size is not positive. @crlBarnesHut::build()" << std::endl;
+                return false;
+            }
+        }
+        m_node.clear();
+        // Morton 符号で並べ替え
+        std::vector<key_index_t> kv(num);
+        auto make_key = [&](long b, long e, int) {
+            for (long i = b; i < e; i++) {
+                double p[DIM];
+                for (int d = 0; d < DIM; d++)
+                    p[d] = world.pos(d)[i];
+                kv[i] = std::make_pair(morton(p), (int) i);
+            }
+        };
+        m_key.resize(num);
+        m_order.resize(num);
+        m_w.resize(num);
+        for (int d = 0; d < DIM; d++)
+            m_p[d].resize(num);
+        auto gather = [&](long b, long e, int) {
+            for (long k = b; k < e; k++) {
+                m_key[k] = kv[k].first;
+                m_order[k] = kv[k].second;
+                m_w[k] = w[kv[k].second];
+                for (int d = 0; d < DIM; d++) {
+                    double x = (world.pos(d)[kv[k].second] - m_min[d]) / m_size[d];
+                    m_p[d][k] = m_min[d] + (x - floor(x)) * m_size[d]; // フィールド内に折り返す
+                }
+            }
+        };
+        if (pool == nullptr || pool->size() == 1) {
+            make_key(0, num, 0);
+            std::sort(kv.begin(), kv.end());
+            gather(0, num, 0);
+        } else {
+            pool->parallel_for(0, num, make_key, 256);
+            radix_sort(kv, *pool);
+            pool->parallel_for(0, num, gather, 256);
+        }
+
+        for (int d = 0; d < DIM; d++) {
+            root.half[d] = 0.5 * m_size[d];
+            root.center[d] = m_min[d] + root.half[d];
+        }
+        root.begin = 0;
+        root.end = num;
+        return true;
+    }
+
+    // kv を (符号, 番号) の順に並べる（結果は std::sort() と一致）
+    //   8 ビットずつの LSD 基数ソート。ブロックごとの頻度表から書き込み位置を決めるので，振り分けもブロックごとに並列に行える
+    void radix_sort(std::vector<key_index_t> &kv, crlThreadPool &pool) const {
+        const long num = (long) kv.size();
+        long block = std::min((long) BH_TASK_PER_WORKER * pool.size(), num / BH_SORT_BLOCK_MIN);
+        if (block < 1) block = 1;
+        std::vector<key_index_t> tmp(num);
+        std::vector<long> hist(block * 256);
+        auto range = [&](long t, long &b, long &e) {
+            b = num * t / block;
+            e = num * (t + 1) / block;
+        };
+        for (int shift = 0; shift < BITS * DIM; shift += 8) {
+            pool.parallel_for(0, block, [&](long tb, long te, int) {
+                for (long t = tb; t < te; t++) {
+                    long *h = &hist[t * 256], b, e;
+                    std::fill(h, h + 256, 0L);
+                    range(t, b, e);
+                    for (long k = b; k < e; k++)
+                        h[(kv[k].first >> shift) & 255]++;
+                }
+            });
+            // 桁 → ブロックの順に書き込み位置を割り当てる（全要素が同じ桁なら並びは変わらない）
+            long sum = 0;
+            bool same = false;
+            for (int r = 0; r < 256; r++) {
+                const long s0 = sum;
+                for (long t = 0; t < block; t++) {
+                    const long c = hist[t * 256 + r];
+                    hist[t * 256 + r] = sum;
+                    sum += c;
+                }
+                same = same || (sum - s0 == num);
+            }
+            if (same) continue;
+            pool.parallel_for(0, block, [&](long tb, long te, int) {
+                for (long t = tb; t < te; t++) {
+                    long *h = &hist[t * 256], b, e;
+                    range(t, b, e);
+                    for (long k = b; k < e; k++)
+                        tmp[h[(kv[k].first >> shift) & 255]++] = kv[k];
+                }
+            });
+            kv.swap(tmp);
+        }
+    }
+
+    template<class K>
+    void compute_range(const crlAgentArrayT<DIM> &world, const K &kernel, int b, int e) {
+        double p[DIM], f[DIM];
+        for (int i = b; i < e; i++) {
+            for (int d = 0; d < DIM; d++)
+                p[d] = world.pos(d)[i];
+            evaluate(p, kernel, f, i);
+            for (int d = 0; d < DIM; d++)
+                m_F[d][i] = f[d];
+        }
+    }
+
+    // 位置 p の Morton 符号（軸 0 が各桁の最下位ビット）
+    uint64_t morton(const double *p) const {
+        const uint64_t cell = (uint64_t) 1 << BITS;
+        uint64_t key = 0;
+        uint64_t k[DIM];
+        for (int d = 0; d < DIM; d++) {
+            double x = (p[d] - m_min[d]) / m_size[d];
+            x -= floor(x); // フィールド外はトロイダルに折り返す
+            k[d] = (uint64_t) (x * cell);
+            if (k[d] >= cell) k[d] = cell - 1;
+        }
+        for (int b = BITS - 1; b >= 0; b--)
+            for (int d = DIM - 1; d >= 0; d--)
+                key = (key << 1) | ((k[d] >> b) & 1);
+        return key;
+    }
+
+    // [b, e) を level 桁目（上位から）の子番号で分割する
+    void split_range(int b, int e, int level, int *split) const {
+        split[0] = b;
+        for (int q = 1; q < CHILD; q++) {
+            const uint64_t lo = (uint64_t) q << (level * DIM);
+            const uint64_t mask = (uint64_t) (CHILD - 1) << (level * DIM);
+            int k = split[q - 1];
+            while (k < e && (m_key[k] & mask) < lo)
+                k++;
+            split[q] = k;
+        }
+        split[CHILD] = e;
+    }
+
+    node_t child_box(const node_t &n, int q) const {
+        node_t c;
+        for (int d = 0; d < DIM; d++) {
+            c.half[d] = 0.5 * n.half[d];
+            c.center[d] = n.center[d] + (((q >> d) & 1) ? c.half[d] : -c.half[d]);
+        }
+        return c;
+    }
+
+    // n（箱と範囲を設定済み）を根とする部分木を pool に構築する（n は pool の末尾に入る）
+    //   level: n の子を分ける桁 + 1（0 なら分割できない）
+    void build_node(std::vector<node_t> &pool, node_t n, int level) const {
+        const int self = (int) pool.size();
+        n.leaf = (n.end - n.begin <= BH_LEAF_SIZE) || (level == 0);
+        n.w = 0.0;
+        for (int d = 0; d < DIM; d++)
+            n.com[d] = 0.0;
+        for (int c = 0; c < CHILD; c++)
+            n.child[c] = -1;
+        pool.push_back(n);
+        if (n.leaf) {
+            for (int k = n.begin; k < n.end; k++) {
+                n.w += m_w[k];
+                for (int d = 0; d < DIM; d++)
+                    n.com[d] += m_w[k] * m_p[d][k];
+            }
+        } else {
+            int split[CHILD + 1];
+            split_range(n.begin, n.end, level - 1, split);
+            for (int q = 0; q < CHILD; q++) {
+                if (split[q] == split[q + 1]) continue;
+                node_t c = child_box(n, q);
+                c.begin = split[q];
+                c.end = split[q + 1];
+                n.child[q] = (int) pool.size();
+                build_node(pool, c, level - 1);
+                const node_t &s = pool[n.child[q]];
+                n.w += s.w;
+                for (int d = 0; d < DIM; d++)
+                    n.com[d] += s.w * s.com[d];
+            }
+        }
+        if (n.w > 0.0) {
+            for (int d = 0; d < DIM; d++)
+                n.com[d] /= n.w;
+        } else {
+            for (int d = 0; d < DIM; d++)
+                n.com[d] = n.center[d];
+        }
+        pool[self] = n;
+    }
+};
+
+typedef crlBarnesHutT<U_SIZE> crlBarnesHut; // 2次元
+
+#endif // CRL_BARNES_HUT_HPP
@@ -0,0 +1,299 @@
+/***************************************************************************
+ * crlBehavior.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * C++20 のコルーチンによるエージェントの行動記述（状態機械を手で書かずに，手順として書く）
+ *   crlBehavior patrol(crlBehaviorContext &ctx, double speed) {
+ *       while (true) {
+ *           ctx.set_input(speed, 0.0);
+ *           co_await ctx.wait_ticks(30);        // 30 ステップ待つ
+ *           ctx.set_input(0.0, speed);
+ *           co_await ctx.until_near(3, 10.0);   // エージェント 3 との距離が 10.0 未満になるまで待つ
+ *           co_await ctx.next_tick();           // 次のステップまで待つ
+ *       }
+ *   }
+ *   crlBehaviorScheduler<crlAgent> sched;
+ *   sched.spawn(agent, 0, patrol, 5.0);   // エージェント 0 の行動（第1引数は crlBehaviorContext &）
+ *   sched.tick(agent, sec);               // 毎ステップ: 待ち条件を満たした行動を再開する
+ *   agent[i].drive(sched.get_input(i), agent, SAMPLING_TIME);
+ * 待ち条件はスケジューラが判定し，満たした行動だけを再開する（再開は関数呼び出し1回）。
+ * コルーチンのフレームはサイズごとの空きリスト（スレッドごと）から確保し，使い回す。
+ *****************************************************************************/
+
+#ifndef CRL_BEHAVIOR_HPP
+#define CRL_BEHAVIOR_HPP
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <new>
+#include "crlAgentCore.hpp"
+
+#define BEHAVIOR_FRAME_CLASS 64 // フレームの大きさの刻み [byte]
+#define BEHAVIOR_FRAME_MAX 4096 // これより大きいフレームは空きリストを使わない [byte]
+#define BEHAVIOR_FRAME_CHUNK 65536 // 空きリストに補充するときにまとめて確保する大きさ [byte]
+
+namespace agentcore {
+    // コルーチンのフレームの空きリスト（大きさ BEHAVIOR_FRAME_CLASS 刻み，スレッドごと）
+    struct frame_pool_t {
+        void *FREE[BEHAVIOR_FRAME_MAX / BEHAVIOR_FRAME_CLASS + 1];
+        std::vector<std::unique_ptr<char[]> > CHUNK;
+    };
+
+    frame_pool_t &frame_pool() {
+        thread_local frame_pool_t pool = {};
+        return pool;
+    }
+
+    void *frame_alloc(size_t n) {
+        if (n > BEHAVIOR_FRAME_MAX) return ::operator new(n);
+        const size_t k = (n + BEHAVIOR_FRAME_CLASS - 1) / BEHAVIOR_FRAME_CLASS;
+        frame_pool_t &pool = frame_pool();
+        if (pool.FREE[k] == nullptr) { // 補充する
+            const size_t size = k * BEHAVIOR_FRAME_CLASS;
+            char *chunk = new char[BEHAVIOR_FRAME_CHUNK];
+            pool.CHUNK.emplace_back(chunk);
+            for (size_t ofs = 0; ofs + size <= BEHAVIOR_FRAME_CHUNK; ofs += size) {
+                *(void **) (chunk + ofs) = pool.FREE[k];
+                pool.FREE[k] = chunk + ofs;
+            }
+        }
+        void *p = pool.FREE[k];
+        pool.FREE[k] = *(void **) p;
+        return p;
+    }
+
+    void frame_free(void *p, size_t n) {
+        if (n > BEHAVIOR_FRAME_MAX) {
+            ::operator delete(p);
+            return;
+        }
+        const size_t k = (n + BEHAVIOR_FRAME_CLASS - 1) / BEHAVIOR_FRAME_CLASS;
+        frame_pool_t &pool = frame_pool();
+        *(void **) p = pool.FREE[k];
+        pool.FREE[k] = p;
+    }
+}
+
+class crlBehaviorContext;
+
+// エージェントの行動（コルーチン）
+class crlBehavior {
+public:
+    enum { WAIT_TICK = 0, WAIT_NEAR };
+
+    struct promise_type {
+        crlBehaviorContext *CTX;
+        int WAIT; // 待ち条件
+        long UNTIL; // WAIT_TICK: このステップ以降に再開
+        int TARGET; // WAIT_NEAR: 相手のエージェント
+        double DIST; // WAIT_NEAR: この距離未満になったら再開
+
+        // 行動の第1引数の crlBehaviorContext を受け取る
+        template<class... Args>
+        promise_type(crlBehaviorContext &ctx, Args &&...) : CTX(&ctx), WAIT(WAIT_TICK), UNTIL(0), TARGET(-1), DIST(0.0) {}
+
+        crlBehavior get_return_object() {
+            return crlBehavior(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; } // 最初の tick() で開始する
+
+        std::suspend_always final_suspend() noexcept { return {}; }
+
+        void return_void() {}
+
+        void unhandled_exception() { std::terminate(); }
+
+        static void *operator new(size_t n) { return ac::frame_alloc(n); }
+
+        static void operator delete(void *p, size_t n) { ac::frame_free(p, n); }
+    };
+
+    typedef std::coroutine_handle<promise_type> handle_t;
+
+    crlBehavior() {}
+
+    explicit crlBehavior(handle_t h) : m_h(h) {}
+
+    crlBehavior(crlBehavior &&b) noexcept : m_h(std::exchange(b.m_h, nullptr)) {}
+
+    crlBehavior &operator=(crlBehavior &&b) noexcept {
+        if (this != &b) {
+            if (m_h) m_h.destroy();
+            m_h = std::exchange(b.m_h, nullptr);
+        }
+        return *this;
+    }
+
+    crlBehavior(const crlBehavior &) = delete;
+
+    crlBehavior &operator=(const crlBehavior &) = delete;
+
+    ~crlBehavior() {
+        if (m_h) m_h.destroy();
+    }
+
+    handle_t handle() const { return m_h; }
+
+    bool done() const { return !m_h || m_h.done(); }
+
+private:
+    handle_t m_h;
+};
+
+// 待ち条件を設定して中断する（co_await で使う）
+struct crlBehaviorAwaiter {
+    int WAIT;
+    long UNTIL;
+    int TARGET;
+    double DIST;
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(crlBehavior::handle_t h) const noexcept {
+        crlBehavior::promise_type &p = h.promise();
+        p.WAIT = WAIT;
+        p.UNTIL = UNTIL;
+        p.TARGET = TARGET;
+        p.DIST = DIST;
+    }
+
+    void await_resume() const noexcept {}
+};
+
+// 行動ごとの状態（エージェント番号・時刻・入力）
+class crlBehaviorContext {
+    int m_id;
+    long m_tick;
+    double m_sec;
+    double m_u[U_SIZE]; // 行動が決めた入力（変えるまで保持する）
+
+    template<class T> friend
+    class crlBehaviorScheduler;
+
+public:
+    explicit crlBehaviorContext(int id) : m_id(id), m_tick(0), m_sec(0.0) {
+        for (int d = 0; d < U_SIZE; d++)
+            m_u[d] = 0.0;
+    }
+
+    int get_id() const { return m_id; }
+
+    long get_tick() const { return m_tick; }
+
+    double get_sec() const { return m_sec; }
+
+    void set_input(double ux, double uy) {
+        m_u[0] = ux;
+        m_u[1] = uy;
+    }
+
+    void set_input(const std::vector<double> &u) {
+        for (int d = 0; d < U_SIZE && d < (int) u.size(); d++)
+            m_u[d] = u[d];
+    }
+
+    const double *get_input() const { return m_u; }
+
+    // 次のステップまで待つ
+    crlBehaviorAwaiter next_tick() const { return {crlBehavior::WAIT_TICK, m_tick + 1, -1, 0.0}; }
+
+    // n ステップ待つ
+    crlBehaviorAwaiter wait_ticks(long n) const { return {crlBehavior::WAIT_TICK, m_tick + (n > 0 ? n : 0), -1, 0.0}; }
+
+    // エージェント id との距離が dist 未満になるまで待つ（毎ステップ判定する）
+    crlBehaviorAwaiter until_near(int id, double dist) const { return {crlBehavior::WAIT_NEAR, 0, id, dist}; }
+};
+
+// 行動のスケジューラ（T: エージェントのクラス, get_dist() で距離を求める）
+template<class T>
+class crlBehaviorScheduler {
+    struct script_t {
+        std::unique_ptr<crlBehaviorContext> ctx; // 行動が参照するので位置を固定する
+        crlBehavior co;
+    };
+
+    std::vector<script_t> m_script;
+    std::vector<int> m_script_of; // エージェントごとの行動の番号（-1: なし）
+    long m_tick;
+    long m_resume_num; // 直前の tick() で再開した数
+
+public:
+    crlBehaviorScheduler() {
+        m_tick = 0;
+        m_resume_num = 0;
+    }
+
+    // エージェント id の行動 fn(ctx, args...) を登録する（同じエージェントの以前の行動は破棄）
+    template<class F, class... Args>
+    bool spawn(const std::vector<T> &agent, int id, F fn, Args &&... args) {
+        if (id < 0 || id >= (int) agent.size()) {
+            std::cerr << "#error: id: " << id << " is out of [0, " << agent.size() << ") @crlBehaviorScheduler::spawn()";
+            std::cerr << std::endl;
+            return false;
+        }
+        if ((int) m_script_of.size() < (int) agent.size()) m_script_of.resize(agent.size(), -1);
+        script_t s;
+        s.ctx.reset(new crlBehaviorContext(id));
+        s.ctx->m_tick = m_tick;
+        s.co = fn(*s.ctx, std::forward<Args>(args)...);
+        if (m_script_of[id] >= 0) {
+            m_script[m_script_of[id]] = std::move(s);
+        } else {
+            m_script_of[id] = (int) m_script.size();
+            m_script.push_back(std::move(s));
+        }
+        return true;
+    }
+
+    // 待ち条件を満たした行動を再開する（1ステップに1回）
+    void tick(std::vector<T> &agent, double sec) {
+        m_resume_num = 0;
+        for (script_t &s : m_script) {
+            if (s.co.done()) continue;
+            const crlBehavior::promise_type &p = s.co.handle().promise();
+            bool ready;
+            if (p.WAIT == crlBehavior::WAIT_TICK) {
+                ready = m_tick >= p.UNTIL;
+            } else {
+                ready = p.TARGET >= 0 && p.TARGET < (int) agent.size() &&
+                        agent[s.ctx->m_id].get_dist(agent[p.TARGET]) < p.DIST;
+            }
+            if (!ready) continue;
+            s.ctx->m_tick = m_tick;
+            s.ctx->m_sec = sec;
+            s.co.handle().resume();
+            m_resume_num++;
+        }
+        m_tick++;
+    }
+
+    // エージェント i の行動が決めた入力（行動がなければ 0）
+    std::vector<double> get_input(int i) const {
+        std::vector<double> u(U_SIZE, 0.0);
+        if (i < 0 || i >= (int) m_script_of.size() || m_script_of[i] < 0) return u;
+        const double *v = m_script[m_script_of[i]].ctx->get_input();
+        for (int d = 0; d < U_SIZE; d++)
+            u[d] = v[d];
+        return u;
+    }
+
+    bool has_behavior(int i) const { return i >= 0 && i < (int) m_script_of.size() && m_script_of[i] >= 0; }
+
+    // エージェント i の行動が終わった（または行動がない）
+    bool is_done(int i) const { return !has_behavior(i) || m_script[m_script_of[i]].co.done(); }
+
+    int get_script_num() const { return (int) m_script.size(); }
+
+    long get_resume_num() const { return m_resume_num; }
+
+    long get_tick() const { return m_tick; }
+};
+
+#endif // CRL_BEHAVIOR_HPP
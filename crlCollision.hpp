@@ -0,0 +1,271 @@
+/***************************************************************************
+ * crlCollision.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * トロイダルなフィールド上の連続衝突判定（円の掃引による接触時刻 TOI の計算）
+ *   crlCollision col;
+ *   col.drive(world, SAMPLING_TIME); // drive_all() + ステップ内の接触の解決
+ * ステップ開始位置から終了位置までを直線移動とみなし，2体の相対移動から
+ * |r0 + t・dr| = R_i + R_j となる最初の t (0 <= t <= 1) を求める。
+ * 接触したエージェントは接触位置まで戻し，接触法線方向の速度を取り除いて残り時間を接線方向に進める。
+ * （1ステップにつき1回の解決。同じステップ内の連鎖的な接触は次のステップで解決される）
+ * 同じ時刻の接触が複数あれば番号の小さい相手を選ぶ。
+ * drive(world, dt, pool), resolve(world, dt, pool) は crlThreadPool で並列に行う（結果は同じ）。
+ *****************************************************************************/
+
+#ifndef CRL_COLLISION_HPP
+#define CRL_COLLISION_HPP
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "crlAgentArray.hpp"
+#include "crlSpatialGrid.hpp"
+
+template<int DIM>
+class crlCollisionT {
+    static const int NBR_MAX = (DIM == 3) ? 26 : 8; // 隣接セルの最大数 3^DIM - 1
+    crlSpatialGridT<DIM> m_grid; // 広域判定用
+    std::vector<double> m_p0[DIM]; // ステップ開始位置
+    std::vector<double> m_toi; // エージェントごとの最初の接触時刻 [0, 1]（接触なしは 2.0）
+    std::vector<int> m_partner; // 接触相手
+    std::vector<double> m_dr[DIM]; // ステップ中の移動量（最小イメージ）
+    double m_f_min[DIM], m_f_size[DIM]; // フィールドの最小値・大きさ
+    crlWorkerLocal<double> m_reach; // 並列実行時のワーカーごとの移動範囲の最大値
+    double m_restitution; // 反発係数（0: 法線方向の速度を打ち消すのみ）
+    int m_contact_num;
+
+public:
+    crlCollisionT() {
+        m_restitution = 0.0;
+        m_contact_num = 0;
+    }
+
+    bool set_restitution(double e) {
+        if (e < 0.0 || e > 1.0) {
+            std::cerr << "#error: restitution: " << e << " is out of [0, 1]. @crlCollision::set_restitution()";
+            std::cerr << std::endl;
+            return false;
+        }
+        m_restitution = e;
+        return true;
+    }
+
+    int get_contact_num() const { return m_contact_num; }
+
+    double get_toi(int i) const { return m_toi[i]; }
+
+    int get_partner(int i) const { return m_partner[i]; }
+
+    // world.drive_all() の前に呼ぶ（ステップ開始位置を保存）
+    void begin(const crlAgentArrayT<DIM> &world) {
+        for (int d = 0; d < DIM; d++)
+            m_p0[d].assign(world.pos(d), world.pos(d) + world.size());
+    }
+
+    // world.drive_all() の後に呼ぶ（接触したエージェントの数を返す）
+    int resolve(crlAgentArrayT<DIM> &world, const double smpl_time) {
+        if (!prepare(world)) return 0;
+        // 詳細判定: 相対移動に対する最初の接触時刻（組ごとに1回）
+        m_grid.for_each_pair([&](int i, int j) {
+            double r0[DIM], v[DIM];
+            for (int d = 0; d < DIM; d++) {
+                r0[d] = ac::min_image(m_p0[d][j] - m_p0[d][i], m_f_size[d]);
+                v[d] = m_dr[d][j] - m_dr[d][i];
+            }
+            const double t = contact_time(r0, v, world.get_radius(i) + world.get_radius(j));
+            if (t > 1.0) return;
+            // 同じ時刻なら番号の小さい相手（組を調べる順序によらない）
+            if (t < m_toi[i] || (t == m_toi[i] && j < m_partner[i])) {
+                m_toi[i] = t;
+                m_partner[i] = j;
+            }
+            if (t < m_toi[j] || (t == m_toi[j] && i < m_partner[j])) {
+                m_toi[j] = t;
+                m_partner[j] = i;
+            }
+        });
+        slide_range(world, 0, world.size(), smpl_time);
+        return count_contact();
+    }
+
+    // resolve() をスレッドプールで並列に行う（結果は resolve() とビット単位で一致）
+    //   エージェントごとに隣接セルの相手を調べる（組の両側で同じ接触時刻になる）
+    int resolve(crlAgentArrayT<DIM> &world, const double smpl_time, crlThreadPool &pool) {
+        if (!prepare(world, &pool)) return 0;
+        pool.parallel_for(0, world.size(), [&](long b, long e, int) {
+            for (int i = (int) b; i < (int) e; i++)
+                first_contact(world, i);
+        }, 64);
+        pool.parallel_for(0, world.size(), [&](long b, long e, int) {
+            slide_range(world, (int) b, (int) e, smpl_time);
+        }, 64);
+        return count_contact();
+    }
+
+    // 開始時の相対位置 r0・ステップ中の相対移動 v の2体の距離が R になる最初の時刻 t (0 <= t <= 1)
+    //   （接触しなければ 2.0。開始時に既に重なっていて，さらに近づくなら 0.0）
+    static double contact_time(const double *r0, const double *v, const double R) {
+        double a = 0.0, b = 0.0, c = 0.0;
+        for (int d = 0; d < DIM; d++) {
+            a += v[d] * v[d];
+            b += 2.0 * r0[d] * v[d];
+            c += r0[d] * r0[d];
+        }
+        c -= R * R;
+        if (b >= 0.0) return 2.0; // 離れていく（または相対移動なし）
+        if (c <= 0.0) return 0.0;
+        double disc = b * b - 4.0 * a * c;
+        if (disc < 0.0) return 2.0;
+        double t = (-b - sqrt(disc)) / (2.0 * a);
+        return (t > 1.0) ? 2.0 : t;
+    }
+
+    // i を時刻 t の接触位置まで戻し，接触法線方向の速度を除いて残り時間 (1 - t) smpl_time を進める
+    //   p0, dr: i の開始位置と移動量，r0, drj: 相手の開始時の相対位置（最小イメージ）と移動量
+    static void slide(crlAgentArrayT<DIM> &world, const int i, const double *p0, const double *dr, const double *r0,
+                      const double *drj, const double t, const double smpl_time, const double restitution,
+                      const double *f_min, const double *f_size) {
+        double nv[DIM], nn = 0.0, vn = 0.0;
+        for (int d = 0; d < DIM; d++) {
+            double pi = p0[d] + t * dr[d];
+            double pj = p0[d] + r0[d] + t * drj[d];
+            nv[d] = pj - pi;
+            nn += nv[d] * nv[d];
+        }
+        nn = sqrt(nn);
+        if (nn > 0.0) {
+            for (int d = 0; d < DIM; d++) {
+                nv[d] /= nn;
+                vn += world.vel(d)[i] * nv[d];
+            }
+        }
+        if (vn < 0.0) vn = 0.0; // 離れる向きの速度は残す
+        for (int d = 0; d < DIM; d++) {
+            double v = world.vel(d)[i] - (1.0 + restitution) * vn * nv[d];
+            world.vel(d)[i] = v;
+            double p = p0[d] + t * dr[d] + v * (1.0 - t) * smpl_time;
+            p = f_min[d] + fmod(p - f_min[d], f_size[d]);
+            if (p < f_min[d]) p += f_size[d];
+            world.pos(d)[i] = p;
+        }
+    }
+
+    // 全エージェントを駆動し，ステップ内の接触を解決する（接触したエージェントの数を返す）
+    int drive(crlAgentArrayT<DIM> &world, const double smpl_time) {
+        begin(world);
+        world.drive_all(smpl_time);
+        return resolve(world, smpl_time);
+    }
+
+    // drive() をスレッドプールで並列に行う（結果は drive() とビット単位で一致）
+    int drive(crlAgentArrayT<DIM> &world, const double smpl_time, crlThreadPool &pool) {
+        begin(world);
+        world.drive_all(smpl_time, pool);
+        return resolve(world, smpl_time, pool);
+    }
+
+private:
+
+    // ステップ中の移動量と格子を用意する（接触を調べる必要がなければ false）
+    bool prepare(const crlAgentArrayT<DIM> &world, crlThreadPool *pool = nullptr) {
+        const int num = world.size();
+        const ac::field_environment_t &env = world.get_env();
+        for (int d = 0; d < DIM; d++) {
+            m_f_min[d] = ac::field_min(env, d);
+            m_f_size[d] = ac::field_max(env, d) - ac::field_min(env, d);
+        }
+        m_toi.assign(num, 2.0);
+        m_partner.assign(num, -1);
+        m_contact_num = 0;
+        if (num < 2 || (int) m_p0[0].size() != num) return false;
+
+        // ステップ中の移動量と，広域判定に必要なセル幅 (2 * (半径 + 移動量) の最大値)
+        for (int d = 0; d < DIM; d++)
+            m_dr[d].resize(num);
+        auto move = [&](int b, int e, double &reach) {
+            for (int i = b; i < e; i++) {
+                double n = 0.0;
+                for (int d = 0; d < DIM; d++) {
+                    m_dr[d][i] = ac::min_image(world.pos(d)[i] - m_p0[d][i], m_f_size[d]);
+                    n += m_dr[d][i] * m_dr[d][i];
+                }
+                double r = world.get_radius(i) + sqrt(n);
+                if (r > reach) reach = r;
+            }
+        };
+        double reach = 0.0;
+        if (pool == nullptr) {
+            move(0, num, reach);
+        } else {
+            m_reach.resize(pool->size());
+            for (int w = 0; w < pool->size(); w++)
+                m_reach[w] = 0.0;
+            pool->parallel_for(0, num, [&](long b, long e, int w) { move((int) b, (int) e, m_reach[w]); }, 256);
+            for (int w = 0; w < pool->size(); w++)
+                if (m_reach[w] > reach) reach = m_reach[w];
+        }
+        if (!m_grid.init(env, 2.0 * reach)) return false;
+        const double *p0[DIM];
+        for (int d = 0; d < DIM; d++)
+            p0[d] = m_p0[d].data();
+        return m_grid.build(p0, num);
+    }
+
+    // i の最初の接触時刻と相手（同じセル・隣接セルの全ての相手から）
+    void first_contact(const crlAgentArrayT<DIM> &world, const int i) {
+        int cell[NBR_MAX + 1];
+        cell[0] = m_grid.get_cell_of_agent(i);
+        const int cell_num = 1 + m_grid.get_neighbor_cells(cell[0], cell + 1);
+        double toi = 2.0;
+        int partner = -1;
+        for (int c = 0; c < cell_num; c++) {
+            for (const int *a = m_grid.cell_begin(cell[c]); a != m_grid.cell_end(cell[c]); a++) {
+                const int j = *a;
+                if (j == i) continue;
+                double r0[DIM], v[DIM];
+                for (int d = 0; d < DIM; d++) {
+                    r0[d] = ac::min_image(m_p0[d][j] - m_p0[d][i], m_f_size[d]);
+                    v[d] = m_dr[d][j] - m_dr[d][i];
+                }
+                const double t = contact_time(r0, v, world.get_radius(i) + world.get_radius(j));
+                if (t > 1.0) continue;
+                if (t < toi || (t == toi && j < partner)) {
+                    toi = t;
+                    partner = j;
+                }
+            }
+        }
+        m_toi[i] = toi;
+        m_partner[i] = partner;
+    }
+
+    // 解決: 接触したエージェントを接触位置まで戻し，法線方向の速度を除いて残り時間を進める
+    void slide_range(crlAgentArrayT<DIM> &world, const int b, const int e, const double smpl_time) const {
+        for (int i = b; i < e; i++) {
+            if (m_partner[i] < 0) continue;
+            const int j = m_partner[i];
+            double p0[DIM], dri[DIM], r0[DIM], drj[DIM];
+            for (int d = 0; d < DIM; d++) {
+                p0[d] = m_p0[d][i];
+                dri[d] = m_dr[d][i];
+                r0[d] = ac::min_image(m_p0[d][j] - m_p0[d][i], m_f_size[d]);
+                drj[d] = m_dr[d][j];
+            }
+            slide(world, i, p0, dri, r0, drj, m_toi[i], smpl_time, m_restitution, m_f_min, m_f_size);
+        }
+    }
+
+    int count_contact() {
+        m_contact_num = 0;
+        for (int i = 0; i < (int) m_partner.size(); i++)
+            if (m_partner[i] >= 0) m_contact_num++;
+        return m_contact_num;
+    }
+};
+
+typedef crlCollisionT<U_SIZE> crlCollision; // 2次元
+
+#endif // CRL_COLLISION_HPP
@@ -0,0 +1,293 @@
+/***************************************************************************
+ * crlDensityGrid.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * フィールド上のエージェントの密度（占有）マップ
+ *   crlDensityGrid map;
+ *   map.init(env, 1.0);             // セルの幅 1.0（get_sight_angle_elev_deg_on_map() のマップと同じ）
+ *   map.update(world);              // 毎ステップ: セルを移ったエージェントだけを数え直す
+ *   map.count(lo, hi);              // 矩形 [lo, hi] のセルにいるエージェント数（O(1)）
+ * 矩形の問い合わせは累積和テーブル (summed-area table) で 2^DIM 個の角の加減算で求める。
+ * lo[d] > hi[d] の軸はフィールドの端をまたぐ範囲（[lo, max) と [min, hi]）とする。
+ * 累積和テーブルは計数が変わった後の最初の問い合わせで作り直す（1ステップに高々1回）。
+ * 一度でもエージェントが入ったセルを記録し，被覆率 (coverage) を求める。
+ *****************************************************************************/
+
+#ifndef CRL_DENSITY_GRID_HPP
+#define CRL_DENSITY_GRID_HPP
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "crlAgentArray.hpp"
+
+template<int DIM>
+class crlDensityGridT {
+    int m_nc[DIM]; // 軸ごとのセル数
+    double m_width[DIM]; // セルの幅
+    double m_min[DIM], m_size[DIM];
+    int m_cell_num;
+    std::vector<int> m_count; // セルごとのエージェント数（セル番号は軸 0 が最下位）
+    std::vector<char> m_visited; // 一度でもエージェントが入ったセル
+    std::vector<int> m_cell_of; // エージェントごとのセル番号（-1: 未登録）
+    std::vector<int> m_sat; // 累積和テーブル（軸ごとに nc + 1 個，先頭は 0）
+    int m_occupied_num, m_visited_num;
+    bool m_dirty; // m_sat が m_count と一致していない
+    long m_moved_num; // 直前の update() でセルを移ったエージェント数
+
+public:
+    crlDensityGridT() {
+        m_cell_num = 0;
+        m_occupied_num = m_visited_num = 0;
+        m_dirty = false;
+        m_moved_num = 0;
+        for (int d = 0; d < DIM; d++) {
+            m_nc[d] = 0;
+            m_width[d] = m_min[d] = m_size[d] = 0.0;
+        }
+    }
+
+    bool init(const ac::field_environment_t &env, double cell_size = 1.0) {
+        bool valid = cell_size > 0.0;
+        for (int d = 0; d < DIM; d++)
+            valid = valid && (ac::field_max(env, d) - ac::field_min(env, d) > 0.0);
+        if (!valid) {
+            std::cerr << "#error: cell_size: " << cell_size << " or field size is not positive.";
+            std::cerr << " @crlDensityGrid::init()" << std::endl;
+            return false;
+        }
+        long cell_num = 1;
+        for (int d = 0; d < DIM; d++) {
+            m_min[d] = ac::field_min(env, d);
+            m_size[d] = ac::field_max(env, d) - ac::field_min(env, d);
+            m_nc[d] = (int) floor(m_size[d] / cell_size);
+            if (m_nc[d] < 1) m_nc[d] = 1;
+            m_width[d] = m_size[d] / m_nc[d];
+            cell_num *= m_nc[d];
+        }
+        if (cell_num > (1L << 26)) {
+            std::cerr << "#error: too many cells: " << cell_num << " @crlDensityGrid::init()" << std::endl;
+            m_cell_num = 0;
+            return false;
+        }
+        m_cell_num = (int) cell_num;
+        m_count.assign(m_cell_num, 0);
+        m_visited.assign(m_cell_num, 0);
+        m_cell_of.clear();
+        long sat_num = 1;
+        for (int d = 0; d < DIM; d++)
+            sat_num *= m_nc[d] + 1;
+        m_sat.assign(sat_num, 0);
+        m_occupied_num = m_visited_num = 0;
+        m_dirty = false;
+        return true;
+    }
+
+    // 全ての記録を消す（セルの設定はそのまま）
+    void clear() {
+        m_count.assign(m_cell_num, 0);
+        m_visited.assign(m_cell_num, 0);
+        m_cell_of.clear();
+        m_sat.assign(m_sat.size(), 0);
+        m_occupied_num = m_visited_num = 0;
+        m_dirty = false;
+    }
+
+    int get_cell_num() const { return m_cell_num; }
+
+    int get_cell_num(int d) const { return m_nc[d]; }
+
+    double get_cell_width(int d) const { return m_width[d]; }
+
+    // 位置 p が含まれるセル番号
+    template<class R>
+    int cell_of(const R *p) const {
+        int c = 0;
+        for (int d = DIM - 1; d >= 0; d--)
+            c = c * m_nc[d] + cell_index(p[d], d);
+        return c;
+    }
+
+    // 位置 x が含まれる軸 d のセルの位置
+    int cell_index(double x, int d) const {
+        int k = (int) floor((x - m_min[d]) / m_width[d]);
+        k %= m_nc[d];
+        if (k < 0) k += m_nc[d];
+        return k;
+    }
+
+    // エージェントの位置でセルの計数を更新する（セルを移ったエージェントだけを数え直す）
+    bool update(const crlAgentArrayT<DIM> &world) {
+        if (m_cell_num == 0) {
+            std::cerr << "#error: not initialized. @crlDensityGrid::update()" << std::endl;
+            return false;
+        }
+        const int num = world.size();
+        // エージェント数が減った場合は，いなくなったエージェントを取り除く
+        for (int i = num; i < (int) m_cell_of.size(); i++)
+            remove(m_cell_of[i]);
+        m_cell_of.resize(num, -1);
+        m_moved_num = 0;
+        double p[DIM];
+        for (int i = 0; i < num; i++) {
+            for (int d = 0; d < DIM; d++)
+                p[d] = world.pos(d)[i];
+            const int c = cell_of(p);
+            if (c == m_cell_of[i]) continue;
+            if (m_cell_of[i] >= 0) remove(m_cell_of[i]);
+            add(c);
+            m_cell_of[i] = c;
+            m_moved_num++;
+        }
+        return true;
+    }
+
+    // セル c のエージェント数
+    int get_count(int c) const { return m_count[c]; }
+
+    const int *count_map() const { return m_count.data(); }
+
+    bool is_visited(int c) const { return m_visited[c] != 0; }
+
+    // エージェントが1体以上いるセルの数
+    int get_occupied_num() const { return m_occupied_num; }
+
+    // 一度でもエージェントが入ったセルの数
+    int get_visited_num() const { return m_visited_num; }
+
+    // 被覆率（一度でもエージェントが入ったセルの割合）
+    double get_coverage() const { return m_cell_num > 0 ? (double) m_visited_num / m_cell_num : 0.0; }
+
+    long get_moved_num() const { return m_moved_num; }
+
+    // セル k_lo[d] ~ k_hi[d]（両端を含む。k_lo[d] > k_hi[d] なら端をまたぐ）のエージェント数
+    int count_cells(const int *k_lo, const int *k_hi) {
+        if (m_dirty) build_sat();
+        // 軸ごとに高々2つの区間に分けて，全ての組み合わせの箱を足す
+        int a[DIM][2], b[DIM][2], n[DIM];
+        for (int d = 0; d < DIM; d++) {
+            int lo = k_lo[d], hi = k_hi[d];
+            if (lo < 0 || hi < 0 || lo >= m_nc[d] || hi >= m_nc[d]) return 0;
+            if (lo <= hi) {
+                a[d][0] = lo;
+                b[d][0] = hi;
+                n[d] = 1;
+            } else {
+                a[d][0] = lo;
+                b[d][0] = m_nc[d] - 1;
+                a[d][1] = 0;
+                b[d][1] = hi;
+                n[d] = 2;
+            }
+        }
+        int sum = 0;
+        for (int box = 0; box < (1 << DIM); box++) {
+            bool valid = true;
+            int lo[DIM], hi[DIM];
+            for (int d = 0; d < DIM; d++) {
+                const int s = (box >> d) & 1;
+                valid = valid && (s < n[d]);
+                if (!valid) break;
+                lo[d] = a[d][s];
+                hi[d] = b[d][s];
+            }
+            if (valid) sum += box_sum(lo, hi);
+        }
+        return sum;
+    }
+
+    // 位置の矩形 lo ~ hi（lo[d] > hi[d] なら端をまたぐ）に重なるセルのエージェント数
+    //   端をまたぐかどうかはセルではなく位置で決める（lo, hi が同じセルでも lo[d] > hi[d] なら端をまたぐ）
+    //   重なるセルが軸のセル数以上になる軸は全体
+    template<class R>
+    int count(const R *lo, const R *hi) {
+        int k_lo[DIM], k_hi[DIM];
+        for (int d = 0; d < DIM; d++) {
+            const double h = (lo[d] > hi[d]) ? hi[d] + m_size[d] : hi[d]; // 端をまたぐ範囲は lo 側から続ける
+            const long c_lo = (long) floor((lo[d] - m_min[d]) / m_width[d]);
+            const long c_hi = (long) floor((h - m_min[d]) / m_width[d]);
+            if (h - lo[d] >= m_size[d] || c_hi - c_lo + 1 >= m_nc[d]) {
+                k_lo[d] = 0;
+                k_hi[d] = m_nc[d] - 1;
+            } else {
+                k_lo[d] = cell_index(lo[d], d); // フィールド外の位置は折り返す
+                k_hi[d] = cell_index(h, d);
+            }
+        }
+        return count_cells(k_lo, k_hi);
+    }
+
+private:
+
+    void add(int c) {
+        if (m_count[c]++ == 0) m_occupied_num++;
+        if (!m_visited[c]) {
+            m_visited[c] = 1;
+            m_visited_num++;
+        }
+        m_dirty = true;
+    }
+
+    void remove(int c) {
+        if (c < 0) return;
+        if (--m_count[c] == 0) m_occupied_num--;
+        m_dirty = true;
+    }
+
+    // 累積和テーブルの添字（各軸 0 ~ nc）
+    int sat_index(const int *k) const {
+        int s = 0;
+        for (int d = DIM - 1; d >= 0; d--)
+            s = s * (m_nc[d] + 1) + k[d];
+        return s;
+    }
+
+    // m_sat[k] = セル [0, k) の合計
+    void build_sat() {
+        std::fill(m_sat.begin(), m_sat.end(), 0);
+        int k[DIM];
+        for (int c = 0; c < m_cell_num; c++) {
+            for (int d = 0, r = c; d < DIM; d++) {
+                k[d] = r % m_nc[d] + 1;
+                r /= m_nc[d];
+            }
+            m_sat[sat_index(k)] = m_count[c];
+        }
+        // 軸ごとに累積和をとる
+        int stride = 1;
+        for (int d = 0; d < DIM; d++) {
+            const int len = m_nc[d] + 1;
+            for (int s = 0; s < (int) m_sat.size(); s++) {
+                if ((s / stride) % len == 0) continue;
+                m_sat[s] += m_sat[s - stride];
+            }
+            stride *= len;
+        }
+        m_dirty = false;
+    }
+
+    // セル lo[d] ~ hi[d]（両端を含む, lo <= hi）の合計
+    int box_sum(const int *lo, const int *hi) const {
+        int sum = 0, k[DIM];
+        for (int corner = 0; corner < (1 << DIM); corner++) {
+            int sign = 1;
+            for (int d = 0; d < DIM; d++) {
+                if ((corner >> d) & 1) {
+                    k[d] = hi[d] + 1;
+                } else {
+                    k[d] = lo[d];
+                    sign = -sign;
+                }
+            }
+            sum += sign * m_sat[sat_index(k)];
+        }
+        return sum;
+    }
+};
+
+typedef crlDensityGridT<U_SIZE> crlDensityGrid; // 2次元
+
+#endif // CRL_DENSITY_GRID_HPP
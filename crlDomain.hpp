@@ -0,0 +1,406 @@
+/***************************************************************************
+ * crlDomain.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * トロイダルなフィールドをタイルに分割し，同じ計算機の複数のプロセスで分担する（領域分割）
+ *   long cap = crlDomain::inbox_capacity(env, tiles, halo, agent_num); // 受信箱の容量（一様な密度からの見積もり）
+ *   crlDomain::create("/crl_dom", env, tiles, halo, cap);  // 起動側: 共有メモリを作る（tiles: 軸ごとのタイル数）
+ *   crlDomain dom;
+ *   dom.open("/crl_dom", rank);          // 各プロセス: rank 番目のタイルを受け持つ
+ *   dom.add(a);                          // エージェントを加える（受け持ちのタイルの位置。他の位置なら exchange() で移す）
+ *   while (...) {
+ *       // dom.owned()（受け持ち）と dom.halo()（隣のタイルの境界付近）から受け持ちのエージェントを駆動
+ *       dom.exchange();                  // タイルを出たエージェントを移し，境界付近のエージェントを隣に写す
+ *   }
+ *   dom.close(); crlDomain::unlink("/crl_dom");
+ * exchange() は全プロセスで同じ回数呼ぶ（プロセス間のバリアで同期する）。
+ * ハロー幅 halo 以内で境界に近いエージェントを隣接タイル（フィールドの端をまたぐ隣も含む）に写すので，
+ * 相互作用の距離が halo 以下なら受け持ちのエージェントの計算に必要な相手は owned() と halo() に揃う。
+ * 通信は POSIX 共有メモリ上のタイルごとの受信箱（ステップの偶奇で2面）で行う（Linux のみ）。
+ *****************************************************************************/
+
+#ifndef CRL_DOMAIN_HPP
+#define CRL_DOMAIN_HPP
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <new>
+#include <cmath>
+#include "crlAgentCore.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define DOMAIN_TILE_MAX 4096
+
+template<int DIM>
+class crlDomainT {
+public:
+    static const int STAT = 4 * DIM; // 状態の次元
+
+    // タイル間で受け渡すエージェント
+    typedef struct {
+        long ID; // 全タイルで一意な番号
+        double STAT[4 * DIM]; // (x, y, dx, dy, ddx, ddy, ux, uy)
+        ac::agent_physical_t PHYS;
+    } agent_t;
+
+private:
+    enum { MIGRATE = 0, HALO = 1 };
+
+    typedef struct {
+        int KIND; // MIGRATE: 受け持ちを移す, HALO: 写し
+        agent_t A;
+    } message_t;
+
+    // 共有メモリの先頭
+    typedef struct {
+        int TILES[DIM];
+        int TILE_NUM;
+        long CAPACITY; // 受信箱ごとの最大メッセージ数
+        double F_MIN[DIM], F_SIZE[DIM];
+        double HALO;
+#ifdef __linux__
+        pthread_barrier_t BARRIER;
+#endif
+        std::atomic<int> OVERFLOW_; // 受信箱があふれた
+    } header_t;
+
+    typedef struct {
+        alignas(64) std::atomic<long> COUNT;
+    } inbox_t;
+
+    void *m_mem;
+    size_t m_mem_size;
+    header_t *m_head;
+    inbox_t *m_inbox; // [タイル][偶奇]
+    message_t *m_msg; // [タイル][偶奇][CAPACITY]
+    int m_rank;
+    int m_coord[DIM]; // 受け持ちのタイルの位置
+    double m_lo[DIM], m_hi[DIM]; // 受け持ちのタイルの範囲
+    long m_tick; // exchange() の回数
+    std::vector<agent_t> m_owned, m_halo;
+    long m_migrated_num, m_halo_sent_num; // 直前の exchange() で送った数
+
+public:
+    crlDomainT() {
+        m_mem = nullptr;
+        m_mem_size = 0;
+        m_head = nullptr;
+        m_inbox = nullptr;
+        m_msg = nullptr;
+        m_rank = -1;
+        m_tick = 0;
+        m_migrated_num = m_halo_sent_num = 0;
+    }
+
+    ~crlDomainT() { close(); }
+
+    // タイル数 tiles[d]，ハロー幅 halo，受信箱の容量 capacity の共有メモリ name を作る（起動側で1回）
+    static bool create(const std::string &name, const ac::field_environment_t &env, const int *tiles, double halo,
+                       long capacity) {
+#ifdef __linux__
+        int tile_num = 1;
+        bool valid = halo >= 0.0 && capacity > 0;
+        for (int d = 0; d < DIM; d++) {
+            const double tile_w = (ac::field_max(env, d) - ac::field_min(env, d)) / tiles[d];
+            valid = valid && tiles[d] >= 1 && tile_w > 0.0 && (tiles[d] == 1 || halo <= tile_w);
+            tile_num *= (tiles[d] >= 1) ? tiles[d] : 1;
+        }
+        if (!valid || tile_num > DOMAIN_TILE_MAX) {
+            std::cerr << "#error: invalid tiles, halo: " << halo << " (must be <= tile width) or capacity: " << capacity;
+            std::cerr << " @crlDomain::create()" << std::endl;
+            return false;
+        }
+        const size_t size = mem_size(tile_num, capacity);
+        const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0 || ftruncate(fd, (off_t) size) != 0) {
+            std::cerr << "#error: couldn't create shared memory [" << name << "] @crlDomain::create()" << std::endl;
+            if (fd >= 0) {
+                ::close(fd);
+                shm_unlink(name.c_str());
+            }
+            return false;
+        }
+        void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mem == MAP_FAILED) {
+            std::cerr << "#error: mmap failed. @crlDomain::create()" << std::endl;
+            shm_unlink(name.c_str());
+            return false;
+        }
+        header_t *h = new(mem) header_t;
+        for (int d = 0; d < DIM; d++) {
+            h->TILES[d] = tiles[d];
+            h->F_MIN[d] = ac::field_min(env, d);
+            h->F_SIZE[d] = ac::field_max(env, d) - ac::field_min(env, d);
+        }
+        h->TILE_NUM = tile_num;
+        h->CAPACITY = capacity;
+        h->HALO = halo;
+        h->OVERFLOW_ = 0;
+        pthread_barrierattr_t attr;
+        pthread_barrierattr_init(&attr);
+        pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_barrier_init(&h->BARRIER, &attr, (unsigned) tile_num);
+        pthread_barrierattr_destroy(&attr);
+        inbox_t *inbox = (inbox_t *) ((char *) mem + inbox_offset());
+        for (int k = 0; k < 2 * tile_num; k++)
+            new(&inbox[k]) inbox_t{0};
+        munmap(mem, size);
+        return true;
+#else
+        (void) name, (void) env, (void) tiles, (void) halo, (void) capacity;
+        std::cerr << "#error: shared memory is not supported. @crlDomain::create()" << std::endl;
+        return false;
+#endif
+    }
+
+    // agent_num 体が一様に分布するときの受信箱の容量（slack 倍 + margin，agent_num + margin を超えない）
+    //   1回の exchange() で1体が1つの受信箱に送るのは高々1通（移るか写すか）で，
+    //   1ステップの移動がハロー幅以下なら，タイルに届くのはタイルの外側の幅 halo の帯にいるエージェントだけ
+    //   （タイルが1つの軸には帯がない。受け持ちのタイルで加えれば最初の exchange() でも移すのは帯の中だけ）
+    static long inbox_capacity(const ac::field_environment_t &env, const int *tiles, double halo, long agent_num,
+                               double slack = 2.0, long margin = 1024) {
+        double area = 1.0, tile_area = 1.0, band_area = 1.0;
+        for (int d = 0; d < DIM; d++) {
+            const double size = ac::field_max(env, d) - ac::field_min(env, d);
+            const double w = (tiles[d] >= 1) ? size / tiles[d] : size;
+            area *= size;
+            tile_area *= w;
+            band_area *= (tiles[d] > 1) ? w + 2.0 * halo : w;
+        }
+        double n = (area > 0.0) ? slack * agent_num * (band_area - tile_area) / area : (double) agent_num;
+        if (n > (double) agent_num) n = (double) agent_num;
+        return (long) ceil(n) + margin;
+    }
+
+    // 共有メモリ name を削除する（全プロセスが close() した後に起動側で1回）
+    static bool unlink(const std::string &name) {
+#ifdef __linux__
+        return shm_unlink(name.c_str()) == 0;
+#else
+        (void) name;
+        return false;
+#endif
+    }
+
+    // 共有メモリ name の rank 番目のタイルを受け持つ
+    bool open(const std::string &name, int rank) {
+#ifdef __linux__
+        close();
+        const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            std::cerr << "#error: couldn't open shared memory [" << name << "] @crlDomain::open()" << std::endl;
+            if (fd >= 0) ::close(fd);
+            return false;
+        }
+        void *mem = mmap(nullptr, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mem == MAP_FAILED) {
+            std::cerr << "#error: mmap failed. @crlDomain::open()" << std::endl;
+            return false;
+        }
+        m_mem = mem;
+        m_mem_size = (size_t) st.st_size;
+        m_head = (header_t *) mem;
+        if (rank < 0 || rank >= m_head->TILE_NUM) {
+            std::cerr << "#error: rank: " << rank << " is out of [0, " << m_head->TILE_NUM << ") @crlDomain::open()";
+            std::cerr << std::endl;
+            close();
+            return false;
+        }
+        m_inbox = (inbox_t *) ((char *) mem + inbox_offset());
+        m_msg = (message_t *) ((char *) mem + msg_offset(m_head->TILE_NUM));
+        m_rank = rank;
+        for (int d = 0, r = rank; d < DIM; d++) {
+            m_coord[d] = r % m_head->TILES[d];
+            r /= m_head->TILES[d];
+            const double w = m_head->F_SIZE[d] / m_head->TILES[d];
+            m_lo[d] = m_head->F_MIN[d] + w * m_coord[d];
+            m_hi[d] = m_lo[d] + w;
+        }
+        m_tick = 0;
+        m_owned.clear();
+        m_halo.clear();
+        return true;
+#else
+        (void) name, (void) rank;
+        std::cerr << "#error: shared memory is not supported. @crlDomain::open()" << std::endl;
+        return false;
+#endif
+    }
+
+    void close() {
+#ifdef __linux__
+        if (m_mem != nullptr) munmap(m_mem, m_mem_size);
+#endif
+        m_mem = nullptr;
+        m_head = nullptr;
+        m_rank = -1;
+    }
+
+    int get_rank() const { return m_rank; }
+
+    int get_tile_num() const { return m_head ? m_head->TILE_NUM : 0; }
+
+    double get_halo_width() const { return m_head ? m_head->HALO : 0.0; }
+
+    // 受け持ちのタイルの範囲（軸 d）
+    double get_tile_min(int d) const { return m_lo[d]; }
+
+    double get_tile_max(int d) const { return m_hi[d]; }
+
+    // 受け持ちのエージェント（駆動した状態を書き戻す）
+    std::vector<agent_t> &owned() { return m_owned; }
+
+    // 隣のタイルの境界付近のエージェントの写し（直前の exchange() の時点の状態）
+    const std::vector<agent_t> &halo() const { return m_halo; }
+
+    void add(const agent_t &a) { m_owned.push_back(a); }
+
+    long get_migrated_num() const { return m_migrated_num; }
+
+    long get_halo_sent_num() const { return m_halo_sent_num; }
+
+    // 位置 p を受け持つタイルの番号
+    int tile_of(const double *p) const {
+        int t = 0;
+        for (int d = DIM - 1; d >= 0; d--)
+            t = t * m_head->TILES[d] + tile_index(p[d], d);
+        return t;
+    }
+
+    // タイルを出たエージェントを移し，境界付近のエージェントを隣のタイルに写す（全プロセスで同期）
+    bool exchange() {
+#ifdef __linux__
+        if (m_head == nullptr) {
+            std::cerr << "#error: not opened. @crlDomain::exchange()" << std::endl;
+            return false;
+        }
+        const int face = (int) (m_tick & 1); // 受信箱の面（2ステップ前の読み出しは前回のバリアで終わっている）
+        m_migrated_num = m_halo_sent_num = 0;
+        size_t keep = 0;
+        for (size_t n = 0; n < m_owned.size(); n++) {
+            const agent_t &a = m_owned[n];
+            const int t = tile_of(a.STAT);
+            send_halo(a, t, face); // 移る先のタイルの隣に写す（自分のタイルにも届く）
+            if (t != m_rank) {
+                send(t, face, MIGRATE, a);
+                m_migrated_num++;
+                continue;
+            }
+            m_owned[keep++] = a;
+        }
+        m_owned.resize(keep);
+        pthread_barrier_wait(&m_head->BARRIER);
+        const int overflow = m_head->OVERFLOW_;
+        // 自分の受信箱を読む
+        m_halo.clear();
+        inbox_t &box = m_inbox[2 * m_rank + face];
+        long count = box.COUNT;
+        if (count > m_head->CAPACITY) count = m_head->CAPACITY;
+        const message_t *msg = &m_msg[(2 * (long) m_rank + face) * m_head->CAPACITY];
+        for (long k = 0; k < count; k++) {
+            if (msg[k].KIND == MIGRATE) m_owned.push_back(msg[k].A);
+            else m_halo.push_back(msg[k].A);
+        }
+        box.COUNT = 0;
+        m_tick++;
+        if (overflow) {
+            std::cerr << "#error: inbox overflow (capacity: " << m_head->CAPACITY << ") @crlDomain::exchange()";
+            std::cerr << std::endl;
+            return false;
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+private:
+
+    static size_t align64(size_t s) { return (s + 63) / 64 * 64; }
+
+    static size_t inbox_offset() { return align64(sizeof(header_t)); }
+
+    static size_t msg_offset(int tile_num) { return inbox_offset() + align64(2 * tile_num * sizeof(inbox_t)); }
+
+    static size_t mem_size(int tile_num, long capacity) {
+        return msg_offset(tile_num) + 2 * (size_t) tile_num * capacity * sizeof(message_t);
+    }
+
+    // 位置 x を受け持つ軸 d のタイルの位置（フィールド外は折り返す）
+    int tile_index(double x, int d) const {
+        const int nt = m_head->TILES[d];
+        int k = (int) floor((x - m_head->F_MIN[d]) / (m_head->F_SIZE[d] / nt));
+        k %= nt;
+        if (k < 0) k += nt;
+        return k;
+    }
+
+    void send(int tile, int face, int kind, const agent_t &a) {
+        inbox_t &box = m_inbox[2 * tile + face];
+        const long k = box.COUNT.fetch_add(1);
+        if (k >= m_head->CAPACITY) {
+            m_head->OVERFLOW_ = 1;
+            return;
+        }
+        message_t &m = m_msg[(2 * (long) tile + face) * m_head->CAPACITY + k];
+        m.KIND = kind;
+        m.A = a;
+    }
+
+    // タイル owner が受け持つ a を，owner の境界から halo 以内にある隣のタイル（角の隣も含む）に写す
+    void send_halo(const agent_t &a, int owner, int face) {
+        int coord[DIM], off[DIM][3], n[DIM], combo = 1; // 軸ごとのずれ（0: 同じ列，-1: 下側の隣, 1: 上側の隣）
+        for (int d = 0, r = owner; d < DIM; d++) {
+            const int nt = m_head->TILES[d];
+            coord[d] = r % nt;
+            r /= nt;
+            off[d][0] = 0;
+            n[d] = 1;
+            if (nt > 1) { // タイルが1つの軸の端は最小イメージで扱う
+                const double w = m_head->F_SIZE[d] / nt;
+                double x = fmod(a.STAT[d] - m_head->F_MIN[d], m_head->F_SIZE[d]); // タイルの下端からの距離
+                if (x < 0.0) x += m_head->F_SIZE[d];
+                x -= w * coord[d];
+                if (x < m_head->HALO) off[d][n[d]++] = -1;
+                if (w - x < m_head->HALO) off[d][n[d]++] = 1;
+            }
+            combo *= n[d];
+        }
+        int sent[27], sent_num = 0;
+        for (int k = 1; k < combo; k++) {
+            int t = 0;
+            for (int d = DIM - 1, r = k; d >= 0; d--) {
+                int stride = 1;
+                for (int e = 0; e < d; e++)
+                    stride *= n[e];
+                const int nt = m_head->TILES[d];
+                t = t * nt + (coord[d] + off[d][(r / stride) % n[d]] + nt) % nt; // フィールドの端をまたぐ隣
+            }
+            bool dup = (t == owner); // タイルが2つの軸では上下の隣が同じタイル
+            for (int q = 0; q < sent_num; q++)
+                dup = dup || sent[q] == t;
+            if (dup) continue;
+            sent[sent_num++] = t;
+            send(t, face, HALO, a);
+            m_halo_sent_num++;
+        }
+    }
+};
+
+typedef crlDomainT<U_SIZE> crlDomain; // 2次元
+
+#endif // CRL_DOMAIN_HPP
@@ -0,0 +1,153 @@
+/***************************************************************************
+ * crlEnsemble.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * 同じシナリオをシードを変えて K 回実行するアンサンブル（モンテカルロ）を1つのプロセスで行う
+ *   crlEnsemble<crlAgent> ens;
+ *   ens.init(64, AGENT_NUM, 1, SAMPLING_TIME);       // 64 個の世界，シード 1 から
+ *   ens.run(300, init_agents, step_agents, pool);    // 各世界を 300 ステップ実行
+ *   ens.world(k);                                    // k 番目の世界の最終状態
+ * k 番目の世界のシードは get_seed(k) = seed + 2k（g_set_seed() は seed と seed + 1 を使うので重ならない）。
+ * エージェント数が split_agent_num 未満で世界の数がワーカー数以上なら，世界を丸ごとワーカーに割り当てて並列に実行する。
+ * それ以外（大きな世界・ワーカーより少ない世界）は世界を1つずつ実行し，step_fn の中の pool.parallel_for() で
+ * 世界を分割して並列に実行する（世界を丸ごと割り当てると余ったワーカーが遊ぶ）。
+ * 乱数列はスレッドごと（g_set_seed()）なので，各世界の軌道は crlGolden::run() で同じシードを
+ * 実行したときと一致する（init_fn, step_fn は世界の外の状態を書き換えないこと）。
+ *****************************************************************************/
+
+#ifndef CRL_ENSEMBLE_HPP
+#define CRL_ENSEMBLE_HPP
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "crlAgentCore.hpp"
+#include "crlThreadPool.hpp"
+
+#define ENSEMBLE_SPLIT_AGENT_NUM 4096 // これ以上のエージェント数の世界は1つずつ分割して実行する
+
+template<class T>
+class crlEnsemble {
+    int m_world_num;
+    int m_agent_num;
+    unsigned int m_seed;
+    double m_smpl_time;
+    int m_split_agent_num;
+    std::vector<std::vector<T> > m_world;
+    std::vector<double> m_world_sec; // 世界ごとの実行時間 [sec]
+    std::vector<long> m_diverged; // 世界ごとに nan, inf になったステップ（-1: なし）
+    double m_wall_sec; // run() の経過時間 [sec]
+    long m_tick_num; // run() の全世界のステップ数の合計
+
+public:
+    crlEnsemble() {
+        m_world_num = m_agent_num = 0;
+        m_seed = 0;
+        m_smpl_time = 0.0;
+        m_split_agent_num = ENSEMBLE_SPLIT_AGENT_NUM;
+        m_wall_sec = 0.0;
+        m_tick_num = 0;
+    }
+
+    bool init(int world_num, int agent_num, unsigned int seed, double smpl_time) {
+        if (world_num < 1 || agent_num < 1 || smpl_time <= 0.0) {
+            std::cerr << "#error: world_num: " << world_num << ", agent_num: " << agent_num;
+            std::cerr << ", smpl_time: " << smpl_time << " @crlEnsemble::init()" << std::endl;
+            return false;
+        }
+        m_world_num = world_num;
+        m_agent_num = agent_num;
+        m_seed = seed;
+        m_smpl_time = smpl_time;
+        m_world.assign(world_num, std::vector<T>());
+        m_world_sec.assign(world_num, 0.0);
+        m_diverged.assign(world_num, -1);
+        m_wall_sec = 0.0;
+        m_tick_num = 0;
+        return true;
+    }
+
+    // エージェント数がこれ以上なら世界を1つずつ（世界の中を並列に）実行する
+    void set_split_agent_num(int n) { m_split_agent_num = n; }
+
+    int get_split_agent_num() const { return m_split_agent_num; }
+
+    // 世界を1つずつ（世界の中を pool で並列に）実行するか
+    bool is_split(const crlThreadPool &pool) const {
+        return m_agent_num >= m_split_agent_num || m_world_num < pool.size();
+    }
+
+    int size() const { return m_world_num; }
+
+    unsigned int get_seed(int k) const { return m_seed + 2u * (unsigned int) k; }
+
+    std::vector<T> &world(int k) { return m_world[k]; }
+
+    const std::vector<T> &world(int k) const { return m_world[k]; }
+
+    double get_world_sec(int k) const { return m_world_sec[k]; }
+
+    // k 番目の世界が nan, inf になったステップ（-1: なし）
+    long get_diverged(int k) const { return m_diverged[k]; }
+
+    double get_wall_sec() const { return m_wall_sec; }
+
+    // 1秒あたりのステップ数（全世界の合計）
+    double get_tick_rate() const { return m_wall_sec > 0.0 ? m_tick_num / m_wall_sec : 0.0; }
+
+    // 全ての世界を ticks ステップ実行する（nan, inf になった世界はそこで止める）
+    //   init_fn(agent): エージェントの初期化, step_fn(agent, sec): 1ステップ分の駆動
+    template<class Init, class Step>
+    bool run(int ticks, Init init_fn, Step step_fn, crlThreadPool &pool) {
+        if (m_world_num == 0) {
+            std::cerr << "#error: not initialized. @crlEnsemble::run()" << std::endl;
+            return false;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        m_tick_num = 0;
+        std::vector<long> tick_num(m_world_num, 0);
+        if (is_split(pool)) {
+            for (int k = 0; k < m_world_num; k++)
+                tick_num[k] = run_world(k, ticks, init_fn, step_fn);
+        } else {
+            pool.parallel_for(0, m_world_num, [&](long b, long e, int) {
+                for (long k = b; k < e; k++)
+                    tick_num[k] = run_world((int) k, ticks, init_fn, step_fn);
+            });
+        }
+        m_wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        for (int k = 0; k < m_world_num; k++)
+            m_tick_num += tick_num[k];
+        return true;
+    }
+
+private:
+
+    // k 番目の世界を実行して，実行したステップ数を返す
+    template<class Init, class Step>
+    long run_world(int k, int ticks, Init &init_fn, Step &step_fn) {
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<T> &agent = m_world[k];
+        g_set_seed(get_seed(k));
+        agent = std::vector<T>(m_agent_num);
+        init_fn(agent);
+        m_diverged[k] = -1;
+        double sec = 0.0;
+        int t = 0;
+        for (; t < ticks; t++) {
+            step_fn(agent, sec);
+            sec += m_smpl_time;
+            if (ac::validate_tick(agent, t) >= 0) {
+                m_diverged[k] = t;
+                t++;
+                break;
+            }
+        }
+        m_world_sec[k] = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        return t;
+    }
+};
+
+#endif // CRL_ENSEMBLE_HPP
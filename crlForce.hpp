@@ -0,0 +1,169 @@
+/***************************************************************************
+ * crlForce.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * カットオフ距離内の全ての組に対するペア相互作用（群れ・ポテンシャル場）の力の積算
+ *   crlForce force;
+ *   force.set_cutoff(10.0);
+ *   force.compute(world, kernel);   // world は crlAgentArray
+ *   force.to_input(world);          // 力を入力 u(d) に書き込む → world.drive_all()
+ * kernel(i, j, r, r2, fi, fj) は i から j への相対位置 r（最小イメージ, r2 = |r|^2 < cutoff^2）から
+ * i が受ける力 fi と j が受ける力 fj を書き込む（fi, fj は 0 で初期化済み，各組につき1回だけ呼ばれる）。
+ * 作用・反作用なら fj[d] = -fi[d] とする。
+ * compute(world, kernel, pool) は crlThreadPool でセルを分けて並列に評価する
+ * （ワーカーごとの積算用配列を最後に足し合わせるので atomic は不要）。
+ * このとき kernel は複数のスレッドから同時に呼ばれる（外部の状態を書き換えないこと）。
+ *****************************************************************************/
+
+#ifndef CRL_FORCE_HPP
+#define CRL_FORCE_HPP
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "crlAgentArray.hpp"
+#include "crlSpatialGrid.hpp"
+
+template<int DIM>
+class crlForceT {
+    struct part_t {
+        std::vector<double> f[DIM]; // ワーカーごとの積算用
+        long pair_num;
+    };
+
+    crlSpatialGridT<DIM> m_grid;
+    double m_cutoff;
+    std::vector<double> m_f[DIM]; // エージェントごとの力
+    crlWorkerLocal<part_t> m_part;
+    long m_pair_num; // 直前の compute() でカットオフ内だった組の数
+
+public:
+    crlForceT() {
+        m_cutoff = 0.0;
+        m_pair_num = 0;
+    }
+
+    bool set_cutoff(double cutoff) {
+        if (cutoff <= 0.0) {
+            std::cerr << "#error: cutoff: " << cutoff << " is not positive. @crlForce::set_cutoff()" << std::endl;
+            return false;
+        }
+        m_cutoff = cutoff;
+        return true;
+    }
+
+    double get_cutoff() const { return m_cutoff; }
+
+    long get_pair_num() const { return m_pair_num; }
+
+    // i が受ける力（軸 d）
+    double get_force(int i, int d) const { return m_f[d][i]; }
+
+    const double *force(int d) const { return m_f[d].data(); }
+
+    // カットオフ内の全ての組について kernel を評価し，エージェントごとの力を積算する
+    template<class K>
+    bool compute(const crlAgentArrayT<DIM> &world, K kernel) {
+        if (!prepare(world)) return false;
+        long pair = 0;
+        for (int c = 0; c < m_grid.get_cell_num(); c++)
+            accumulate(world, kernel, c, m_f, pair);
+        m_pair_num = pair;
+        return true;
+    }
+
+    // compute() をスレッドプールで並列に行う（足し合わせの順序が異なるため丸め誤差の範囲で異なる）
+    template<class K>
+    bool compute(const crlAgentArrayT<DIM> &world, K kernel, crlThreadPool &pool) {
+        if (!prepare(world)) return false;
+        const int num = world.size();
+        m_part.resize(pool.size());
+        for (int w = 0; w < pool.size(); w++) {
+            for (int d = 0; d < DIM; d++)
+                m_part[w].f[d].assign(num, 0.0);
+            m_part[w].pair_num = 0;
+        }
+        pool.parallel_for(0, m_grid.get_cell_num(), [&](long b, long e, int w) {
+            for (int c = (int) b; c < (int) e; c++)
+                accumulate(world, kernel, c, m_part[w].f, m_part[w].pair_num);
+        });
+        // ワーカーごとの力を足し合わせる
+        pool.parallel_for(0, num, [&](long b, long e, int) {
+            for (int w = 0; w < m_part.size(); w++)
+                for (int d = 0; d < DIM; d++)
+                    for (long i = b; i < e; i++)
+                        m_f[d][i] += m_part[w].f[d][i];
+        }, 1024);
+        for (int w = 0; w < m_part.size(); w++)
+            m_pair_num += m_part[w].pair_num;
+        return true;
+    }
+
+    // 力を入力 u(d) に書き込む（add = true なら加える）
+    void to_input(crlAgentArrayT<DIM> &world, bool add = false) const {
+        for (int d = 0; d < DIM; d++) {
+            ac::real_t *u = world.u(d);
+            const double *f = m_f[d].data();
+            for (int i = 0; i < world.size(); i++)
+                u[i] = add ? u[i] + f[i] : f[i];
+        }
+    }
+
+private:
+
+    // 力を 0 にして格子を作る
+    bool prepare(const crlAgentArrayT<DIM> &world) {
+        const int num = world.size();
+        const ac::field_environment_t &env = world.get_env();
+        for (int d = 0; d < DIM; d++)
+            m_f[d].assign(num, 0.0);
+        m_pair_num = 0;
+        if (m_cutoff <= 0.0) {
+            std::cerr << "#error: cutoff is not set. @crlForce::compute()" << std::endl;
+            return false;
+        }
+        for (int d = 0; d < DIM; d++) {
+            if (2.0 * m_cutoff > ac::field_max(env, d) - ac::field_min(env, d)) {
+                std::cerr << "#error: cutoff: " << m_cutoff << " exceeds half of the field.";
+                std::cerr << " @crlForce::compute()" << std::endl;
+                return false;
+            }
+        }
+        if (!m_grid.init(env, m_cutoff)) return false;
+        m_grid.build(world);
+        return true;
+    }
+
+    // セル c が受け持つ組を評価して f に積算する
+    template<class K>
+    void accumulate(const crlAgentArrayT<DIM> &world, K &kernel, int c, std::vector<double> *f, long &pair) const {
+        const ac::field_environment_t &env = world.get_env();
+        double f_size[DIM];
+        for (int d = 0; d < DIM; d++)
+            f_size[d] = ac::field_max(env, d) - ac::field_min(env, d);
+        const double rc2 = m_cutoff * m_cutoff;
+        m_grid.for_each_pair_in_cell(c, [&](int i, int j) {
+            double r[DIM], r2 = 0.0;
+            for (int d = 0; d < DIM; d++) {
+                r[d] = ac::min_image(world.pos(d)[j] - world.pos(d)[i], f_size[d]);
+                r2 += r[d] * r[d];
+            }
+            if (r2 >= rc2) return;
+            double fi[DIM], fj[DIM];
+            for (int d = 0; d < DIM; d++)
+                fi[d] = fj[d] = 0.0;
+            kernel(i, j, r, r2, fi, fj);
+            for (int d = 0; d < DIM; d++) {
+                f[d][i] += fi[d];
+                f[d][j] += fj[d];
+            }
+            pair++;
+        });
+    }
+};
+
+typedef crlForceT<U_SIZE> crlForce; // 2次元
+
+#endif // CRL_FORCE_HPP
@@ -0,0 +1,274 @@
+/***************************************************************************
+ * crlGolden.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * ゴールデン軌道（固定シードで記録した基準軌道）による回帰チェック
+ *   crlGolden gold;
+ *   gold.init(agent_num, seed, SAMPLING_TIME);
+ *   gold.run(agent, init_agents, step_agents, ticks); // 固定シードで実行・記録
+ *   gold.save("golden.bin");
+ *   ...
+ *   ref.load("golden.bin");
+ *   gold.compare(ref, tol, diff); // diff.TICK, diff.AGENT に最初に食い違った位置
+ *****************************************************************************/
+
+#ifndef CRL_GOLDEN_HPP
+#define CRL_GOLDEN_HPP
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include "crlAgentCore.hpp"
+
+#define GOLDEN_MAGIC "CRLGOLD1" // ファイル先頭の識別子 (8 byte)
+
+namespace agentcore {
+    // 状態成分 (x, y, dx, dy, ddx, ddy, ux, uy) ごとの許容誤差（0.0 の成分はビット単位で比較）
+    typedef struct {
+        double TOL[STAT_SIZE];
+    } golden_tolerance_t;
+
+    // ゴールデン軌道との比較結果
+    typedef struct {
+        bool DIVERGED; // 許容誤差を超えたら true
+        int TICK; // 最初に食い違ったステップ
+        int AGENT; // 最初に食い違ったエージェント
+        int STAT; // 最初に食い違った状態成分
+        double REF; // 基準値
+        double VAL; // 比較値
+        double MAX_ERR[STAT_SIZE]; // 成分ごとの最大絶対誤差（全ステップ・全エージェント）
+        double RMS_ERR[STAT_SIZE]; // 成分ごとの二乗平均平方根誤差（全ステップ・全エージェント）
+    } golden_diff_t;
+
+    void init(golden_tolerance_t &tol, const double t = 0.0) {
+        for (int i = 0; i < STAT_SIZE; i++)
+            tol.TOL[i] = t;
+    }
+
+    void init(golden_diff_t &diff) {
+        diff.DIVERGED = false;
+        diff.TICK = -1;
+        diff.AGENT = -1;
+        diff.STAT = -1;
+        diff.REF = 0.0;
+        diff.VAL = 0.0;
+        for (int i = 0; i < STAT_SIZE; i++) {
+            diff.MAX_ERR[i] = 0.0;
+            diff.RMS_ERR[i] = 0.0;
+        }
+    }
+
+    // ビット単位で等しいか（nan 同士も同じビット列なら等しい）
+    bool is_bitwise_equal(const double a, const double b) {
+        uint64_t ia, ib;
+        std::memcpy(&ia, &a, sizeof(double));
+        std::memcpy(&ib, &b, sizeof(double));
+        return ia == ib;
+    }
+}
+
+class crlGolden {
+    int m_agent_num;
+    int m_tick_num; // 記録済みステップ数（初期状態を含む）
+    unsigned int m_seed;
+    double m_smpl_time;
+    std::vector<double> m_traj; // [tick][agent][STAT_SIZE]
+
+public:
+    crlGolden() {
+        m_agent_num = 0;
+        m_tick_num = 0;
+        m_seed = 0;
+        m_smpl_time = 0.0;
+    }
+
+    bool init(int agent_num, unsigned int seed, double smpl_time) {
+        if (agent_num <= 0) {
+            std::cerr << "#error: agent_num: " << agent_num << " is not positive. @crlGolden::init()" << std::endl;
+            return false;
+        }
+        m_agent_num = agent_num;
+        m_seed = seed;
+        m_smpl_time = smpl_time;
+        m_tick_num = 0;
+        m_traj.clear();
+        return true;
+    }
+
+    int get_agent_num() const { return m_agent_num; }
+
+    int get_tick_num() const { return m_tick_num; }
+
+    unsigned int get_seed() const { return m_seed; }
+
+    double get_smpl_time() const { return m_smpl_time; }
+
+    // tick ステップ目の agent の状態 (STAT_SIZE 個)
+    const double *get_stat(int tick, int agent) const {
+        return &m_traj[((size_t) tick * m_agent_num + agent) * STAT_SIZE];
+    }
+
+    // 現在の全エージェントの状態を1ステップ分として記録
+    template<class T>
+    bool record(const std::vector<T> &agent) {
+        if ((int) agent.size() != m_agent_num) {
+            std::cerr << "#error: agent.size(): " << agent.size() << " != agent_num: " << m_agent_num;
+            std::cerr << " @crlGolden::record()" << std::endl;
+            return false;
+        }
+        size_t ofs = m_traj.size();
+        m_traj.resize(ofs + (size_t) m_agent_num * STAT_SIZE);
+        for (int n = 0; n < m_agent_num; n++) {
+            agent[n].get_stat(&m_traj[ofs + (size_t) n * STAT_SIZE]);
+        }
+        m_tick_num++;
+        return true;
+    }
+
+    // 固定シードでシナリオを実行して軌道を記録する
+    //   init_fn(agent): エージェントの初期化, step_fn(agent, sec): 1ステップ分の駆動
+    template<class T, class Init, class Step>
+    bool run(std::vector<T> &agent, Init init_fn, Step step_fn, int ticks) {
+        m_tick_num = 0;
+        m_traj.clear();
+        g_set_seed(m_seed);
+        agent = std::vector<T>(m_agent_num);
+        init_fn(agent);
+        if (!record(agent)) return false;
+        double sec = 0.0;
+        for (int t = 0; t < ticks; t++) {
+            step_fn(agent, sec);
+            sec += m_smpl_time;
+            if (ac::validate_tick(agent, t) >= 0) return false;
+            if (!record(agent)) return false;
+        }
+        return true;
+    }
+
+    bool save(const std::string &file) const {
+        std::ofstream ofs(file, std::ios::binary);
+        if (!ofs) {
+            std::cerr << "#error: couldn't open [" << file << "] @crlGolden::save()" << std::endl;
+            return false;
+        }
+        int32_t stat_size = STAT_SIZE;
+        int32_t agent_num = m_agent_num;
+        int32_t tick_num = m_tick_num;
+        uint32_t seed = m_seed;
+        ofs.write(GOLDEN_MAGIC, 8);
+        ofs.write((const char *) &stat_size, sizeof(stat_size));
+        ofs.write((const char *) &agent_num, sizeof(agent_num));
+        ofs.write((const char *) &tick_num, sizeof(tick_num));
+        ofs.write((const char *) &seed, sizeof(seed));
+        ofs.write((const char *) &m_smpl_time, sizeof(m_smpl_time));
+        ofs.write((const char *) m_traj.data(), (std::streamsize) (m_traj.size() * sizeof(double)));
+        if (!ofs) {
+            std::cerr << "#error: write error [" << file << "] @crlGolden::save()" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool load(const std::string &file) {
+        std::ifstream ifs(file, std::ios::binary);
+        if (!ifs) {
+            std::cerr << "#error: couldn't open [" << file << "] @crlGolden::load()" << std::endl;
+            return false;
+        }
+        char magic[8];
+        int32_t stat_size, agent_num, tick_num;
+        uint32_t seed;
+        ifs.read(magic, 8);
+        ifs.read((char *) &stat_size, sizeof(stat_size));
+        ifs.read((char *) &agent_num, sizeof(agent_num));
+        ifs.read((char *) &tick_num, sizeof(tick_num));
+        ifs.read((char *) &seed, sizeof(seed));
+        ifs.read((char *) &m_smpl_time, sizeof(m_smpl_time));
+        if (!ifs || std::memcmp(magic, GOLDEN_MAGIC, 8) != 0 || stat_size != STAT_SIZE || agent_num <= 0 ||
+            tick_num < 0) {
+            std::cerr << "#error: [" << file << "] is not a golden trajectory file (STAT_SIZE: " << STAT_SIZE;
+            std::cerr << ") @crlGolden::load()" << std::endl;
+            return false;
+        }
+        m_agent_num = agent_num;
+        m_tick_num = tick_num;
+        m_seed = seed;
+        m_traj.resize((size_t) tick_num * agent_num * STAT_SIZE);
+        ifs.read((char *) m_traj.data(), (std::streamsize) (m_traj.size() * sizeof(double)));
+        if (!ifs) {
+            std::cerr << "#error: [" << file << "] is truncated. @crlGolden::load()" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // ref と比較して全成分が許容誤差内なら true（diff に最初の食い違いと最大誤差を格納）
+    bool compare(const crlGolden &ref, const ac::golden_tolerance_t &tol, ac::golden_diff_t &diff) const {
+        ac::init(diff);
+        if (ref.m_agent_num != m_agent_num) {
+            std::cerr << "#error: agent_num: " << m_agent_num << " != ref: " << ref.m_agent_num;
+            std::cerr << " @crlGolden::compare()" << std::endl;
+            diff.DIVERGED = true;
+            return false;
+        }
+        int tick_num = (m_tick_num < ref.m_tick_num) ? m_tick_num : ref.m_tick_num;
+        for (int t = 0; t < tick_num; t++) {
+            for (int n = 0; n < m_agent_num; n++) {
+                const double *s0 = ref.get_stat(t, n);
+                const double *s1 = get_stat(t, n);
+                for (int i = 0; i < STAT_SIZE; i++) {
+                    if (ac::is_bitwise_equal(s0[i], s1[i])) continue;
+                    double err = fabs(s1[i] - s0[i]);
+                    if (!(err <= diff.MAX_ERR[i])) diff.MAX_ERR[i] = err; // nan も最大誤差として残す
+                    diff.RMS_ERR[i] += err * err;
+                    if (!diff.DIVERGED && !(tol.TOL[i] > 0.0 && err <= tol.TOL[i])) {
+                        diff.DIVERGED = true;
+                        diff.TICK = t;
+                        diff.AGENT = n;
+                        diff.STAT = i;
+                        diff.REF = s0[i];
+                        diff.VAL = s1[i];
+                    }
+                }
+            }
+        }
+        if (tick_num > 0 && m_agent_num > 0) {
+            for (int i = 0; i < STAT_SIZE; i++)
+                diff.RMS_ERR[i] = sqrt(diff.RMS_ERR[i] / ((double) tick_num * m_agent_num));
+        }
+        if (!diff.DIVERGED && m_tick_num != ref.m_tick_num) {
+            std::cerr << "#warning: tick_num: " << m_tick_num << " != ref: " << ref.m_tick_num;
+            std::cerr << " (compared first " << tick_num << " ticks) @crlGolden::compare()" << std::endl;
+        }
+        return !diff.DIVERGED;
+    }
+
+    // 比較結果をコンソールに出力
+    static void print_diff(const ac::golden_diff_t &diff) {
+        if (diff.DIVERGED) {
+            std::cout << "golden: DIVERGED at tick " << diff.TICK << ", agent " << diff.AGENT;
+            std::cout << ", stat[" << diff.STAT << "]: ref " << std::hexfloat << diff.REF;
+            std::cout << ", val " << diff.VAL << std::defaultfloat << std::endl;
+        } else {
+            std::cout << "golden: OK" << std::endl;
+        }
+        std::cout << "golden: max_err [";
+        for (int i = 0; i < STAT_SIZE; i++) {
+            std::cout << " " << diff.MAX_ERR[i];
+        }
+        std::cout << " ]" << std::endl;
+        std::cout << "golden: rms_err [";
+        for (int i = 0; i < STAT_SIZE; i++) {
+            std::cout << " " << diff.RMS_ERR[i];
+        }
+        std::cout << " ]" << std::endl;
+    }
+};
+
+#endif // CRL_GOLDEN_HPP
@@ -0,0 +1,230 @@
+/***************************************************************************
+ * crlInputLog.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * 操作者の入力（マウス・ジョイスティック）をステップごとに記録し，描画なしで再生する
+ *   crlInputRecorder rec;
+ *   rec.open("input.bin", seed, AGENT_NUM, SAMPLING_TIME);  // g_set_seed(seed) で始めたセッションを記録
+ *   while (true) {
+ *       f.MV[0] = ...; f.AXIS[0] = ...;                    // このステップで使う入力
+ *       step_agents(agent, sec);
+ *       rec.record(tick, f, agent);                        // 入力・時刻・ステップ後の状態のダイジェスト
+ *   }
+ *   ...
+ *   crlInputReplay rp;
+ *   rp.load("input.bin");
+ *   g_set_seed(rp.get_seed());
+ *   rp.get(t, f);                                          // ステップ t の入力
+ *   rp.check(t, agent);                                    // 記録時と同じ状態か（ダイジェストを比較）
+ * 1ステップに1フレーム（固定長）を追記し，毎回書き出すので，セッションを途中で終了しても記録済みのステップは残る
+ * （途中で切れた最後のフレームは読み込み時に捨てる）。
+ * 乱数のシード・入力が同じなら軌道も同じになるので，再生時にダイジェストが食い違ったステップを報告する。
+ *****************************************************************************/
+
+#ifndef CRL_INPUT_LOG_HPP
+#define CRL_INPUT_LOG_HPP
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include "crlAgentCore.hpp"
+
+#define INPUT_LOG_MAGIC "CRLINPT1" // ファイル先頭の識別子 (8 byte)
+#define INPUT_MOUSE_DIM 2 // マウスの入力の次元
+#define INPUT_AXIS_NUM 4 // 記録するジョイスティックの軸の数
+
+namespace agentcore {
+    // 1ステップ分の操作者の入力
+    typedef struct {
+        int64_t TICK; // 入力を使ったステップ
+        int64_t NS; // 記録開始からの経過時間 [ns]
+        double MV[INPUT_MOUSE_DIM]; // マウスの入力 (crlAgentGLFW::get_mv())
+        double AXIS[INPUT_AXIS_NUM]; // ジョイスティックの軸 [-1:1]
+        uint32_t BUTTON; // ジョイスティックのボタン（i ビット目: ボタン i の押下）
+        uint32_t RESERVED;
+        uint64_t DIGEST; // このステップの後の全エージェントの状態のダイジェスト
+    } input_frame_t;
+
+    void init(input_frame_t &f) {
+        std::memset(&f, 0, sizeof(input_frame_t));
+    }
+
+    // 全エージェントの状態（ビット列）のダイジェスト (FNV-1a)
+    template<class T>
+    uint64_t state_digest(const std::vector<T> &agent) {
+        uint64_t h = 14695981039346656037ull;
+        double s[STAT_SIZE];
+        for (const T &a : agent) {
+            a.get_stat(s);
+            const unsigned char *p = (const unsigned char *) s;
+            for (size_t k = 0; k < sizeof(s); k++) {
+                h ^= p[k];
+                h *= 1099511628211ull;
+            }
+        }
+        return h;
+    }
+}
+
+// 操作者の入力の記録
+class crlInputRecorder {
+    std::ofstream m_ofs;
+    std::string m_file;
+    std::chrono::steady_clock::time_point m_t0;
+    long m_frame_num;
+
+public:
+    crlInputRecorder() {
+        m_frame_num = 0;
+    }
+
+    // g_set_seed(seed) で始めたセッションの記録を file に書き始める
+    bool open(const std::string &file, unsigned int seed, int agent_num, double smpl_time) {
+        m_ofs.open(file, std::ios::binary | std::ios::trunc);
+        if (!m_ofs) {
+            std::cerr << "#error: couldn't open [" << file << "] @crlInputRecorder::open()" << std::endl;
+            return false;
+        }
+        m_file = file;
+        int32_t frame_size = sizeof(ac::input_frame_t);
+        int32_t an = agent_num;
+        uint32_t sd = seed;
+        m_ofs.write(INPUT_LOG_MAGIC, 8);
+        m_ofs.write((const char *) &frame_size, sizeof(frame_size));
+        m_ofs.write((const char *) &an, sizeof(an));
+        m_ofs.write((const char *) &sd, sizeof(sd));
+        m_ofs.write((const char *) &smpl_time, sizeof(smpl_time));
+        m_ofs.flush();
+        m_t0 = std::chrono::steady_clock::now();
+        m_frame_num = 0;
+        return (bool) m_ofs;
+    }
+
+    bool is_open() const { return m_ofs.is_open(); }
+
+    // ステップ tick の入力 f を，経過時間とステップ後の状態 agent のダイジェストを付けて追記する
+    template<class T>
+    bool record(long tick, ac::input_frame_t &f, const std::vector<T> &agent) {
+        if (!m_ofs.is_open()) {
+            std::cerr << "#error: not opened. @crlInputRecorder::record()" << std::endl;
+            return false;
+        }
+        if (tick != m_frame_num) {
+            std::cerr << "#error: tick: " << tick << " != recorded frames: " << m_frame_num;
+            std::cerr << " @crlInputRecorder::record()" << std::endl;
+            return false;
+        }
+        f.TICK = tick;
+        f.NS = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_t0).count();
+        f.RESERVED = 0;
+        f.DIGEST = ac::state_digest(agent);
+        m_ofs.write((const char *) &f, sizeof(ac::input_frame_t));
+        m_ofs.flush(); // 途中で終了しても記録済みのステップを残す
+        if (!m_ofs) {
+            std::cerr << "#error: write error [" << m_file << "] @crlInputRecorder::record()" << std::endl;
+            return false;
+        }
+        m_frame_num++;
+        return true;
+    }
+
+    long get_frame_num() const { return m_frame_num; }
+
+    void close() {
+        if (m_ofs.is_open()) m_ofs.close();
+    }
+};
+
+// 記録した入力の再生
+class crlInputReplay {
+    std::vector<ac::input_frame_t> m_frame;
+    int m_agent_num;
+    unsigned int m_seed;
+    double m_smpl_time;
+    long m_diverged; // 最初にダイジェストが食い違ったステップ（-1: なし）
+
+public:
+    crlInputReplay() {
+        m_agent_num = 0;
+        m_seed = 0;
+        m_smpl_time = 0.0;
+        m_diverged = -1;
+    }
+
+    bool load(const std::string &file) {
+        std::ifstream ifs(file, std::ios::binary);
+        if (!ifs) {
+            std::cerr << "#error: couldn't open [" << file << "] @crlInputReplay::load()" << std::endl;
+            return false;
+        }
+        char magic[8];
+        int32_t frame_size, agent_num;
+        uint32_t seed;
+        ifs.read(magic, 8);
+        ifs.read((char *) &frame_size, sizeof(frame_size));
+        ifs.read((char *) &agent_num, sizeof(agent_num));
+        ifs.read((char *) &seed, sizeof(seed));
+        ifs.read((char *) &m_smpl_time, sizeof(m_smpl_time));
+        if (!ifs || std::memcmp(magic, INPUT_LOG_MAGIC, 8) != 0 || frame_size != (int32_t) sizeof(ac::input_frame_t) ||
+            agent_num <= 0) {
+            std::cerr << "#error: [" << file << "] is not an input log file. @crlInputReplay::load()" << std::endl;
+            return false;
+        }
+        m_agent_num = agent_num;
+        m_seed = seed;
+        m_frame.clear();
+        ac::input_frame_t f;
+        while (ifs.read((char *) &f, sizeof(ac::input_frame_t))) { // 途中で切れた最後のフレームは読まない
+            if (f.TICK != (int64_t) m_frame.size()) {
+                std::cerr << "#error: frame " << m_frame.size() << " has tick " << f.TICK << " [" << file;
+                std::cerr << "] @crlInputReplay::load()" << std::endl;
+                return false;
+            }
+            m_frame.push_back(f);
+        }
+        m_diverged = -1;
+        return true;
+    }
+
+    int get_agent_num() const { return m_agent_num; }
+
+    unsigned int get_seed() const { return m_seed; }
+
+    double get_smpl_time() const { return m_smpl_time; }
+
+    // 記録されたステップ数
+    long get_tick_num() const { return (long) m_frame.size(); }
+
+    // 記録開始からステップ tick までの経過時間 [sec]
+    double get_sec(long tick) const { return (tick >= 0 && tick < get_tick_num()) ? m_frame[tick].NS * 1.0e-9 : 0.0; }
+
+    // ステップ tick の入力
+    bool get(long tick, ac::input_frame_t &f) const {
+        if (tick < 0 || tick >= get_tick_num()) {
+            std::cerr << "#error: tick: " << tick << " is out of [0, " << get_tick_num() << ") @crlInputReplay::get()";
+            std::cerr << std::endl;
+            return false;
+        }
+        f = m_frame[tick];
+        return true;
+    }
+
+    // ステップ tick の後の状態 agent が記録時と同じか（最初に食い違ったステップを get_diverged() に残す）
+    template<class T>
+    bool check(long tick, const std::vector<T> &agent) {
+        if (tick < 0 || tick >= get_tick_num()) return false;
+        if (ac::state_digest(agent) == m_frame[tick].DIGEST) return true;
+        if (m_diverged < 0) m_diverged = tick;
+        return false;
+    }
+
+    long get_diverged() const { return m_diverged; }
+};
+
+#endif // CRL_INPUT_LOG_HPP
@@ -0,0 +1,187 @@
+/***************************************************************************
+ * crlPacer.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * 絶対時刻の締め切りによる実時間のペース配分（一定周期のステップ）
+ *   crlPacer pacer;
+ *   pacer.init(SAMPLING_TIME, 1.0);   // 周期 [sec]，実時間倍率（2.0 なら2倍速）
+ *   while (true) {
+ *       step_agents(agent, sec);
+ *       pacer.wait();                 // 次の締め切りまで待つ
+ *   }
+ * 締め切りは開始時刻 + k * 周期 / 倍率 で決め，その時刻まで眠る（Linux: clock_nanosleep の TIMER_ABSTIME）。
+ * ステップの処理時間や眠りの誤差が次の周期に持ち越されないので，長時間実行しても周期がずれない。
+ * 締め切りに遅れたときは PACE_CATCH_UP（待たずに続けて実行し，遅れを取り戻す）か
+ * PACE_SKIP（遅れた周期を飛ばし，次の締め切りから再開する）を選ぶ。
+ * 締め切りからの起床の遅れ（ジッタ），周期を超えた回数，飛ばした周期の数を記録する。
+ *****************************************************************************/
+
+#ifndef CRL_PACER_HPP
+#define CRL_PACER_HPP
+
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+#include <time.h>
+#include <errno.h>
+#endif
+
+#define PACE_CATCH_UP 0 // 遅れたら待たずに続けて実行する
+#define PACE_SKIP 1 // 遅れたら遅れた周期を飛ばす
+#define PACE_CATCH_UP_MAX 10 // PACE_CATCH_UP で取り戻す最大の周期数（これ以上遅れたら飛ばす）
+
+namespace agentcore {
+    // 単調増加する時刻 [ns]
+    int64_t monotonic_ns() {
+#ifdef __linux__
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // 時刻 t [ns]（monotonic_ns()）まで眠る
+    void sleep_until_ns(int64_t t) {
+#ifdef __linux__
+        timespec ts;
+        ts.tv_sec = (time_t) (t / 1000000000);
+        ts.tv_nsec = (long) (t % 1000000000);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+#else
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(t)));
+#endif
+    }
+}
+
+class crlPacer {
+    int64_t m_period; // 実時間での周期 [ns]
+    int64_t m_start; // 最初の締め切りの1周期前
+    int64_t m_last; // 直前に wait() から戻った時刻
+    long m_k; // 次の締め切りの番号
+    double m_period_sec, m_rt_factor;
+    int m_policy;
+    // 統計
+    long m_tick_num, m_late_num, m_overrun_num, m_skip_num;
+    double m_lag_sum, m_lag_sum2, m_lag_max; // 締め切りからの起床の遅れ [sec]
+    double m_busy_max; // wait() を呼ぶまでの処理時間の最大値 [sec]
+
+public:
+    crlPacer() {
+        init(0.033);
+    }
+
+    // 周期 period [sec] を実時間倍率 rt_factor で刻む（rt_factor = 2.0 なら実時間の半分の周期）
+    bool init(double period, double rt_factor = 1.0, int policy = PACE_CATCH_UP) {
+        if (period <= 0.0 || rt_factor <= 0.0 || (policy != PACE_CATCH_UP && policy != PACE_SKIP)) {
+            std::cerr << "#error: period: " << period << ", rt_factor: " << rt_factor << ", policy: " << policy;
+            std::cerr << " @crlPacer::init()" << std::endl;
+            return false;
+        }
+        m_period_sec = period;
+        m_rt_factor = rt_factor;
+        m_policy = policy;
+        m_period = (int64_t) llround(period / rt_factor * 1.0e9);
+        if (m_period < 1) m_period = 1;
+        reset();
+        return true;
+    }
+
+    // 実時間倍率を変える（次の締め切りから）
+    bool set_rt_factor(double rt_factor) {
+        if (rt_factor <= 0.0) {
+            std::cerr << "#error: rt_factor: " << rt_factor << " is not positive. @crlPacer::set_rt_factor()" << std::endl;
+            return false;
+        }
+        const int64_t next = m_start + m_k * m_period;
+        m_rt_factor = rt_factor;
+        m_period = (int64_t) llround(m_period_sec / rt_factor * 1.0e9);
+        if (m_period < 1) m_period = 1;
+        m_k = 1;
+        m_start = next - m_period;
+        return true;
+    }
+
+    // 今を起点に締め切りと統計を初期化する
+    void reset() {
+        m_last = agentcore::monotonic_ns();
+        m_start = m_last;
+        m_k = 1;
+        m_tick_num = m_late_num = m_overrun_num = m_skip_num = 0;
+        m_lag_sum = m_lag_sum2 = m_lag_max = 0.0;
+        m_busy_max = 0.0;
+    }
+
+    // 次の締め切りまで待つ（遅れていれば方針に従って待たずに戻る）。飛ばした周期の数を返す
+    long wait() {
+        const int64_t now = agentcore::monotonic_ns();
+        const double busy = (now - m_last) * 1.0e-9;
+        if (busy > m_busy_max) m_busy_max = busy;
+        if (now - m_last > m_period) m_overrun_num++;
+        int64_t deadline = m_start + m_k * m_period;
+        long skip = 0;
+        if (now > deadline) {
+            m_late_num++;
+            const long behind = (long) ((now - deadline) / m_period); // 遅れた周期の数
+            if (m_policy == PACE_SKIP || behind >= PACE_CATCH_UP_MAX) {
+                skip = behind + 1;
+                m_k += skip;
+                deadline = m_start + m_k * m_period;
+            }
+        }
+        if (deadline > now) agentcore::sleep_until_ns(deadline);
+        m_last = agentcore::monotonic_ns();
+        const double lag = (m_last > deadline ? m_last - deadline : 0) * 1.0e-9;
+        m_lag_sum += lag;
+        m_lag_sum2 += lag * lag;
+        if (lag > m_lag_max) m_lag_max = lag;
+        m_skip_num += skip;
+        m_tick_num++;
+        m_k++;
+        return skip;
+    }
+
+    double get_period() const { return m_period_sec; }
+
+    double get_rt_factor() const { return m_rt_factor; }
+
+    long get_tick_num() const { return m_tick_num; }
+
+    // 締め切りに遅れた回数
+    long get_late_num() const { return m_late_num; }
+
+    // ステップの処理が実時間の周期を超えた回数
+    long get_overrun_num() const { return m_overrun_num; }
+
+    // PACE_SKIP などで飛ばした周期の数
+    long get_skip_num() const { return m_skip_num; }
+
+    // 締め切りからの起床の遅れ（平均・標準偏差・最大）[sec]
+    double get_lag_mean() const { return m_tick_num > 0 ? m_lag_sum / m_tick_num : 0.0; }
+
+    double get_lag_std() const {
+        if (m_tick_num == 0) return 0.0;
+        const double m = get_lag_mean();
+        const double v = m_lag_sum2 / m_tick_num - m * m;
+        return v > 0.0 ? sqrt(v) : 0.0;
+    }
+
+    double get_lag_max() const { return m_lag_max; }
+
+    void print(std::ostream &os = std::cout) const {
+        os << "pacer: ticks " << m_tick_num << ", period [ms] " << m_period * 1.0e-6;
+        os << ", lag [ms] avg " << get_lag_mean() * 1000.0 << ", std " << get_lag_std() * 1000.0;
+        os << ", max " << m_lag_max * 1000.0 << ", busy max [ms] " << m_busy_max * 1000.0;
+        os << ", late " << m_late_num << ", overrun " << m_overrun_num << ", skipped " << m_skip_num << std::endl;
+    }
+};
+
+#endif // CRL_PACER_HPP
@@ -0,0 +1,259 @@
+/***************************************************************************
+ * crlPerception.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * 全エージェントの視野内の近傍をまとめて求める（SIGHT_RANGE と SIGHT_ANGLE を考慮）
+ *   crlPerception per;
+ *   per.update(world);                           // crlAgentArray の位置・速度から
+ *   for (int k = per.begin(i); k < per.end(i); k++)
+ *       per.get_neighbor(k);                     // i から見えるエージェントの番号
+ * 視野: 表面間の距離 (中心間の距離 - 半径の和) が SIGHT_RANGE 未満，かつ
+ *       速度方向と相手への方向のなす角が SIGHT_ANGLE / 2 以下（速度がほぼ 0 のときは全方向）。
+ * 角度は内積と cos(SIGHT_ANGLE / 2) の比較で判定する（三角関数・平方根を使わない）。
+ * 結果はエージェント順に詰めた配列 (CSR) に格納する。
+ * SIGHT_SIGMA > 0 のエージェントの相対位置には観測ノイズ N(0, SIGHT_SIGMA) を加える（観測値）。
+ *   per.set_seed(seed); per.update(world, tick); // ノイズは (seed, tick, 観測者) ごとの乱数列で再現可能
+ * 見える・見えないの判定は真の位置で行う。
+ * update(world, tick, pool) は crlThreadPool で観測者ごとに並列に求める（結果は同じ）。
+ * nearest(world, i, rel) は視野内で最も近い相手（表面間の距離, 観測値）を返す。
+ * 視野内に誰もいなければ，視野外も含めて真の位置で最も近い相手を格子で探す。
+ *****************************************************************************/
+
+#ifndef CRL_PERCEPTION_HPP
+#define CRL_PERCEPTION_HPP
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "crlAgentArray.hpp"
+#include "crlSpatialGrid.hpp"
+
+template<int DIM>
+class crlPerceptionT {
+    // 観測者ごとの近傍の一時領域（ワーカーごと）
+    struct buffer_t {
+        std::vector<int> nbr;
+        std::vector<double> rel[DIM];
+        std::vector<double> gauss; // 観測ノイズ（観測者ごとにまとめて生成）
+    };
+
+    crlSpatialGridT<DIM> m_grid;
+    std::vector<int> m_offset; // i の近傍は m_nbr[m_offset[i]] ~ m_nbr[m_offset[i + 1] - 1]
+    std::vector<int> m_nbr; // 近傍のエージェント番号
+    std::vector<double> m_rel[DIM]; // 近傍への相対位置（最小イメージ）
+    std::vector<double> m_cos_half; // cos(SIGHT_ANGLE / 2)（全方向なら -2.0）
+    double m_r_max; // 半径の最大値
+    uint64_t m_seed; // 観測ノイズのシード
+    buffer_t m_buf; // 逐次実行用
+    crlWorkerLocal<buffer_t> m_local; // 並列実行用
+    std::vector<int> m_src_w, m_src_at; // 並列実行時の i の近傍の位置（ワーカー, 先頭）
+
+public:
+    crlPerceptionT() {
+        m_offset.assign(1, 0);
+        m_r_max = 0.0;
+        m_seed = 0;
+    }
+
+    void set_seed(uint64_t seed) { m_seed = seed; }
+
+    // 視野内の近傍と，その相対位置の観測値を求める（自分自身は含まない）
+    bool update(const crlAgentArrayT<DIM> &world, long tick = 0) {
+        const int num = world.size();
+        if (!prepare(world)) return false;
+        for (int d = 0; d < DIM; d++)
+            m_rel[d].clear();
+        m_nbr.clear();
+        for (int i = 0; i < num; i++) {
+            const int b = (int) m_nbr.size();
+            query(world, i, m_nbr, m_rel);
+            m_offset[i + 1] = (int) m_nbr.size();
+            add_noise(world, i, tick, b, m_buf.gauss);
+        }
+        return true;
+    }
+
+    // update() をスレッドプールで並列に行う（結果は update() と一致）
+    //   観測者ごとの近傍をワーカーごとの一時領域に求めてから，エージェント順に詰める
+    bool update(const crlAgentArrayT<DIM> &world, long tick, crlThreadPool &pool) {
+        const int num = world.size();
+        if (!prepare(world)) return false;
+        m_local.resize(pool.size());
+        for (int w = 0; w < pool.size(); w++) {
+            m_local[w].nbr.clear();
+            for (int d = 0; d < DIM; d++)
+                m_local[w].rel[d].clear();
+        }
+        m_src_w.resize(num);
+        m_src_at.resize(num);
+        pool.parallel_for(0, num, [&](long b, long e, int w) {
+            buffer_t &buf = m_local[w];
+            for (int i = (int) b; i < (int) e; i++) {
+                m_src_w[i] = w;
+                m_src_at[i] = (int) buf.nbr.size();
+                query(world, i, buf.nbr, buf.rel);
+                m_offset[i + 1] = (int) buf.nbr.size() - m_src_at[i];
+            }
+        }, 16);
+        for (int i = 0; i < num; i++)
+            m_offset[i + 1] += m_offset[i];
+        m_nbr.resize(m_offset[num]);
+        for (int d = 0; d < DIM; d++)
+            m_rel[d].resize(m_offset[num]);
+        pool.parallel_for(0, num, [&](long b, long e, int w) {
+            for (int i = (int) b; i < (int) e; i++) {
+                const buffer_t &src = m_local[m_src_w[i]];
+                const int at = m_src_at[i], n = m_offset[i + 1] - m_offset[i];
+                for (int k = 0; k < n; k++)
+                    m_nbr[m_offset[i] + k] = src.nbr[at + k];
+                for (int d = 0; d < DIM; d++)
+                    for (int k = 0; k < n; k++)
+                        m_rel[d][m_offset[i] + k] = src.rel[d][at + k];
+                add_noise(world, i, tick, m_offset[i], m_local[w].gauss);
+            }
+        }, 64);
+        return true;
+    }
+
+    int size() const { return (int) m_offset.size() - 1; }
+
+    // i の近傍は k = begin(i) ~ end(i) - 1
+    int begin(int i) const { return m_offset[i]; }
+
+    int end(int i) const { return m_offset[i + 1]; }
+
+    int get_neighbor_num(int i) const { return m_offset[i + 1] - m_offset[i]; }
+
+    int get_neighbor(int k) const { return m_nbr[k]; }
+
+    // 近傍 k への相対位置（軸 d, 観測値）
+    double get_rel(int k, int d) const { return m_rel[d][k]; }
+
+    const int *offset() const { return m_offset.data(); }
+
+    const int *neighbor() const { return m_nbr.data(); }
+
+    const double *rel(int d) const { return m_rel[d].data(); }
+
+    int get_total_num() const { return (int) m_nbr.size(); }
+
+    // i に最も近い相手の番号（表面間の距離。同じ距離なら番号の小さい方。他にいなければ -1）と相対位置 rel
+    //   視野内の近傍があればその観測値から，なければ視野外も含めた真の位置から（update() の後に呼ぶ）
+    int nearest(const crlAgentArrayT<DIM> &world, int i, double *rel) const {
+        int best = -1;
+        double best_d = INFINITY;
+        for (int k = m_offset[i]; k < m_offset[i + 1]; k++) {
+            double r2 = 0.0;
+            for (int d = 0; d < DIM; d++)
+                r2 += m_rel[d][k] * m_rel[d][k];
+            const double dk = sqrt(r2) - world.get_radius(m_nbr[k]);
+            if (dk < best_d || (best >= 0 && dk == best_d && m_nbr[k] < m_nbr[best])) {
+                best_d = dk;
+                best = k;
+            }
+        }
+        if (best >= 0) {
+            for (int d = 0; d < DIM; d++)
+                rel[d] = m_rel[d][best];
+            return m_nbr[best];
+        }
+        // 視野外: 格子を広げながら探す
+        const ac::field_environment_t &env = world.get_env();
+        double f_size[DIM], p[DIM];
+        for (int d = 0; d < DIM; d++) {
+            f_size[d] = ac::field_max(env, d) - ac::field_min(env, d);
+            p[d] = world.pos(d)[i];
+        }
+        const int j = m_grid.nearest(p, i, m_r_max, [&](int n) {
+            double r2 = 0.0;
+            for (int d = 0; d < DIM; d++) {
+                const double r = ac::min_image(world.pos(d)[n] - p[d], f_size[d]);
+                r2 += r * r;
+            }
+            return sqrt(r2) - world.get_radius(n);
+        });
+        for (int d = 0; d < DIM; d++)
+            rel[d] = (j >= 0) ? ac::min_image(world.pos(d)[j] - p[d], f_size[d]) : 0.0;
+        return j;
+    }
+
+private:
+
+    // 視野角度の閾値と探索半径を求め，格子を作る
+    bool prepare(const crlAgentArrayT<DIM> &world) {
+        const int num = world.size();
+        m_offset.assign(num + 1, 0);
+        if (num == 0) return true;
+        double reach = 0.0;
+        m_r_max = 0.0;
+        m_cos_half.resize(num);
+        for (int i = 0; i < num; i++) {
+            double angle = world.get_sight_angle(i);
+            m_cos_half[i] = (angle >= 360.0) ? -2.0 : cos(0.5 * angle * M_PI / 180.0);
+            if (world.get_sight_range(i) + world.get_radius(i) > reach)
+                reach = world.get_sight_range(i) + world.get_radius(i);
+            if (world.get_radius(i) > m_r_max) m_r_max = world.get_radius(i);
+        }
+        if (!m_grid.init(world.get_env(), reach + m_r_max)) return false;
+        m_grid.build(world);
+        return true;
+    }
+
+    // 観測者 i の視野内の近傍を nbr, rel の末尾に加える
+    void query(const crlAgentArrayT<DIM> &world, int i, std::vector<int> &nbr, std::vector<double> *rel) const {
+        const ac::field_environment_t &env = world.get_env();
+        double f_size[DIM];
+        double p[DIM], h[DIM], hn = 0.0;
+        for (int d = 0; d < DIM; d++) {
+            f_size[d] = ac::field_max(env, d) - ac::field_min(env, d);
+            p[d] = world.pos(d)[i];
+            h[d] = world.vel(d)[i];
+            hn += h[d] * h[d];
+        }
+        const double range = world.get_sight_range(i) + world.get_radius(i);
+        const double c = m_cos_half[i];
+        const bool cone = (c > -1.0) && (hn >= 0.001 * 0.001);
+        const double c2hn = c * c * hn;
+        m_grid.query(p, range + m_r_max, [&](int j) {
+            if (j == i) return;
+            double r[DIM], r2 = 0.0, dot = 0.0;
+            for (int d = 0; d < DIM; d++) {
+                r[d] = ac::min_image(world.pos(d)[j] - p[d], f_size[d]);
+                r2 += r[d] * r[d];
+                dot += h[d] * r[d];
+            }
+            const double lim = range + world.get_radius(j);
+            if (r2 >= lim * lim) return;
+            // dot >= |h| |r| cos を平方根なしで判定
+            if (cone) {
+                const bool in = (c >= 0.0) ? (dot >= 0.0 && dot * dot >= c2hn * r2)
+                                           : (dot >= 0.0 || dot * dot <= c2hn * r2);
+                if (!in) return;
+            }
+            nbr.push_back(j);
+            for (int d = 0; d < DIM; d++)
+                rel[d].push_back(r[d]);
+        });
+    }
+
+    // 観測者 i の近傍（m_rel の b 番目から）の相対位置に観測ノイズを加える
+    void add_noise(const crlAgentArrayT<DIM> &world, int i, long tick, int b, std::vector<double> &gauss) {
+        const double sigma = world.get_sight_sigma(i);
+        const int n = m_offset[i + 1] - b;
+        if (sigma <= 0.0 || n == 0) return;
+        gauss.resize(n * DIM);
+        ac::fill_gauss(gauss.data(), n * DIM, ac::stream_key(m_seed, (uint64_t) tick, (uint64_t) i), sigma);
+        for (int d = 0; d < DIM; d++) {
+            double *r = m_rel[d].data() + b;
+            const double *g = gauss.data() + d * n;
+            for (int k = 0; k < n; k++)
+                r[k] += g[k];
+        }
+    }
+};
+
+typedef crlPerceptionT<U_SIZE> crlPerception; // 2次元
+
+#endif // CRL_PERCEPTION_HPP
@@ -0,0 +1,312 @@
+/***************************************************************************
+ * crlPerfCounter.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * ハードウェア性能カウンタ（Linux: perf_event_open）による区間計測
+ *   crlPerfProfiler prof;
+ *   int ph = prof.add_phase("sense");
+ *   prof.set_active(true);
+ *   prof.begin(ph); ... prof.end(ph); // スレッドごと・区間ごとに積算
+ *   prof.print();
+ * カウンタが使えない環境（権限不足・仮想マシン・Linux 以外）では経過時間のみ計測する。
+ *****************************************************************************/
+
+#ifndef CRL_PERF_COUNTER_HPP
+#define CRL_PERF_COUNTER_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+#define PERF_PHASE_MAX 16 // 登録できる区間の最大数
+
+namespace agentcore {
+    enum {
+        PERF_CYCLES = 0,
+        PERF_INSTRUCTIONS,
+        PERF_L1D_MISSES,
+        PERF_LLC_MISSES,
+        PERF_BRANCH_MISSES,
+        PERF_EVENT_NUM
+    };
+
+    const char *perf_event_name(int ev) {
+        static const char *name[PERF_EVENT_NUM] = {"cycles", "instr", "L1D-miss", "LLC-miss", "br-miss"};
+        return name[ev];
+    }
+
+    // 区間ごとの積算値
+    typedef struct {
+        int THREAD; // スレッド番号 (crlPerfProfiler 内の通し番号)
+        int PHASE;
+        long CALLS;
+        double SEC; // 経過時間 [sec]
+        uint64_t VAL[PERF_EVENT_NUM];
+        unsigned AVAIL; // 計測したスレッドで使えたイベント（ビット ev）
+    } perf_record_t;
+}
+
+// 1スレッド分のカウンタ（呼び出したスレッドのユーザ空間のみ計測）
+class crlPerfCounter {
+    int m_fd[agentcore::PERF_EVENT_NUM]; // イベントごとの fd（開けなかったものは -1）
+    int m_order[agentcore::PERF_EVENT_NUM]; // グループ読み出し時の並び -> イベント番号
+    int m_num; // 開けたイベント数
+    bool m_active;
+
+public:
+    crlPerfCounter() {
+        for (int i = 0; i < agentcore::PERF_EVENT_NUM; i++) {
+            m_fd[i] = -1;
+            m_order[i] = -1;
+        }
+        m_num = 0;
+        m_active = false;
+    }
+
+    ~crlPerfCounter() {
+        close();
+    }
+
+    crlPerfCounter(const crlPerfCounter &) = delete;
+
+    crlPerfCounter &operator=(const crlPerfCounter &) = delete;
+
+    bool open() {
+        if (m_active) return true;
+#ifdef __linux__
+        int leader = -1;
+        for (int ev = 0; ev < agentcore::PERF_EVENT_NUM; ev++) {
+            struct perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            switch (ev) {
+                case agentcore::PERF_CYCLES:
+                    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                    break;
+                case agentcore::PERF_INSTRUCTIONS:
+                    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                    break;
+                case agentcore::PERF_L1D_MISSES:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                    break;
+                case agentcore::PERF_LLC_MISSES:
+                    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                    break;
+                default:
+                    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                    break;
+            }
+            attr.disabled = (leader == -1) ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            int fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+            if (fd < 0) continue; // このイベントは使えない
+            if (leader == -1) leader = fd;
+            m_fd[ev] = fd;
+            m_order[m_num++] = ev;
+        }
+        if (leader == -1) return false;
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        m_active = true;
+#endif
+        return m_active;
+    }
+
+    void close() {
+#ifdef __linux__
+        for (int i = 0; i < agentcore::PERF_EVENT_NUM; i++) {
+            if (m_fd[i] >= 0) ::close(m_fd[i]);
+            m_fd[i] = -1;
+            m_order[i] = -1;
+        }
+#endif
+        m_num = 0;
+        m_active = false;
+    }
+
+    bool is_active() const {
+        return m_active;
+    }
+
+    bool is_available(int ev) const {
+        return m_fd[ev] >= 0;
+    }
+
+    // 現在のカウンタ値（使えないイベントは 0）
+    bool read(uint64_t *val) const {
+        for (int i = 0; i < agentcore::PERF_EVENT_NUM; i++)
+            val[i] = 0;
+        if (!m_active) return false;
+#ifdef __linux__
+        uint64_t buf[1 + agentcore::PERF_EVENT_NUM];
+        if (::read(m_fd[m_order[0]], buf, sizeof(buf)) < (ssize_t) sizeof(uint64_t)) return false;
+        for (int i = 0; i < (int) buf[0] && i < m_num; i++)
+            val[m_order[i]] = buf[1 + i];
+#endif
+        return true;
+    }
+};
+
+// 区間（センシング・制御・駆動など）ごと・スレッドごとの積算
+class crlPerfProfiler {
+    bool m_active;
+    std::vector<std::string> m_phase;
+    std::vector<agentcore::perf_record_t> m_rec;
+    std::mutex m_mtx;
+    std::atomic<int> m_thread_num;
+
+    // スレッドごとの計測状態
+    typedef struct {
+        const crlPerfProfiler *OWNER;
+        int THREAD;
+        crlPerfCounter *COUNTER;
+        uint64_t START[PERF_PHASE_MAX][agentcore::PERF_EVENT_NUM];
+        std::chrono::steady_clock::time_point T0[PERF_PHASE_MAX];
+    } thread_stat_t;
+
+public:
+    crlPerfProfiler() {
+        m_active = false;
+        m_thread_num = 0;
+    }
+
+    // 区間を登録して区間番号を返す
+    int add_phase(const std::string &name) {
+        if ((int) m_phase.size() >= PERF_PHASE_MAX) {
+            std::cerr << "#error: too many phases (max: " << PERF_PHASE_MAX << ") @crlPerfProfiler::add_phase()";
+            std::cerr << std::endl;
+            return -1;
+        }
+        m_phase.push_back(name);
+        return (int) m_phase.size() - 1;
+    }
+
+    bool set_active(bool flg) {
+        m_active = flg;
+        return true;
+    }
+
+    bool is_active() const {
+        return m_active;
+    }
+
+    // 呼び出したスレッドでカウンタが使えるか
+    bool is_counter_available() {
+        return thread_stat().COUNTER->is_active();
+    }
+
+    void begin(int phase) {
+        if (!m_active || phase < 0) return;
+        thread_stat_t &ts = thread_stat();
+        ts.COUNTER->read(ts.START[phase]);
+        ts.T0[phase] = std::chrono::steady_clock::now();
+    }
+
+    void end(int phase) {
+        if (!m_active || phase < 0) return;
+        thread_stat_t &ts = thread_stat();
+        uint64_t val[agentcore::PERF_EVENT_NUM];
+        ts.COUNTER->read(val);
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - ts.T0[phase]).count();
+
+        std::lock_guard<std::mutex> lock(m_mtx);
+        agentcore::perf_record_t &r = record(ts.THREAD, phase);
+        r.CALLS++;
+        r.SEC += sec;
+        for (int i = 0; i < agentcore::PERF_EVENT_NUM; i++) {
+            r.VAL[i] += val[i] - ts.START[phase][i];
+            if (ts.COUNTER->is_active() && ts.COUNTER->is_available(i)) r.AVAIL |= 1u << i;
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_rec.clear();
+    }
+
+    const std::vector<agentcore::perf_record_t> &get_records() const {
+        return m_rec;
+    }
+
+    // ticks で割った1ステップあたりの値を出力
+    //   カウンタが使えたかどうかは記録ごと（記録したスレッドのカウンタ）に判定する
+    void print(int ticks = 1, std::ostream &os = std::cout) {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        unsigned avail = 0;
+        for (const agentcore::perf_record_t &r: m_rec)
+            avail |= r.AVAIL;
+        if (ticks < 1) ticks = 1;
+        os << "perf: per tick (" << ticks << " ticks)";
+        if (avail == 0) os << " [hardware counters not available: time only]";
+        os << std::endl;
+        os << std::setw(8) << "thread" << std::setw(12) << "phase" << std::setw(12) << "time[us]";
+        for (int i = 0; i < agentcore::PERF_EVENT_NUM; i++)
+            os << std::setw(12) << agentcore::perf_event_name(i);
+        os << std::setw(8) << "IPC" << std::endl;
+
+        const unsigned ipc = (1u << agentcore::PERF_CYCLES) | (1u << agentcore::PERF_INSTRUCTIONS);
+        for (const agentcore::perf_record_t &r: m_rec) {
+            os << std::setw(8) << r.THREAD << std::setw(12) << m_phase[r.PHASE];
+            os << std::setw(12) << std::fixed << std::setprecision(1) << r.SEC * 1.0e6 / ticks;
+            for (int i = 0; i < agentcore::PERF_EVENT_NUM; i++) {
+                if ((r.AVAIL >> i) & 1u)
+                    os << std::setw(12) << r.VAL[i] / (uint64_t) ticks;
+                else
+                    os << std::setw(12) << "n/a";
+            }
+            if ((r.AVAIL & ipc) == ipc && r.VAL[agentcore::PERF_CYCLES] > 0)
+                os << std::setw(8) << std::setprecision(2)
+                   << (double) r.VAL[agentcore::PERF_INSTRUCTIONS] / (double) r.VAL[agentcore::PERF_CYCLES];
+            else
+                os << std::setw(8) << "n/a";
+            os << std::defaultfloat << std::endl;
+        }
+    }
+
+private:
+    thread_stat_t &thread_stat() {
+        static thread_local crlPerfCounter counter;
+        static thread_local thread_stat_t ts = {nullptr, -1, nullptr, {}, {}};
+        if (ts.OWNER != this) {
+            ts.OWNER = this;
+            ts.THREAD = m_thread_num++;
+            ts.COUNTER = &counter;
+            counter.open();
+        }
+        return ts;
+    }
+
+    agentcore::perf_record_t &record(int thread, int phase) {
+        for (agentcore::perf_record_t &r: m_rec) {
+            if (r.THREAD == thread && r.PHASE == phase) return r;
+        }
+        agentcore::perf_record_t r;
+        std::memset(&r, 0, sizeof(r));
+        r.THREAD = thread;
+        r.PHASE = phase;
+        m_rec.push_back(r);
+        return m_rec.back();
+    }
+};
+
+#endif // CRL_PERF_COUNTER_HPP
@@ -0,0 +1,160 @@
+/***************************************************************************
+ * crlPipeline.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * 出力段（描画・ログ・記録）をシミュレーションと別スレッドで行うパイプライン
+ *   crlPipeline<std::vector<crlAgent> > out;
+ *   out.start(2, publish_agents);   // 段数 2（最大 2 ステップ分の出力を先行して溜められる）
+ *   out.push(agent);                // 状態を複写して出力段に渡す（空きがなければ待つ）
+ *   out.push_with(fill);            // fill(T &) で出力段に渡す状態を直接書き込む（描画に必要な分だけ複写する）
+ * push() は複写だけで戻るので，ステップ t の出力とステップ t + 1 の知覚・駆動が重なる。
+ * 出力段はステップの順に1つずつ処理する。段数 0 なら push() の中で出力する（従来と同じ逐次実行）。
+ * 複写先は段数分だけ確保して使い回す（毎ステップのメモリ確保をしない）。
+ * set_affinity(cpu) で出力段のスレッドを CPU に固定する（start() の前後どちらでもよい）。
+ *****************************************************************************/
+
+#ifndef CRL_PIPELINE_HPP
+#define CRL_PIPELINE_HPP
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "crlAffinity.hpp"
+
+#define PIPELINE_DEPTH_MAX 64
+
+template<class T>
+class crlPipeline {
+    std::vector<T> m_slot; // 出力待ちの状態（リングバッファ）
+    int m_head; // 次に出力する位置
+    int m_count; // 出力待ち・出力中の数
+    int m_depth;
+    std::function<void(const T &)> m_stage;
+    std::thread m_thread;
+    std::mutex m_mtx;
+    std::condition_variable m_cv_push, m_cv_pop;
+    bool m_quit;
+    long m_push_num; // push() の回数
+    long m_stall_num; // 空きを待った回数
+    std::vector<int> m_cpu; // 出力段のスレッドを固定する CPU（空: 固定しない）
+
+public:
+    crlPipeline() {
+        m_head = m_count = m_depth = 0;
+        m_quit = false;
+        m_push_num = m_stall_num = 0;
+    }
+
+    ~crlPipeline() { stop(); }
+
+    // 段数 depth で出力段 stage(const T &) を開始する
+    template<class F>
+    bool start(int depth, F stage) {
+        if (depth < 0 || depth > PIPELINE_DEPTH_MAX) {
+            std::cerr << "#error: depth: " << depth << " is out of [0, " << PIPELINE_DEPTH_MAX << "]";
+            std::cerr << " @crlPipeline::start()" << std::endl;
+            return false;
+        }
+        stop();
+        m_stage = stage;
+        m_depth = depth;
+        m_slot.resize(depth > 0 ? depth : 1); // 段数 0 では push_with() の書き込み先に使う
+        m_head = m_count = 0;
+        m_quit = false;
+        if (depth > 0) {
+            m_thread = std::thread(&crlPipeline::run, this);
+            agentcore::set_affinity(m_thread, m_cpu);
+        }
+        return true;
+    }
+
+    // v を複写して出力段に渡す（出力待ちが段数に達していれば空くまで待つ）
+    void push(const T &v) {
+        if (m_depth == 0) {
+            m_push_num++;
+            if (m_stage) m_stage(v);
+            return;
+        }
+        push_with([&v](T &slot) { slot = v; });
+    }
+
+    // fill(T &) で書き込んだ状態を出力段に渡す（出力待ちが段数に達していれば空くまで待つ）
+    //   書き込み先は使い回すので，fill は前回の内容を上書きすること
+    template<class F>
+    void push_with(F fill) {
+        m_push_num++;
+        if (m_depth == 0) {
+            fill(m_slot[0]);
+            if (m_stage) m_stage(m_slot[0]);
+            return;
+        }
+        std::unique_lock<std::mutex> lk(m_mtx);
+        if (m_count == m_depth) {
+            m_stall_num++;
+            m_cv_pop.wait(lk, [this]() { return m_count < m_depth; });
+        }
+        const int tail = (m_head + m_count) % m_depth;
+        lk.unlock();
+        fill(m_slot[tail]); // この位置は出力段が触らない
+        lk.lock();
+        m_count++;
+        lk.unlock();
+        m_cv_push.notify_one();
+    }
+
+    // 出力待ちが全て処理されるまで待つ
+    void flush() {
+        if (m_depth == 0) return;
+        std::unique_lock<std::mutex> lk(m_mtx);
+        m_cv_pop.wait(lk, [this]() { return m_count == 0; });
+    }
+
+    // 出力待ちを処理してから出力段を終了する
+    void stop() {
+        if (!m_thread.joinable()) return;
+        flush();
+        {
+            std::lock_guard<std::mutex> lk(m_mtx);
+            m_quit = true;
+        }
+        m_cv_push.notify_one();
+        m_thread.join();
+    }
+
+    // 出力段のスレッドを cpu のいずれかで実行する（空なら固定しない）
+    bool set_affinity(const std::vector<int> &cpu) {
+        m_cpu = cpu;
+        if (!m_thread.joinable()) return true;
+        return agentcore::set_affinity(m_thread, m_cpu);
+    }
+
+    int get_depth() const { return m_depth; }
+
+    long get_push_num() const { return m_push_num; }
+
+    long get_stall_num() const { return m_stall_num; }
+
+private:
+
+    void run() {
+        std::unique_lock<std::mutex> lk(m_mtx);
+        while (true) {
+            m_cv_push.wait(lk, [this]() { return m_quit || m_count > 0; });
+            if (m_count == 0) return; // m_quit
+            const int head = m_head;
+            lk.unlock();
+            m_stage(m_slot[head]); // 出力中の位置は push() が上書きしない（m_count に含まれる）
+            lk.lock();
+            m_head = (m_head + 1) % m_depth;
+            m_count--;
+            m_cv_pop.notify_all();
+        }
+    }
+};
+
+#endif // CRL_PIPELINE_HPP
@@ -0,0 +1,263 @@
+/***************************************************************************
+ * crlSpatialGrid.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * トロイダルなフィールド上の一様格子（セルリスト）による近傍探索（2次元: crlSpatialGrid, 3次元: crlSpatialGridT<3>）
+ *   crlSpatialGrid grid;
+ *   grid.init(env, cell_size);      // セルの幅は cell_size 以上
+ *   grid.build(world);              // crlAgentArray の位置でセルに振り分け（計数ソート）
+ *   grid.for_each_pair(f);          // 隣接セル内の全ての組 (i, j) を1回ずつ f(i, j)
+ *   grid.query(p, r, f);            // p から r 以内にあり得るエージェント n に f(n)
+ *   grid.nearest(p, i, slack, f);   // 距離 f(n) が最小のエージェント（探索半径を倍々に広げる）
+ *****************************************************************************/
+
+#ifndef CRL_SPATIAL_GRID_HPP
+#define CRL_SPATIAL_GRID_HPP
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "crlAgentCore.hpp"
+
+namespace agentcore {
+    // 周期境界での最小イメージ（|d| <= size / 2 に折り返す）
+    double min_image(double d, const double size) {
+        if (d > 0.5 * size)
+            d -= size;
+        else if (d < -0.5 * size)
+            d += size;
+        return d;
+    }
+}
+
+// DIM 次元の格子（セル番号は軸 0 が最下位: c = k0 + nc0 * (k1 + nc1 * k2)）
+template<int DIM>
+class crlSpatialGridT {
+    static const int NBR_MAX = (DIM == 3) ? 26 : 8; // 隣接セルの最大数 3^DIM - 1
+    int m_nc[DIM]; // 軸ごとのセル数
+    double m_width[DIM]; // セルの幅
+    double m_min[DIM], m_size[DIM]; // フィールドの最小値・大きさ
+    int m_cell_num;
+    std::vector<int> m_start; // セル c の要素は m_index[m_start[c]] ~ m_index[m_start[c + 1] - 1]
+    std::vector<int> m_index; // セル順に並べたエージェント番号
+    std::vector<int> m_cell_of; // エージェントごとのセル番号
+
+public:
+    crlSpatialGridT() {
+        m_cell_num = 0;
+        for (int d = 0; d < DIM; d++) {
+            m_nc[d] = 0;
+            m_width[d] = m_min[d] = m_size[d] = 0.0;
+        }
+    }
+
+    bool init(const ac::field_environment_t &env, double cell_size) {
+        bool valid = cell_size > 0.0;
+        for (int d = 0; d < DIM; d++)
+            valid = valid && (ac::field_max(env, d) - ac::field_min(env, d) > 0.0);
+        if (!valid) {
+            std::cerr << "#error: cell_size: " << cell_size << " or field size is not positive.";
+            std::cerr << " @crlSpatialGrid::init()" << std::endl;
+            return false;
+        }
+        int nc[DIM];
+        bool same = m_cell_num > 0;
+        for (int d = 0; d < DIM; d++) {
+            m_min[d] = ac::field_min(env, d);
+            m_size[d] = ac::field_max(env, d) - ac::field_min(env, d);
+            nc[d] = (int) floor(m_size[d] / cell_size);
+            if (nc[d] < 1) nc[d] = 1;
+            if (nc[d] > 1024) nc[d] = 1024;
+            same = same && (nc[d] == m_nc[d]);
+            m_width[d] = m_size[d] / nc[d]; // セル数が同じでもフィールドの大きさが変われば幅は変わる
+        }
+        if (same) return true; // 同じセル数（配列はそのまま使う）
+        m_cell_num = 1;
+        for (int d = 0; d < DIM; d++) {
+            m_nc[d] = nc[d];
+            m_cell_num *= m_nc[d];
+        }
+        return true;
+    }
+
+    int get_cell_num() const { return m_cell_num; }
+
+    int get_cell_num(int d) const { return m_nc[d]; }
+
+    double get_cell_width(int d) const { return m_width[d]; }
+
+    // 位置 p が含まれるセル番号
+    template<class R>
+    int cell_of(const R *p) const {
+        int c = 0;
+        for (int d = DIM - 1; d >= 0; d--) {
+            int k = (int) floor((p[d] - m_min[d]) / m_width[d]);
+            k %= m_nc[d];
+            if (k < 0) k += m_nc[d];
+            c = c * m_nc[d] + k;
+        }
+        return c;
+    }
+
+    int get_cell_of_agent(int i) const { return m_cell_of[i]; }
+
+    // 軸ごとの位置配列 pos[d][i] からセルリストを作る
+    template<class R>
+    bool build(const R *const *pos, int num) {
+        if (m_cell_num == 0) {
+            std::cerr << "#error: not initialized. @crlSpatialGrid::build()" << std::endl;
+            return false;
+        }
+        m_cell_of.resize(num);
+        m_index.resize(num);
+        m_start.assign(m_cell_num + 1, 0);
+        double p[DIM];
+        for (int i = 0; i < num; i++) {
+            for (int d = 0; d < DIM; d++)
+                p[d] = pos[d][i];
+            m_cell_of[i] = cell_of(p);
+            m_start[m_cell_of[i] + 1]++;
+        }
+        for (int c = 0; c < m_cell_num; c++)
+            m_start[c + 1] += m_start[c];
+        std::vector<int> fill(m_start.begin(), m_start.end() - 1);
+        for (int i = 0; i < num; i++)
+            m_index[fill[m_cell_of[i]]++] = i;
+        return true;
+    }
+
+    template<class W>
+    bool build(const W &world) {
+        const ac::real_t *pos[DIM];
+        for (int d = 0; d < DIM; d++)
+            pos[d] = world.pos(d);
+        return build(pos, world.size());
+    }
+
+    // セル c に含まれるエージェント
+    const int *cell_begin(int c) const { return m_index.data() + m_start[c]; }
+
+    const int *cell_end(int c) const { return m_index.data() + m_start[c + 1]; }
+
+    // セル c の隣接セル（自身を除く・重複なし）を nbr (NBR_MAX 個以上) に格納し，その数を返す
+    int get_neighbor_cells(int c, int *nbr) const {
+        int k[DIM], off[DIM];
+        for (int d = 0, r = c; d < DIM; d++) {
+            k[d] = r % m_nc[d];
+            r /= m_nc[d];
+            off[d] = -1;
+        }
+        int num = 0;
+        while (true) {
+            int n = 0;
+            for (int d = DIM - 1; d >= 0; d--)
+                n = n * m_nc[d] + (k[d] + off[d] + m_nc[d]) % m_nc[d];
+            bool dup = (n == c);
+            for (int j = 0; j < num; j++)
+                dup = dup || (nbr[j] == n);
+            if (!dup) nbr[num++] = n;
+            // 軸 0 が最も内側のループ
+            int d = 0;
+            while (d < DIM && ++off[d] > 1) {
+                off[d] = -1;
+                d++;
+            }
+            if (d == DIM) break;
+        }
+        return num;
+    }
+
+    // 同じセル・隣接セルにある全ての組 (i, j) について f(i, j) を1回ずつ呼ぶ
+    template<class F>
+    void for_each_pair(F f) const {
+        for (int c = 0; c < m_cell_num; c++)
+            for_each_pair_in_cell(c, f);
+    }
+
+    // セル c が受け持つ組（セル内の組と，番号が大きい隣接セルとの組）
+    template<class F>
+    void for_each_pair_in_cell(int c, F f) const {
+        for (const int *a = cell_begin(c); a != cell_end(c); a++) {
+            for (const int *b = a + 1; b != cell_end(c); b++)
+                f(*a, *b);
+        }
+        int nbr[NBR_MAX];
+        int nbr_num = get_neighbor_cells(c, nbr);
+        for (int k = 0; k < nbr_num; k++) {
+            if (nbr[k] < c) continue;
+            for (const int *a = cell_begin(c); a != cell_end(c); a++) {
+                for (const int *b = cell_begin(nbr[k]); b != cell_end(nbr[k]); b++)
+                    f(*a, *b);
+            }
+        }
+    }
+
+    // 位置 p から距離 r 以内にあり得る全エージェント n について f(n)（候補のみ・距離判定は呼び出し側）
+    template<class F>
+    void query(const double *p, double r, F f) const {
+        int lo[DIM], hi[DIM], k[DIM];
+        for (int d = 0; d < DIM; d++) {
+            int k0 = (int) floor((p[d] - m_min[d]) / m_width[d]);
+            int span = (int) ceil(r / m_width[d]);
+            if (2 * span + 1 > m_nc[d]) { // 軸全体を覆う
+                lo[d] = 0;
+                hi[d] = m_nc[d] - 1;
+            } else {
+                lo[d] = k0 - span;
+                hi[d] = k0 + span;
+            }
+            k[d] = lo[d];
+        }
+        while (true) {
+            int c = 0;
+            for (int d = DIM - 1; d >= 0; d--)
+                c = c * m_nc[d] + ((k[d] % m_nc[d]) + m_nc[d]) % m_nc[d];
+            for (const int *a = cell_begin(c); a != cell_end(c); a++)
+                f(*a);
+            // 軸 0 が最も内側のループ
+            int d = 0;
+            while (d < DIM && ++k[d] > hi[d]) {
+                k[d] = lo[d];
+                d++;
+            }
+            if (d == DIM) break;
+        }
+    }
+
+    // 距離 f(n) が最小のエージェント n（exclude を除く。同じ距離なら番号の小さい方。いなければ -1）
+    //   slack: 中心間の距離が r 以上の相手の f は r - slack 以上（表面間の距離なら半径の和の最大値）
+    //   探索半径をセル幅から倍々に広げ，最小の距離が探索半径の外側の下限以下になったら打ち切る
+    template<class F>
+    int nearest(const double *p, int exclude, double slack, F f, double *dist = nullptr) const {
+        double r = m_width[0];
+        for (int d = 1; d < DIM; d++)
+            if (m_width[d] > r) r = m_width[d];
+        int best = -1;
+        double best_d = INFINITY;
+        while (true) {
+            bool all = true; // 全てのセルを調べた
+            for (int d = 0; d < DIM; d++)
+                all = all && (2 * (int) ceil(r / m_width[d]) + 1 > m_nc[d]);
+            best = -1;
+            best_d = INFINITY;
+            query(p, r, [&](int n) {
+                if (n == exclude) return;
+                const double dn = f(n);
+                if (dn < best_d || (dn == best_d && n < best)) {
+                    best_d = dn;
+                    best = n;
+                }
+            });
+            if (all || (best >= 0 && best_d <= r - slack)) break;
+            r *= 2.0;
+        }
+        if (dist != nullptr) *dist = best_d;
+        return best;
+    }
+};
+
+typedef crlSpatialGridT<U_SIZE> crlSpatialGrid; // 2次元
+
+#endif // CRL_SPATIAL_GRID_HPP
@@ -0,0 +1,314 @@
+/***************************************************************************
+ * crlSweep.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * 物理パラメータ (agent_physical_t) のスイープを描画なしで並列に実行し，結果をファイルに追記する
+ *   crlSweep sw;
+ *   sw.add_grid(ac::SWEEP_M, 0.5, 2.0, 4);           // M を 0.5 ~ 2.0 の 4 点
+ *   sw.add_grid(ac::SWEEP_D, 0.0, 1.0, 5);           // 格子は全ての軸の組み合わせ（4 x 5 = 20 点）
+ *   sw.set_metric_names({"mean_speed", "min_dist"});
+ *   sw.run("sweep.tsv", run_fn, pool);               // run_fn(p, ap, metric): 1点分のシナリオを実行
+ * set_random(n) にすると，各軸の範囲から一様に選んだ n 点（ランダムデザイン）を実行する。
+ * 各点の値と乱数のシード get_seed(p) は点の番号 p とシードだけで決まる（実行順序・中断によらない）。
+ * 結果は1点終わるごとに1行追記する。同じファイルで run() を呼び直すと，記録済みの点を飛ばして続きから実行する
+ * （途中で切れた最後の行は捨てる。見出し行が異なるファイルには追記しない）。
+ * 記録済みの行のシードとパラメータが get_seed(p), get_point(p) と異なる点（軸・シード・点の数を変えた場合）は実行し直す。
+ * ファイルの書き直しは一時ファイル (file + ".tmp") に書いてから置き換えるので，途中で終了しても記録は失われない。
+ *****************************************************************************/
+
+#ifndef CRL_SWEEP_HPP
+#define CRL_SWEEP_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cmath>
+#include <limits>
+#include <iterator>
+#include <cstdlib>
+#include <cstdio>
+#include "crlAgentCore.hpp"
+#include "crlThreadPool.hpp"
+
+namespace agentcore {
+    // スイープできる物理パラメータ
+    enum {
+        SWEEP_M = 0,
+        SWEEP_D,
+        SWEEP_G,
+        SWEEP_U_MAX,
+        SWEEP_V_MAX,
+        SWEEP_RADIUS,
+        SWEEP_SIGHT_RANGE,
+        SWEEP_PARAM_NUM
+    };
+
+    const char *sweep_param_name(int k) {
+        static const char *name[SWEEP_PARAM_NUM] = {"M", "D", "G", "U_MAX", "V_MAX", "RADIUS", "SIGHT_RANGE"};
+        return name[k];
+    }
+
+    // k 番目のパラメータのメンバ（ap.*sweep_member(k) で参照する）
+    double agent_physical_t::*sweep_member(int k) {
+        static double agent_physical_t::*member[SWEEP_PARAM_NUM] = {
+                &agent_physical_t::M, &agent_physical_t::D, &agent_physical_t::G, &agent_physical_t::U_MAX,
+                &agent_physical_t::V_MAX, &agent_physical_t::RADIUS, &agent_physical_t::SIGHT_RANGE};
+        return member[k];
+    }
+}
+
+class crlSweep {
+    struct axis_t {
+        int param;
+        std::vector<double> value; // 格子の値
+        double lo, hi; // ランダムデザインの範囲
+    };
+
+    std::vector<axis_t> m_axis;
+    ac::agent_physical_t m_base; // スイープしないパラメータ
+    std::vector<std::string> m_metric_name;
+    long m_random_num; // 0: 格子
+    unsigned int m_seed;
+    long m_done_num, m_run_num, m_fail_num;
+    long m_stale_num; // 前回の run() で捨てた，パラメータが異なる記録済みの行の数
+
+public:
+    crlSweep() {
+        ac::init_physical_param(m_base);
+        m_random_num = 0;
+        m_seed = 1;
+        m_done_num = m_run_num = m_fail_num = 0;
+        m_stale_num = 0;
+    }
+
+    // param を lo ~ hi の n 点（両端を含む等間隔）でスイープする
+    bool add_grid(int param, double lo, double hi, int n) {
+        if (n < 1 || hi < lo) {
+            std::cerr << "#error: lo: " << lo << ", hi: " << hi << ", n: " << n << " @crlSweep::add_grid()" << std::endl;
+            return false;
+        }
+        std::vector<double> v(n);
+        for (int k = 0; k < n; k++)
+            v[k] = (n == 1) ? lo : lo + (hi - lo) * k / (n - 1);
+        return add_values(param, v);
+    }
+
+    // param を値の並び v でスイープする
+    bool add_values(int param, const std::vector<double> &v) {
+        if (param < 0 || param >= ac::SWEEP_PARAM_NUM || v.empty()) {
+            std::cerr << "#error: param: " << param << ", values: " << v.size() << " @crlSweep::add_values()" << std::endl;
+            return false;
+        }
+        for (const axis_t &a : m_axis) {
+            if (a.param != param) continue;
+            std::cerr << "#error: " << ac::sweep_param_name(param) << " is already added. @crlSweep::add_values()";
+            std::cerr << std::endl;
+            return false;
+        }
+        axis_t a;
+        a.param = param;
+        a.value = v;
+        a.lo = a.hi = v[0];
+        for (double x : v) {
+            if (x < a.lo) a.lo = x;
+            if (x > a.hi) a.hi = x;
+        }
+        m_axis.push_back(a);
+        return true;
+    }
+
+    // 格子の代わりに，各軸の範囲（最小値 ~ 最大値）から一様に選んだ n 点を実行する（0: 格子）
+    void set_random(long n) { m_random_num = (n > 0) ? n : 0; }
+
+    // 点の値と乱数のシードを決めるシード
+    void set_seed(unsigned int seed) { m_seed = seed; }
+
+    // スイープしないパラメータ
+    void set_base(const ac::agent_physical_t &ap) { m_base = ap; }
+
+    void set_metric_names(const std::vector<std::string> &name) { m_metric_name = name; }
+
+    // 点の数
+    long get_point_num() const {
+        if (m_random_num > 0) return m_random_num;
+        long n = 1;
+        for (const axis_t &a : m_axis)
+            n *= (long) a.value.size();
+        return n;
+    }
+
+    // p 番目の点のパラメータ（格子は最初に追加した軸が最も速く変わる）
+    void get_point(long p, ac::agent_physical_t &ap) const {
+        ap = m_base;
+        for (int k = 0; k < (int) m_axis.size(); k++) {
+            const axis_t &a = m_axis[k];
+            double x;
+            if (m_random_num > 0) {
+                const double u = (ac::stream_key(m_seed, p, k) >> 11) * (1.0 / 9007199254740992.0); // [0, 1)
+                x = a.lo + (a.hi - a.lo) * u;
+            } else {
+                x = a.value[p % a.value.size()];
+                p /= (long) a.value.size();
+            }
+            ap.*ac::sweep_member(a.param) = x;
+        }
+    }
+
+    // p 番目の点の g_set_seed() のシード
+    unsigned int get_seed(long p) const { return m_seed + 2u * (unsigned int) p; }
+
+    // 前回の run() で記録済みだった点の数，実行した点の数，run_fn が false を返した点の数
+    long get_done_num() const { return m_done_num; }
+
+    long get_run_num() const { return m_run_num; }
+
+    long get_fail_num() const { return m_fail_num; }
+
+    // 前回の run() で捨てた（シード・パラメータが現在の点と異なる）記録済みの行の数
+    long get_stale_num() const { return m_stale_num; }
+
+    // 未記録の全ての点について run_fn(p, ap, metric) を並列に呼び，1点ごとに file に追記する
+    //   run_fn は g_set_seed(get_seed(p)) の後に呼ばれる。metric に set_metric_names() の順で結果を書き込む
+    //   （false を返すと結果を nan として記録する）。run_fn は複数のスレッドから同時に呼ばれる。
+    template<class F>
+    bool run(const std::string &file, F run_fn, crlThreadPool &pool) {
+        const long point_num = get_point_num();
+        std::vector<char> done(point_num, 0);
+        bool has_header;
+        if (!resume(file, done, has_header)) return false;
+        std::ofstream ofs(file, std::ios::app);
+        if (!ofs) {
+            std::cerr << "#error: couldn't open [" << file << "] @crlSweep::run()" << std::endl;
+            return false;
+        }
+        if (!has_header) ofs << header() << std::endl;
+        std::vector<long> todo;
+        for (long p = 0; p < point_num; p++)
+            if (!done[p]) todo.push_back(p);
+        m_run_num = m_fail_num = 0;
+        std::mutex mtx;
+        pool.parallel_for(0, (long) todo.size(), [&](long b, long e, int) {
+            for (long k = b; k < e; k++) {
+                const long p = todo[k];
+                ac::agent_physical_t ap;
+                get_point(p, ap);
+                std::vector<double> metric(m_metric_name.size(), 0.0);
+                g_set_seed(get_seed(p));
+                const bool ok = run_fn(p, ap, metric);
+                if (!ok) metric.assign(m_metric_name.size(), std::numeric_limits<double>::quiet_NaN());
+                metric.resize(m_metric_name.size(), std::numeric_limits<double>::quiet_NaN());
+                const std::string line = record(p, ap, metric);
+                std::lock_guard<std::mutex> lk(mtx);
+                ofs << line << std::endl; // 1点ごとに書き出す（中断しても記録済みの点は残る）
+                m_run_num++;
+                if (!ok) m_fail_num++;
+            }
+        });
+        return (bool) ofs;
+    }
+
+private:
+
+    // 見出し行
+    std::string header() const {
+        std::string s = "#index\tseed";
+        for (int k = 0; k < ac::SWEEP_PARAM_NUM; k++)
+            s += std::string("\t") + ac::sweep_param_name(k);
+        for (const std::string &m : m_metric_name)
+            s += "\t" + m;
+        return s;
+    }
+
+    // p 番目の点の結果の行
+    std::string record(long p, const ac::agent_physical_t &ap, const std::vector<double> &metric) const {
+        std::ostringstream os;
+        os << std::setprecision(17) << p << "\t" << get_seed(p);
+        for (int k = 0; k < ac::SWEEP_PARAM_NUM; k++)
+            os << "\t" << ap.*ac::sweep_member(k);
+        for (double m : metric)
+            os << "\t" << m;
+        return os.str();
+    }
+
+    // file の記録済みの点を done に印をつけ，完全な行だけを残してファイルを書き直す
+    //   シードとパラメータの列が現在の p 番目の点と異なる行は捨てる（その点は実行し直す）
+    bool resume(const std::string &file, std::vector<char> &done, bool &has_header) {
+        m_done_num = 0;
+        m_stale_num = 0;
+        has_header = false;
+        std::ifstream ifs(file, std::ios::binary);
+        if (!ifs) return true; // 新しいファイル
+        std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        ifs.close();
+        if (content.empty()) return true;
+        const size_t last = content.rfind('\n');
+        content.resize(last == std::string::npos ? 0 : last + 1); // 途中で切れた最後の行を捨てる
+        std::istringstream is(content);
+        std::string line, kept;
+        if (!std::getline(is, line) || line != header()) {
+            std::cerr << "#error: [" << file << "] is not a result of this sweep (header mismatch).";
+            std::cerr << " @crlSweep::run()" << std::endl;
+            return false;
+        }
+        kept = line + "\n";
+        has_header = true;
+        const int col_num = 2 + ac::SWEEP_PARAM_NUM + (int) m_metric_name.size();
+        while (std::getline(is, line)) {
+            std::istringstream ls(line);
+            std::string tok;
+            int col = 0;
+            long p = -1;
+            while (std::getline(ls, tok, '\t')) {
+                if (col == 0) p = strtol(tok.c_str(), nullptr, 10);
+                col++;
+            }
+            if (col != col_num || p < 0) continue;
+            if (p >= (long) done.size()) { // 点の数が減った
+                m_stale_num++;
+                continue;
+            }
+            if (done[p]) continue;
+            ac::agent_physical_t ap;
+            get_point(p, ap);
+            const std::string key = record(p, ap, std::vector<double>()); // 番号・シード・パラメータの列
+            if (line != key && line.compare(0, key.size() + 1, key + "\t") != 0) {
+                m_stale_num++;
+                continue;
+            }
+            done[p] = 1;
+            m_done_num++;
+            kept += line + "\n";
+        }
+        if (m_stale_num > 0) {
+            std::cerr << "#warning: " << m_stale_num << " recorded points of [" << file << "] do not match";
+            std::cerr << " the current sweep and will be run again. @crlSweep::run()" << std::endl;
+        }
+        // 一時ファイルに書いてから置き換える（書き直しの途中で終了しても元のファイルが残る）
+        const std::string tmp = file + ".tmp";
+        {
+            std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+            ofs << kept;
+            ofs.flush();
+            if (!ofs) {
+                std::cerr << "#error: couldn't write [" << tmp << "] @crlSweep::run()" << std::endl;
+                return false;
+            }
+        }
+#ifdef _WIN32
+        std::remove(file.c_str()); // rename() は既存のファイルを置き換えない
+#endif
+        if (std::rename(tmp.c_str(), file.c_str()) != 0) {
+            std::cerr << "#error: couldn't replace [" << file << "] by [" << tmp << "] @crlSweep::run()" << std::endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif // CRL_SWEEP_HPP
@@ -0,0 +1,284 @@
+/***************************************************************************
+ * crlThreadPool.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * ワークスティーリングによるスレッドプール（エージェントごとの処理の並列化）
+ *   crlThreadPool pool;
+ *   pool.init(0);                                   // スレッド数（0: コア数）
+ *   pool.parallel_for(0, num, [&](long b, long e, int w) {
+ *       for (long i = b; i < e; i++) ...;           // w: ワーカー番号 (0 ~ size() - 1)
+ *   });
+ * 範囲をワーカー数に等分して各ワーカーに割り当て，各ワーカーは自分の範囲の先頭から
+ * 残りの 1/4（min_chunk 以上）ずつ取り出して処理する（処理が進むほどチャンクが小さくなる）。
+ * 自分の範囲が空になったワーカーは，他のワーカーの範囲の後半を奪う（work stealing）。
+ * エージェントごとの処理時間が不均一でも全ワーカーがほぼ同時に終わる。
+ * 呼び出したスレッドもワーカー 0 として処理に加わる。parallel_for() の中から呼ぶと逐次実行になる。
+ * crlWorkerLocal<T> はワーカーごとの作業領域（キャッシュラインを共有しない）。
+ * set_affinity(cpu) でワーカー w を CPU cpu[w % cpu.size()] に固定する（w = 0 は呼び出し側が固定する）。
+ * parallel_for_static() は等分した範囲を奪わずに各ワーカーが処理する（NUMA のファーストタッチ用）。
+ * set_hook(h) で各ワーカー (w >= 1) が並列区間の処理の前後に h(w, true), h(w, false) を呼ぶ（区間計測用）。
+ *****************************************************************************/
+
+#ifndef CRL_THREAD_POOL_HPP
+#define CRL_THREAD_POOL_HPP
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include "crlAffinity.hpp"
+
+#define THREAD_POOL_MAX 256
+
+// ワーカーごとの作業領域
+template<class T>
+class crlWorkerLocal {
+    struct alignas(64) slot_t {
+        T value;
+    };
+    std::vector<slot_t> m_slot;
+
+public:
+    crlWorkerLocal() {}
+
+    explicit crlWorkerLocal(int worker_num) { m_slot.resize(worker_num); }
+
+    void resize(int worker_num) { m_slot.resize(worker_num); }
+
+    int size() const { return (int) m_slot.size(); }
+
+    T &operator[](int w) { return m_slot[w].value; }
+
+    const T &operator[](int w) const { return m_slot[w].value; }
+};
+
+class crlThreadPool {
+    struct alignas(64) range_t {
+        std::mutex mtx;
+        long lo, hi; // 未処理の範囲 [lo, hi)
+    };
+
+    int m_worker_num; // 呼び出し側を含むワーカー数
+    std::vector<std::thread> m_thread;
+    std::unique_ptr<range_t[]> m_range;
+    std::mutex m_mtx, m_run_mtx;
+    std::condition_variable m_cv_start, m_cv_done;
+    long m_gen; // parallel_for() の呼び出し回数
+    int m_busy; // 処理中のワーカー数（呼び出し側を除く）
+    bool m_quit;
+    std::function<void(long, long, int)> m_job;
+    long m_min_chunk;
+    bool m_steal; // false: 等分した範囲のみを処理する (parallel_for_static)
+    std::vector<int> m_cpu; // ワーカー w を固定する CPU は m_cpu[w % m_cpu.size()]
+    std::atomic<long> m_steal_num; // 奪った回数（統計）
+    std::function<void(int, bool)> m_hook; // ワーカーの処理の前後に呼ぶ（空なら呼ばない）
+
+    static int &worker_id_() {
+        thread_local int id = -1;
+        return id;
+    }
+
+public:
+    crlThreadPool() {
+        m_worker_num = 1;
+        m_gen = 0;
+        m_busy = 0;
+        m_quit = false;
+        m_min_chunk = 1;
+        m_steal = true;
+        m_steal_num = 0;
+        m_range.reset(new range_t[1]);
+        m_range[0].lo = m_range[0].hi = 0;
+    }
+
+    ~crlThreadPool() { stop(); }
+
+    // worker_num 個のワーカーを用意する（0 ならコア数，1 なら呼び出したスレッドのみ）
+    bool init(int worker_num) {
+        if (worker_num == 0) worker_num = (int) std::thread::hardware_concurrency();
+        if (worker_num < 1) worker_num = 1;
+        if (worker_num > THREAD_POOL_MAX) {
+            std::cerr << "#error: worker_num: " << worker_num << " is out of [1, " << THREAD_POOL_MAX << "]";
+            std::cerr << " @crlThreadPool::init()" << std::endl;
+            return false;
+        }
+        stop();
+        m_worker_num = worker_num;
+        m_range.reset(new range_t[worker_num]);
+        for (int w = 0; w < worker_num; w++)
+            m_range[w].lo = m_range[w].hi = 0;
+        m_quit = false;
+        for (int w = 1; w < worker_num; w++) {
+            m_thread.emplace_back(&crlThreadPool::worker_main, this, w, m_gen);
+            pin(m_thread.back().native_handle(), w);
+        }
+        return true;
+    }
+
+    // ワーカーを終了する
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(m_mtx);
+            m_quit = true;
+        }
+        m_cv_start.notify_all();
+        for (auto &t : m_thread)
+            t.join();
+        m_thread.clear();
+        m_worker_num = 1;
+    }
+
+    int size() const { return m_worker_num; }
+
+    long get_steal_num() const { return m_steal_num; }
+
+    // ワーカー w (>= 1) を CPU cpu[w % cpu.size()] に固定する（空なら固定しない）
+    bool set_affinity(const std::vector<int> &cpu) {
+        m_cpu = cpu;
+        bool ok = true;
+        for (int w = 1; w < m_worker_num; w++)
+            ok = pin(m_thread[w - 1].native_handle(), w) && ok;
+        return ok;
+    }
+
+    // ワーカー w を固定する CPU（固定しないなら -1）
+    int get_cpu(int w) const { return m_cpu.empty() ? -1 : m_cpu[w % m_cpu.size()]; }
+
+    // ワーカー w (>= 1) が並列区間の処理の前に hook(w, true)，後に hook(w, false) を呼ぶ
+    //   （呼び出し側のワーカー 0 では呼ばない。parallel_for() の外で設定する）
+    void set_hook(std::function<void(int, bool)> hook) {
+        std::lock_guard<std::mutex> lk(m_mtx);
+        m_hook = hook;
+    }
+
+    // 現在のスレッドのワーカー番号（parallel_for() の外では -1）
+    static int worker_id() { return worker_id_(); }
+
+    // [begin, end) を分割して f(b, e, worker) を並列に呼ぶ（全て終わるまで戻らない）
+    template<class F>
+    void parallel_for(long begin, long end, F f, long min_chunk = 1) {
+        run(begin, end, f, min_chunk, true);
+    }
+
+    // [begin, end) をワーカー数に等分し，ワーカー w が w 番目の範囲 [b, e) で f(b, e, w) を1回呼ぶ
+    //   （範囲が空なら呼ばない。奪わないので，範囲とワーカーの対応は同じ大きさの parallel_for() の初期の割り当てと一致する）
+    template<class F>
+    void parallel_for_static(long begin, long end, F f) {
+        run(begin, end, f, end - begin, false);
+    }
+
+private:
+
+    template<class F>
+    void run(long begin, long end, F f, long min_chunk, bool steal) {
+        if (end <= begin) return;
+        if (min_chunk < 1) min_chunk = 1;
+        const int self = worker_id_();
+        if (m_worker_num == 1 || self >= 0 || (steal && end - begin <= min_chunk)) {
+            f(begin, end, self >= 0 ? self : 0); // 入れ子・小さな範囲は逐次実行
+            return;
+        }
+        std::lock_guard<std::mutex> lk_run(m_run_mtx);
+        const long n = end - begin;
+        for (int w = 0; w < m_worker_num; w++) {
+            std::lock_guard<std::mutex> lk(m_range[w].mtx);
+            m_range[w].lo = begin + n * w / m_worker_num;
+            m_range[w].hi = begin + n * (w + 1) / m_worker_num;
+        }
+        {
+            std::lock_guard<std::mutex> lk(m_mtx);
+            m_job = f;
+            m_min_chunk = min_chunk;
+            m_steal = steal;
+            m_busy = m_worker_num - 1;
+            m_gen++;
+        }
+        m_cv_start.notify_all();
+        worker_id_() = 0;
+        work(0);
+        worker_id_() = -1;
+        std::unique_lock<std::mutex> lk(m_mtx);
+        m_cv_done.wait(lk, [this]() { return m_busy == 0; });
+        m_job = nullptr;
+    }
+
+    bool pin(std::thread::native_handle_type th, int w) {
+        if (m_cpu.empty()) return true;
+        return agentcore::set_affinity(th, std::vector<int>(1, get_cpu(w)));
+    }
+
+    // gen: 起動時の m_gen（これより後の parallel_for() を処理する）
+    void worker_main(int w, long gen) {
+        worker_id_() = w;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lk(m_mtx);
+                m_cv_start.wait(lk, [&]() { return m_quit || m_gen != gen; });
+                if (m_quit) return;
+                gen = m_gen;
+            }
+            if (m_hook) m_hook(w, true);
+            work(w);
+            if (m_hook) m_hook(w, false);
+            {
+                std::lock_guard<std::mutex> lk(m_mtx);
+                m_busy--;
+            }
+            m_cv_done.notify_one();
+        }
+    }
+
+    // 自分の範囲を処理し，空になったら他のワーカーから奪う
+    void work(int w) {
+        while (true) {
+            long b, e;
+            while (take(w, b, e))
+                m_job(b, e, w);
+            if (!m_steal || !steal(w)) return;
+        }
+    }
+
+    // 自分の範囲の先頭から残りの 1/4（min_chunk 以上）を取り出す
+    bool take(int w, long &b, long &e) {
+        std::lock_guard<std::mutex> lk(m_range[w].mtx);
+        const long n = m_range[w].hi - m_range[w].lo;
+        if (n <= 0) return false;
+        long c = n / 4;
+        if (c < m_min_chunk) c = m_min_chunk;
+        if (c > n) c = n;
+        b = m_range[w].lo;
+        e = b + c;
+        m_range[w].lo = e;
+        return true;
+    }
+
+    // 他のワーカーの範囲の後半を自分の範囲に移す（奪えなければ false）
+    bool steal(int w) {
+        for (int k = 1; k < m_worker_num; k++) {
+            const int v = (w + k) % m_worker_num;
+            long lo, hi;
+            {
+                std::lock_guard<std::mutex> lk(m_range[v].mtx);
+                const long n = m_range[v].hi - m_range[v].lo;
+                if (n <= 0) continue;
+                hi = m_range[v].hi;
+                lo = (n < 2 * m_min_chunk) ? m_range[v].lo : m_range[v].hi - n / 2;
+                m_range[v].hi = lo;
+            }
+            std::lock_guard<std::mutex> lk(m_range[w].mtx);
+            m_range[w].lo = lo;
+            m_range[w].hi = hi;
+            m_steal_num++;
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif // CRL_THREAD_POOL_HPP
@@ -29,6 +29,13 @@
 //	 js.init();
 //	 u = js.get_axis(0); // 0: x軸, 1: y軸, 2: 回転軸，3: スライダ
 //
+//	入力スレッド（Linux のみ）
+//	 js.init();
+//	 js.start();            // /dev/input/js* を poll() で待ち，届いたイベントを全て読み切る
+//	 js.get(axis, button);  // 最新の状態（ロックなしのスナップショット）
+//	 js.consume(axis, button, tick_ns); // ステップで使うとき: 入力からステップまでの遅れを記録
+//	 js.stop();
+//	start() 後は get(), get_axis(), get_button() も最新の状態を返す（デバイスは読まない）。
 //
 //	=========================================================================
 
@@ -37,6 +44,11 @@
 
 #include <iostream>
 #include <stdio.h>
+#include <vector>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <stdint.h>
 
 #ifdef UNIX
 #ifndef APPLE // LINUX_NATIVE
@@ -44,6 +56,9 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/joystick.h>
+#include <poll.h>
+#include <errno.h>
+#include <time.h>
 #endif
 #endif
 
@@ -63,6 +78,7 @@
 #define CRL_JS_AXIS_NUM 4
 #define CRL_JS_BUTTON_NUM 8
 #define JS2_EPS 0.01
+#define JS_POLL_TIMEOUT_MS 100 // 入力スレッドが停止要求を確認する間隔 [ms]
 
 class crlJoystick {
 private:
@@ -75,6 +91,20 @@ private:
 #endif
 #endif
 
+    //	入力スレッドが書き込む最新の状態（シーケンスロック: 書き込み中は m_seq が奇数）
+    std::atomic<unsigned int> m_seq;
+    std::atomic<double> m_axis_s[CRL_JS_AXIS_NUM];
+    std::atomic<bool> m_button_s[CRL_JS_BUTTON_NUM];
+    std::atomic<int64_t> m_event_ns;	//	最新のイベントを読んだ時刻 [ns] (CLOCK_MONOTONIC)
+    std::atomic<long> m_event_num;	//	読んだイベントの数
+    std::thread m_th;
+    std::atomic<bool> m_run;
+
+    //	consume() の呼び出し側（1スレッド）で記録する入力からステップまでの遅れ
+    long m_consumed_num;
+    long m_lat_num;
+    double m_lat_sum, m_lat_max;	//	[sec]
+
 #ifdef WIN32
     JOYINFOEX joyinfo;
     UINT wNumDevs, wDeviceID;
@@ -94,11 +124,18 @@ private:
     bool active_flg;
 
 public:
-    crlJoystick() {
+    crlJoystick() : m_seq(0), m_event_ns(0), m_event_num(0), m_run(false) {
         active_flg = false;
+        for (int i = 0; i < CRL_JS_AXIS_NUM; i++) m_axis_s[i] = 0.0;
+        for (int i = 0; i < CRL_JS_BUTTON_NUM; i++) m_button_s[i] = false;
+        m_consumed_num = 0;
+        m_lat_num = 0;
+        m_lat_sum = m_lat_max = 0.0;
     };
 
-    ~crlJoystick() {};
+    ~crlJoystick() {
+        stop();
+    };
 
     //	JOYSTICK の初期化(成功すれば init_flg = true)
     bool init(const char *joydev_name = JOY_DEV) {
@@ -205,10 +242,87 @@ public:
             std::cerr << "#error: joystick is not active! @crlJoystick::get()" << std::endl;
             return false;
         }
+        if (is_running()) {
+            _load_state(axis, button);
+            return true;
+        }
         _get_js_data(axis, button);
         return true;
     };
 
+    //	入力スレッドを開始（Linux のみ。init() の後に呼ぶ）
+    bool start() {
+        if (!active_flg) {
+            std::cerr << "#error: joystick is not active! @crlJoystick::start()" << std::endl;
+            return false;
+        }
+        if (is_running()) return true;
+#if defined(UNIX) && !defined(APPLE)
+        stop(); // 切断で終わったスレッドを回収
+        m_run = true;
+        m_th = std::thread(&crlJoystick::_input_thread, this);
+        return true;
+#else
+        std::cerr << "#warning: input thread is not supported on this platform. @crlJoystick::start()" << std::endl;
+        return false;
+#endif
+    }
+
+    //	入力スレッドを停止
+    void stop() {
+        if (!m_th.joinable()) return;
+        m_run = false;
+        m_th.join();
+    }
+
+    bool is_running() const {
+        return m_run.load(std::memory_order_relaxed);
+    }
+
+    //	最新の状態を読み，前回の consume() 以降に届いたイベントがあれば
+    //	最新のイベントから now_ns [ns] (CLOCK_MONOTONIC) までの遅れを記録する（1つのスレッドから呼ぶ）
+    //	新しいイベントがあれば true を返す
+    bool consume(double *axis, bool *button, int64_t now_ns) {
+        int64_t event_ns;
+        long event_num;
+        _load_state(axis, button, &event_ns, &event_num);
+        if (event_num == m_consumed_num) return false;
+        m_consumed_num = event_num;
+        const double lat = (now_ns > event_ns ? now_ns - event_ns : 0) * 1.0e-9;
+        m_lat_sum += lat;
+        if (lat > m_lat_max) m_lat_max = lat;
+        m_lat_num++;
+        return true;
+    }
+
+    //	最新のイベントを読んだ時刻 [ns] (CLOCK_MONOTONIC, 0: まだない)
+    int64_t get_event_ns() const {
+        return m_event_ns.load(std::memory_order_acquire);
+    }
+
+    //	入力スレッドが読んだイベントの数
+    long get_event_num() const {
+        return m_event_num.load(std::memory_order_acquire);
+    }
+
+    //	入力からステップまでの遅れ（平均・最大）[sec]
+    double get_latency_mean() const {
+        return m_lat_num > 0 ? m_lat_sum / m_lat_num : 0.0;
+    }
+
+    double get_latency_max() const {
+        return m_lat_max;
+    }
+
+    long get_latency_num() const {
+        return m_lat_num;
+    }
+
+    void print_latency(std::ostream &os = std::cout) const {
+        os << "joystick: events " << get_event_num() << ", consumed " << m_lat_num;
+        os << ", latency [ms] avg " << get_latency_mean() * 1000.0 << ", max " << m_lat_max * 1000.0 << std::endl;
+    }
+
     //	id番目のAXISを返す
     bool get_axis(const int dim, std::vector<double> &axisv) const{
         axisv.resize(dim);
@@ -219,7 +333,7 @@ public:
         }
         double axis[CRL_JS_AXIS_NUM];
         bool button[CRL_JS_BUTTON_NUM];
-        _get_js_data(axis, button);
+        get(axis, button);
         for(int i=0; i<dim; i++) {
             axisv[i] = axis[i];
         }
@@ -240,7 +354,7 @@ public:
         }
         double axis[CRL_JS_AXIS_NUM];
         bool button[CRL_JS_BUTTON_NUM];
-        _get_js_data(axis, button);
+        get(axis, button);
         //std::cout << "#debug: m_axis: " << m_axis[0] << ", " << m_axis[1] << std::endl;
         return axis[id];
     }
@@ -262,7 +376,7 @@ public:
         }
         double axis[CRL_JS_AXIS_NUM];
         bool button[CRL_JS_BUTTON_NUM];
-        _get_js_data(axis, button);
+        get(axis, button);
         return button[id];
     };
 
@@ -363,6 +477,99 @@ private:
         return -1;
     }
 #endif
+    //	最新の状態をスナップショットとして読む（書き込み中なら読み直す）
+    void _load_state(double *axis, bool *button, int64_t *event_ns = nullptr, long *event_num = nullptr) const {
+        unsigned int s0, s1;
+        int64_t t;
+        long n;
+        do {
+            s0 = m_seq.load(std::memory_order_acquire);
+            for (int i = 0; i < CRL_JS_AXIS_NUM; i++) axis[i] = m_axis_s[i].load(std::memory_order_relaxed);
+            for (int i = 0; i < CRL_JS_BUTTON_NUM; i++) button[i] = m_button_s[i].load(std::memory_order_relaxed);
+            t = m_event_ns.load(std::memory_order_relaxed);
+            n = m_event_num.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s1 = m_seq.load(std::memory_order_relaxed);
+        } while ((s0 & 1) != 0 || s0 != s1);
+        _normalize(axis);
+        if (event_ns != nullptr) *event_ns = t;
+        if (event_num != nullptr) *event_num = n;
+    }
+
+    //	不感帯・飽和・y軸の向き
+    static void _normalize(double *axis) {
+        for (int i = 0; i < CRL_JS_AXIS_NUM; i++) {
+            if (fabs(axis[i]) < JS2_EPS) axis[i] = 0.;
+            if (axis[i] > 1.0) axis[i] = 1.0;
+            if (axis[i] < -1.0) axis[i] = -1.0;
+        }
+        axis[1] = -axis[1];
+    }
+
+#if defined(UNIX) && !defined(APPLE)
+    //	イベント1つを axis, button に反映
+    static void _apply_event(const js_event &js_ev, double *axis, bool *button) {
+        switch (js_ev.type & ~JS_EVENT_INIT)
+        {
+            case JS_EVENT_AXIS:
+                if(js_ev.number == 0)
+                    axis[ 1 ] = -js_ev.value / 32767.0;
+                else if(js_ev.number == 1)
+                    axis[ 0 ] = -js_ev.value / 32767.0;
+                else if (js_ev.number < CRL_JS_AXIS_NUM)
+                    axis[ js_ev.number ] = js_ev.value / 32767.0;
+                break;
+            case JS_EVENT_BUTTON:
+                if(js_ev.number < CRL_JS_BUTTON_NUM)
+                    button[ js_ev.number ] = js_ev.value;
+                break;
+        }
+    }
+
+    static int64_t _now_ns() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+    //	入力スレッド: イベントが届くまで poll() で待ち，キューに溜まったイベントを全て読んでから1回だけ公開する
+    void _input_thread() {
+        double axis[CRL_JS_AXIS_NUM] = {};
+        bool button[CRL_JS_BUTTON_NUM] = {};
+        js_event ev[64];
+        pollfd pfd;
+        pfd.fd = m_joy_fd;
+        pfd.events = POLLIN;
+        while (m_run.load(std::memory_order_relaxed)) {
+            const int r = poll(&pfd, 1, JS_POLL_TIMEOUT_MS);
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+                std::cerr << "#error: joystick is disconnected. @crlJoystick::_input_thread()" << std::endl;
+                break;
+            }
+            if (r == 0) continue;
+            long n = 0;
+            ssize_t len;
+            while ((len = read(m_joy_fd, ev, sizeof(ev))) > 0) {
+                for (int k = 0; k < (int) (len / sizeof(js_event)); k++)
+                    _apply_event(ev[k], axis, button);
+                n += len / sizeof(js_event);
+            }
+            if (n == 0) continue;
+            const int64_t t = _now_ns();
+            const unsigned int s = m_seq.load(std::memory_order_relaxed);
+            m_seq.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (int i = 0; i < CRL_JS_AXIS_NUM; i++) m_axis_s[i].store(axis[i], std::memory_order_relaxed);
+            for (int i = 0; i < CRL_JS_BUTTON_NUM; i++) m_button_s[i].store(button[i], std::memory_order_relaxed);
+            m_event_ns.store(t, std::memory_order_relaxed);
+            m_event_num.store(m_event_num.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            m_seq.store(s + 2, std::memory_order_release);
+        }
+        m_run = false;
+    }
+#endif
+
     bool _get_js_data(double *axis, bool *button) const{
 
         if(active_flg == false) {
@@ -1,93 +1,681 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <cstring>
+#include <cstdlib>
 #include "crlAgent.hpp"
 #include "crlAgentGLFW.hpp"
+#if defined(__linux__) && !defined(UNIX)
+#define UNIX // crljoystick.hpp の Linux 版（/dev/input/js*）を使う
+#endif
 #include "crljoystick.hpp"
+#include "crlGolden.hpp"
+#include "crlPerfCounter.hpp"
+#include "crlPipeline.hpp"
+#include "crlAffinity.hpp"
+#include "crlEnsemble.hpp"
+#include "crlSweep.hpp"
+#include "crlDomain.hpp"
+#include "crlForce.hpp"
+#include "crlBehavior.hpp"
+#include "crlPacer.hpp"
+#include "crlInputLog.hpp"
+#include "crlThreadPool.hpp"
+#include "crlAgentArray.hpp"
+#include "crlCollision.hpp"
+#include "crlPerception.hpp"
 #include <thread>
+#include <chrono>
+#include <atomic>
+#include <ctime>
+#ifdef __linux__
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 crlAgentGLFW g_wnd; // GLFW ウィンドウ用クラス
+crlJoystick g_js; // ジョイスティック（環境変数 CRL_JOYSTICK にデバイスを指定したときのみ入力スレッドで読む）
 #define SAMPLING_TIME 0.033 // サンプリング時間 [sec]
 #define FIELD_MAX 100.0 // フィールドの大きさ
 #define AGENT_NUM 12
+#define GOLDEN_TICKS 300 // ゴールデン軌道の記録ステップ数
+#define GOLDEN_SEED 1 // ゴールデン軌道の乱数シード
+#define BENCH_TICKS 300 // ベンチマークのステップ数
+#define ENSEMBLE_WORLDS 64 // アンサンブルの世界の数
+#define PIPELINE_DEPTH 2 // 描画・出力を先行して溜められるステップ数（0: 逐次実行）
+#define PACE_POLICY PACE_CATCH_UP // 締め切りに遅れたとき（PACE_CATCH_UP: 取り戻す, PACE_SKIP: 飛ばす）
+#define PACE_REPORT_TICKS 300 // ペース配分の統計を出力する間隔（0: 出力しない）
+#define DOMAIN_HALO 5.0 // 領域分割のハロー幅（= 相互作用の距離）
+#define OPE_GAIN 5.0 // 操作者の入力（マウス・ジョイスティック）から agent[0] への入力のゲイン
 
-// メインループ（この関数内のwhile内を繰り返し実行）
-void main_loop(int speedx) {
+ac::input_frame_t g_input; // 操作者の入力（main_loop: マウス・ジョイスティック, --replay: 記録した入力）
+bool g_input_on = false; // true なら agent[0] を操作者の入力で動かす（--record, CRL_JOYSTICK, --replay）
+crlThreadPool g_pool; // step_agents() の知覚・入力・駆動（各モードの開始時に init_pool() で初期化。parallel_for() の中からは逐次実行）
 
-    const int agent_num = AGENT_NUM; // エージェントの数
-    const double field_max = FIELD_MAX; //(xの範囲: -field_max ~ field_max，yの範囲: -field_max ~ field_max)
+// 区間計測（--bench のときのみ有効）
+crlPerfProfiler g_prof;
+const int PH_TICK = g_prof.add_phase("tick");
+const int PH_SENSE = g_prof.add_phase("sense");
+const int PH_CONTROL = g_prof.add_phase("control");
+const int PH_DRIVE = g_prof.add_phase("drive");
+std::atomic<int> g_pool_phase(-1); // g_pool のワーカー (w >= 1) の処理を積算する区間（-1: 積算しない）
 
-    // agent_num 台のエージェントを定義
-    // agent[0]: ID 0 のエージェント
-    // agent[0].get_pos(): ID 0 のエージェントの位置を取得
-    // agent[0].get_dist(agent[1]): ID 0 のエージェントと ID 1 のエージェントの距離を取得
-    // agent[0].get_vect(agent[1]): ID 0 のエージェントから ID 1 のエージェントへのベクトルを取得
-    // agent[0].drive(u, agent, SAMPLING_TIME): ID 0 のエージェントに入力 u を与えて駆動
-    //          ※ agent は他のエージェントを含めた配列（衝突判定のため）
-    std::vector<crlAgent> agent(agent_num);
+// 区間 ph を呼び出したスレッドで計測し，その間の g_pool のワーカーの処理もワーカーごとに ph へ積算する
+//   （g_pool のワーカーの中で呼ばれた場合は入れ子の並列区間が逐次実行になるので，呼び出したスレッドのみ）
+void begin_phase(int ph) {
+    g_prof.begin(ph);
+    if (crlThreadPool::worker_id() < 0) g_pool_phase = ph;
+}
+
+void end_phase(int ph) {
+    if (crlThreadPool::worker_id() < 0) g_pool_phase = -1;
+    g_prof.end(ph);
+}
+
+// agent_num 台のエージェントを定義
+// agent[0]: ID 0 のエージェント
+// agent[0].get_pos(): ID 0 のエージェントの位置を取得
+// agent[0].get_dist(agent[1]): ID 0 のエージェントと ID 1 のエージェントの距離を取得
+// agent[0].get_vect(agent[1]): ID 0 のエージェントから ID 1 のエージェントへのベクトルを取得
+// agent[0].drive(u, agent, SAMPLING_TIME): ID 0 のエージェントに入力 u を与えて駆動
+//          ※ agent は他のエージェントを含めた配列（衝突判定のため）
 
-    // エージェントの初期化
-    for (int i = 0; i < agent_num; i++) {
+// 環境変数 name に書かれた CPU 番号の並び（例: CRL_CPU_SIM=2, CRL_CPU_IO=4-5。未設定なら固定しない）
+//   CRL_CPU_SIM: シミュレーション, CRL_CPU_RENDER: 描画 (GLFW), CRL_CPU_IO: 描画・出力のパイプライン
+std::vector<int> cpu_list(const char *name) {
+    std::vector<int> cpu;
+    ac::parse_cpu_list(getenv(name), cpu);
+    return cpu;
+}
+
+// g_pool を初期化し，CRL_CPU_SIM の CPU に固定する（未設定ならコア数のワーカーを固定しない）
+//   ワーカー w (>= 1) は cpu[w % cpu.size()]，呼び出したスレッド（ワーカー 0）は cpu[0]
+bool init_pool() {
+    const std::vector<int> cpu = cpu_list("CRL_CPU_SIM");
+    if (!g_pool.init((int) cpu.size())) return false;
+    g_pool.set_hook([](int, bool enter) {
+        const int ph = g_pool_phase;
+        if (enter) g_prof.begin(ph);
+        else g_prof.end(ph);
+    });
+    if (!cpu.empty()) ac::set_affinity_self(std::vector<int>(1, cpu[0]));
+    return g_pool.set_affinity(cpu);
+}
+
+// エージェントの初期化
+void init_agents(std::vector<crlAgent> &agent) {
+    const double field_max = FIELD_MAX; //(xの範囲: -field_max ~ field_max，yの範囲: -field_max ~ field_max)
+    for (int i = 0; i < (int) agent.size(); i++) {
         // エージェントの初期化
         agent[i].init(i, 0, field_max);
         // 初期位置をランダムに設定 (範囲: -field_max ~ field_max の75%)
         agent[i].set_pos_random(field_max * 0.75);
     }
+}
 
-    std::vector<double> u(2); // エージェントへの入力司令ベクトル 2次元 u[0], u[1]
-    double sec = 0.0; // 現在時刻
-    int nearest_agent_id = 0; // 最も近くのエージェント番号
+// 1ステップ分のエージェントの動作（ここを主に編集）
+//   全エージェントの入力をステップ開始時の状態から g_pool で並列に計算し，SoA の配列 (crlAgentArray) でまとめて駆動する
+//   （乱数は (シード, 時刻, エージェント) で決まる乱数列を使うので，スレッド数によらず同じ軌道になる）
+void step_agents(std::vector<crlAgent> &agent, double sec) {
 
-    // メインループ ここを主に編集
-    while (true) {
-        for (int i = 0; i < agent_num; i++) {
-            // 一番近くのエージェント ID を取得 (int nearest_agent_id に代入)
-            nearest_agent_id = agent[i].get_nearest_agent_id(agent);
-
-            if (i < 5) {
-                // エージェントのランダムウォーク入力を獲得 (u[0] = -5〜5, u[1] = -5〜5)
-                u = agent[i].get_random_walk(5.0);
-                // エージェントの駆動(入力は u[0], u[1])
-                agent[i].drive(u, agent, SAMPLING_TIME);
-                // 描画用にエージェントをセット [編集不要]
-                g_wnd.set_obj(i, agent[i].get_pos(), _blue(), agent[i].get_radius(), false);
+    // 作業領域（--ensemble では世界を受け持つスレッドごと。毎ステップ取り込む）
+    //   thread_local の変数はラムダ式の中ではワーカーのスレッドの別の変数を指すので，参照を介して使う
+    static thread_local crlAgentArray t_world; // 駆動用
+    static thread_local crlCollision t_col; // 連続衝突判定
+    static thread_local crlPerception t_per; // 視野内の近傍
+    crlAgentArray &world = t_world;
+    crlCollision &col = t_col;
+    crlPerception &per = t_per;
+    const int num = (int) agent.size();
+    std::vector<int> nearest_agent_id(num); // 最も近くのエージェント番号
+    std::vector<double> nearest_vect(2 * num); // 最も近くのエージェントへの相対位置
+    const uint64_t seed = g_get_seed(); // 呼び出したスレッドのシード（ワーカーのスレッドでは異なる）
+    const uint64_t tick = (uint64_t) llround(sec / SAMPLING_TIME);
+    const int prev_num = world.size();
+    if (!world.gather(agent)) return;
+    if (world.size() != prev_num) world.place(g_pool); // 確保し直した配列を受け持ちのワーカーのノードに置く
+
+    // 一番近くのエージェント ID とそこへの相対位置を取得 (nearest_agent_id[i], nearest_vect[2i], nearest_vect[2i + 1])
+    //   視野内の近傍を格子で求め（crlPerception, 相対位置は観測値），視野内に誰もいなければ格子を広げて探す
+    begin_phase(PH_SENSE);
+    per.set_seed(seed); // SIGHT_SIGMA > 0 の観測ノイズは (シード, 時刻, 観測者) の乱数列
+    per.update(world, (long) tick, g_pool);
+    g_pool.parallel_for(0, num, [&](long b, long e, int) {
+        for (long i = b; i < e; i++)
+            nearest_agent_id[i] = per.nearest(world, (int) i, &nearest_vect[2 * i]);
+    }, 64);
+    end_phase(PH_SENSE);
+
+    // エージェント i への入力司令ベクトルを world.u(0)[i], world.u(1)[i] に書き込む
+    begin_phase(PH_CONTROL);
+    g_pool.parallel_for(0, num, [&](long b, long e, int) {
+        std::vector<double> u(2); // エージェントへの入力司令ベクトル 2次元 u[0], u[1]
+        for (long i = b; i < e; i++) {
+            if (i == 0 && g_input_on) {
+                // 操作者の入力（マウスのドラッグ + ジョイスティックの x, y 軸）
+                u[0] = OPE_GAIN * (g_input.MV[0] + g_input.AXIS[0]);
+                u[1] = OPE_GAIN * (g_input.MV[1] + g_input.AXIS[1]);
+            } else if (i < 5) {
+                // エージェントのランダムウォーク入力 (u[0] = -5〜5, u[1] = -5〜5)
+                for (int d = 0; d < 2; d++)
+                    u[d] = 5.0 * (2.0 * ((ac::stream_key(seed, tick, i * U_SIZE + d) >> 11) * 0x1.0p-53) - 1.0);
             } else if (i < 8) {
                 // エージェントの入力
                 u[0] = sin(sec);
                 u[1] = cos(sec);
-                // エージェントの駆動(入力は u[0], u[1])
-                agent[i].drive(u, agent, SAMPLING_TIME);
-                // 描画用にエージェントをセット [編集不要]
-                g_wnd.set_obj(i, agent[i].get_pos(), _red(), agent[i].get_radius(), true);
-            } else {
-                // nearest_agent_id 方向へのベクトルを取得 u に代入
-                u = agent[i].get_vect(agent[nearest_agent_id]);
+            } else if (nearest_agent_id[i] >= 0) {
+                // nearest_agent_id 方向へのベクトルを u に代入
+                u[0] = nearest_vect[2 * i];
+                u[1] = nearest_vect[2 * i + 1];
                 // u を正規化 （大きさを1に）
                 normalize(u);
-                // エージェントの駆動(入力は u[0], u[1])
-                agent[i].drive(u, agent, SAMPLING_TIME);
-                // 描画用にエージェントをセット [編集不要]
-                g_wnd.set_obj(i, agent[i].get_pos(), _green(), agent[i].get_radius(), true);
+            } else {
+                u[0] = u[1] = 0.0; // 他にエージェントがいない
             }
+            world.u(0)[i] = u[0];
+            world.u(1)[i] = u[1];
+        }
+    }, 64);
+    end_phase(PH_CONTROL);
+
+    // エージェントの駆動（crlAgent::drive() の積分と同じ計算を SIMD でまとめて行う）
+    //   接触はステップ中の移動経路から crlCollision で求めて解決する（格子で候補を絞るので O(N)）
+    begin_phase(PH_DRIVE);
+    col.drive(world, SAMPLING_TIME, g_pool);
+    world.scatter(agent);
+    end_phase(PH_DRIVE);
+}
+
+// 描画・コンソール出力に渡すエージェントの状態（出力段へはこれだけを複写する）
+typedef struct {
+    double POS[2];
+    double RADIUS;
+} agent_view_t;
+
+// 出力段に渡す状態を作る（シミュレーションのスレッド）[編集不要]
+void snapshot_agents(const std::vector<crlAgent> &agent, std::vector<agent_view_t> &view) {
+    view.resize(agent.size());
+    for (int i = 0; i < (int) agent.size(); i++) {
+        const std::vector<double> &pos = agent[i].get_pos();
+        view[i].POS[0] = pos[0];
+        view[i].POS[1] = pos[1];
+        view[i].RADIUS = agent[i].get_radius();
+    }
+}
+
+// 描画用にエージェントをセットし，現在地をコンソールに出力 [編集不要]
+void publish_agents(const std::vector<agent_view_t> &view) {
+    static thread_local std::vector<double> pos(2);
+    for (int i = 0; i < (int) view.size(); i++) {
+        pos[0] = view[i].POS[0];
+        pos[1] = view[i].POS[1];
+        if (i < 5)
+            g_wnd.set_obj(i, pos, _blue(), view[i].RADIUS, false);
+        else if (i < 8)
+            g_wnd.set_obj(i, pos, _red(), view[i].RADIUS, true);
+        else
+            g_wnd.set_obj(i, pos, _green(), view[i].RADIUS, true);
+        std::cout << "Agent " << i << " Position: (" << pos[0] << ", " << pos[1] << ")" << std::endl; // crlAgent::print_position()
+    }
+    g_wnd.publish_frame(); // 描画側はこのステップと1つ前のステップの間を補間して表示する
+}
+
+// 操作者の入力（マウス・ジョイスティック）を1ステップ分の入力 f にまとめる
+void read_operator_input(ac::input_frame_t &f, const double *js_axis, const bool *js_button) {
+    g_wnd.get_mv(f.MV);
+    for (int k = 0; k < INPUT_AXIS_NUM; k++)
+        f.AXIS[k] = (k < CRL_JS_AXIS_NUM) ? js_axis[k] : 0.0;
+    f.BUTTON = 0;
+    for (int k = 0; k < CRL_JS_BUTTON_NUM && k < 32; k++)
+        if (js_button[k]) f.BUTTON |= 1u << k;
+}
+
+// メインループ（この関数内のwhile内を繰り返し実行）
+//   record_file != nullptr なら乱数のシードを固定し，操作者の入力をステップごとに記録する（--replay で再生）
+void main_loop(int speedx, const char *record_file) {
+
+    crlInputRecorder rec;
+    if (record_file != nullptr) {
+        const unsigned int seed = (unsigned int) time(nullptr);
+        g_set_seed(seed);
+        if (rec.open(record_file, seed, AGENT_NUM, SAMPLING_TIME))
+            std::cout << "record: seed " << seed << " to " << record_file << std::endl;
+    }
+    ac::init(g_input);
+    g_input_on = rec.is_open() || g_js.is_running();
+    init_pool();
+
+    std::vector<crlAgent> agent(AGENT_NUM);
+    init_agents(agent);
+
+    double sec = 0.0; // 現在時刻
+    long tick = 0;
+    crlPipeline<std::vector<agent_view_t> > out; // 描画・コンソール出力は別スレッドで行う
+    out.set_affinity(cpu_list("CRL_CPU_IO"));
+    out.start(PIPELINE_DEPTH, publish_agents);
+    crlPacer pacer; // SAMPLING_TIME / speedx ごとの締め切りで実時間に合わせる
+    pacer.init(SAMPLING_TIME, speedx, PACE_POLICY);
 
-            // エージェントの現在地をコンソールに出力
-            agent[i].print_position(i);
+    double js_axis[CRL_JS_AXIS_NUM] = {}; // ジョイスティックの入力（ステップの開始時点の最新の状態）
+    bool js_button[CRL_JS_BUTTON_NUM] = {};
+
+    while (true) {
+        if (g_js.is_running()) g_js.consume(js_axis, js_button, ac::monotonic_ns()); // 入力からステップまでの遅れを記録
+        if (g_input_on) read_operator_input(g_input, js_axis, js_button);
+        step_agents(agent, sec);
+        ac::validate_tick(agent, tick); // nan, inf を含むエージェントを報告（CRL_VALIDATION）
+        if (rec.is_open()) rec.record(tick, g_input, agent); // このステップの入力と結果のダイジェスト
+        tick++;
+        out.push_with([&agent](std::vector<agent_view_t> &view) { snapshot_agents(agent, view); }); // ステップ t の出力とステップ t + 1 の計算が重なる
+        // 次の締め切りまで待つ [描画のために必要] 数値計算のみでは不要
+        pacer.wait();
+        if (PACE_REPORT_TICKS > 0 && tick % PACE_REPORT_TICKS == 0) {
+            pacer.print(std::cerr); // 位置の出力（パイプラインのスレッド）と混ざらないように標準エラーへ
+            if (g_js.is_running()) g_js.print_latency(std::cerr);
         }
-        // sleep [描画のために必要] 数値計算のみでは不要
-        std::this_thread::sleep_for(
-                std::chrono::milliseconds((int) (SAMPLING_TIME * 1000.0 / speedx) - 12));
         // 時刻を 33ms 進める
         sec += SAMPLING_TIME; // SAMPLING_TIME: xuHuman.hpp で定義
     }
 }
 
-int main() {
+// ゴールデン軌道の記録 (check = false) / 比較 (check = true) を描画なしで実行
+int run_golden(const char *file, bool check, int ticks, unsigned int seed, double tol) {
+    crlGolden gold;
+    crlGolden ref;
+    if (check) {
+        if (!ref.load(file)) return 1;
+        ticks = ref.get_tick_num() - 1;
+        seed = ref.get_seed();
+    }
+    std::vector<crlAgent> agent;
+    if (!init_pool()) return 1; // 軌道はスレッド数によらない
+    gold.init(AGENT_NUM, seed, SAMPLING_TIME);
+    if (!gold.run(agent, init_agents, step_agents, ticks)) return 1;
+    if (!check) {
+        if (!gold.save(file)) return 1;
+        std::cout << "golden: recorded " << ticks << " ticks (seed: " << seed << ") to " << file << std::endl;
+        return 0;
+    }
+    ac::golden_tolerance_t tl;
+    ac::golden_diff_t diff;
+    ac::init(tl, tol);
+    gold.compare(ref, tl, diff);
+    crlGolden::print_diff(diff);
+    return diff.DIVERGED ? 1 : 0;
+}
+
+// 描画なしで ticks ステップ実行し，1ステップの処理時間と区間ごとの性能カウンタを出力
+int run_bench(int ticks, int agent_num) {
+    g_set_seed(GOLDEN_SEED);
+    if (!init_pool()) return 1;
+    std::vector<crlAgent> agent(agent_num);
+    init_agents(agent);
+
+    g_prof.set_active(true);
+    double sec = 0.0;
+    double t_sum = 0.0, t_min = 1.0e9, t_max = 0.0;
+    for (int t = 0; t < ticks; t++) {
+        auto t0 = std::chrono::steady_clock::now();
+        g_prof.begin(PH_TICK);
+        step_agents(agent, sec);
+        ac::validate_tick(agent, t);
+        g_prof.end(PH_TICK);
+        double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        t_sum += dt;
+        if (dt < t_min) t_min = dt;
+        if (dt > t_max) t_max = dt;
+        sec += SAMPLING_TIME;
+    }
+    g_prof.set_active(false);
+
+    std::cout << "bench: agents " << agent_num << ", ticks " << ticks << ", threads " << g_pool.size();
+    std::cout << ", tick [ms] avg " << t_sum * 1000.0 / ticks << ", min " << t_min * 1000.0;
+    std::cout << ", max " << t_max * 1000.0 << ", realtime x" << SAMPLING_TIME * ticks / t_sum << std::endl;
+    g_prof.print(ticks);
+    return 0;
+}
+
+// 記録した操作者の入力を描画なしで再生し，1ステップの処理時間と記録時との一致を出力
+//   pace = true なら記録時の経過時間に合わせてステップを実行する（false: 待たずに実行）
+int run_replay(const char *file, bool pace) {
+    crlInputReplay rp;
+    if (!rp.load(file)) return 1;
+    if (rp.get_smpl_time() != SAMPLING_TIME) {
+        std::cerr << "#warning: recorded SAMPLING_TIME: " << rp.get_smpl_time() << " != " << SAMPLING_TIME;
+        std::cerr << " @run_replay()" << std::endl;
+    }
+    g_set_seed(rp.get_seed());
+    if (!init_pool()) return 1;
+    std::vector<crlAgent> agent(rp.get_agent_num());
+    init_agents(agent);
+    g_input_on = true;
+
+    const long ticks = rp.get_tick_num();
+    const int64_t start = ac::monotonic_ns();
+    g_prof.set_active(true);
+    double sec = 0.0;
+    double t_sum = 0.0, t_max = 0.0;
+    for (long t = 0; t < ticks; t++) {
+        if (pace) ac::sleep_until_ns(start + (int64_t) (rp.get_sec(t) * 1.0e9));
+        rp.get(t, g_input);
+        auto t0 = std::chrono::steady_clock::now();
+        g_prof.begin(PH_TICK);
+        step_agents(agent, sec);
+        ac::validate_tick(agent, t);
+        g_prof.end(PH_TICK);
+        double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        t_sum += dt;
+        if (dt > t_max) t_max = dt;
+        rp.check(t, agent);
+        sec += SAMPLING_TIME;
+    }
+    g_prof.set_active(false);
+    g_input_on = false;
+
+    std::cout << "replay: agents " << rp.get_agent_num() << ", ticks " << ticks << ", seed " << rp.get_seed();
+    std::cout << ", threads " << g_pool.size();
+    if (ticks > 0) {
+        std::cout << ", tick [ms] avg " << t_sum * 1000.0 / ticks << ", max " << t_max * 1000.0;
+        std::cout << ", realtime x" << SAMPLING_TIME * ticks / t_sum;
+    }
+    std::cout << std::endl;
+    g_prof.print(ticks > 0 ? ticks : 1);
+    if (rp.get_diverged() >= 0) {
+        std::cout << "replay: diverged from the recording at tick " << rp.get_diverged() << std::endl;
+        return 1;
+    }
+    std::cout << "replay: OK" << std::endl;
+    return 0;
+}
+
+// シードを変えて worlds 回のシナリオを1つのプロセスで並列に実行し，世界ごとの結果と処理速度を出力
+int run_ensemble(int worlds, int ticks, int agent_num, unsigned int seed) {
+    crlEnsemble<crlAgent> ens;
+    if (!init_pool() || !ens.init(worlds, agent_num, seed, SAMPLING_TIME)) return 1;
+    if (!ens.run(ticks, init_agents, step_agents, g_pool)) return 1; // 分割するときは step_agents() の中で並列に実行
+
+    for (int k = 0; k < ens.size(); k++) {
+        double v_sum = 0.0; // 最終ステップの平均の速さ
+        for (const crlAgent &a : ens.world(k))
+            v_sum += sqrt(a.get_veloc()[0] * a.get_veloc()[0] + a.get_veloc()[1] * a.get_veloc()[1]);
+        std::cout << "world " << k << ": seed " << ens.get_seed(k) << ", mean speed " << v_sum / agent_num;
+        if (ens.get_diverged(k) >= 0) std::cout << ", diverged at tick " << ens.get_diverged(k);
+        std::cout << std::endl;
+    }
+    std::cout << "ensemble: worlds " << worlds << ", agents " << agent_num << ", ticks " << ticks;
+    std::cout << ", threads " << g_pool.size() << (ens.is_split(g_pool) ? " (split worlds)" : " (whole worlds)");
+    std::cout << ", wall [s] " << ens.get_wall_sec() << ", ticks/s " << ens.get_tick_rate() << std::endl;
+    return 0;
+}
+
+// 物理パラメータのスイープ（points = 0: 格子，points > 0: ランダムデザイン）
+//   1点ごとに init_agents() / step_agents() を ticks ステップ実行し，file に追記する（中断後は続きから）
+int run_sweep(const char *file, long points, int ticks) {
+    crlSweep sw;
+    // スイープする範囲（ここを編集）
+    sw.add_grid(ac::SWEEP_M, 0.5, 2.0, 4);
+    sw.add_grid(ac::SWEEP_D, 0.0, 1.0, 5);
+    sw.add_grid(ac::SWEEP_U_MAX, 2.0, 10.0, 5);
+    sw.add_grid(ac::SWEEP_RADIUS, 0.5, 2.0, 4);
+    sw.set_random(points);
+    sw.set_seed(GOLDEN_SEED);
+    sw.set_metric_names({"mean_speed", "min_dist"});
+
+    if (!init_pool()) return 1;
+    bool ok = sw.run(file, [&](long, const ac::agent_physical_t &ap, std::vector<double> &metric) {
+        std::vector<crlAgent> agent(AGENT_NUM);
+        init_agents(agent);
+        for (crlAgent &a : agent)
+            if (!a.set_physical_parameters(ap)) return false;
+        double sec = 0.0, min_dist = 1.0e9; // 全ステップでのエージェント間の最小距離
+        for (int t = 0; t < ticks; t++) {
+            step_agents(agent, sec);
+            sec += SAMPLING_TIME;
+            if (ac::validate_tick(agent, t) >= 0) return false;
+            for (int i = 0; i < (int) agent.size(); i++)
+                for (int j = i + 1; j < (int) agent.size(); j++)
+                    min_dist = std::min(min_dist, agent[i].get_dist(agent[j]));
+        }
+        double v_sum = 0.0;
+        for (const crlAgent &a : agent)
+            v_sum += sqrt(a.get_veloc()[0] * a.get_veloc()[0] + a.get_veloc()[1] * a.get_veloc()[1]);
+        metric[0] = v_sum / agent.size();
+        metric[1] = min_dist;
+        return true;
+    }, g_pool);
+    std::cout << "sweep: points " << sw.get_point_num() << ", recorded " << sw.get_done_num();
+    if (sw.get_stale_num() > 0) std::cout << " (discarded " << sw.get_stale_num() << " mismatched)";
+    std::cout << ", run " << sw.get_run_num() << ", failed " << sw.get_fail_num() << " -> " << file << std::endl;
+    return ok ? 0 : 1;
+}
+
+// コルーチンによる行動の例: 向きを変えながら巡回し，エージェント leader に近づいたら離れる
+crlBehavior patrol(crlBehaviorContext &ctx, int leader, double speed) {
+    while (true) {
+        for (int k = 0; k < 4; k++) {
+            const double th = k * M_PI / 2.0;
+            ctx.set_input(speed * cos(th), speed * sin(th));
+            co_await ctx.wait_ticks(30); // 30 ステップ同じ向きに進む
+        }
+        co_await ctx.until_near(leader, 20.0);
+        ctx.set_input(-speed, -speed);
+        co_await ctx.wait_ticks(10);
+    }
+}
+
+// 描画なしで agent_num 体の patrol() を ticks ステップ実行し，行動の再開にかかる時間を出力
+int run_behavior(int ticks, int agent_num) {
+    g_set_seed(GOLDEN_SEED);
+    std::vector<crlAgent> agent(agent_num);
+    init_agents(agent);
+    crlBehaviorScheduler<crlAgent> sched;
+    for (int i = 0; i < agent_num; i++)
+        sched.spawn(agent, i, patrol, (i + 1) % agent_num, 3.0);
+    double sec = 0.0, t_sched = 0.0;
+    long resume = 0;
+    for (int t = 0; t < ticks; t++) {
+        auto t0 = std::chrono::steady_clock::now();
+        sched.tick(agent, sec);
+        t_sched += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        resume += sched.get_resume_num();
+        for (int i = 0; i < agent_num; i++)
+            agent[i].drive(sched.get_input(i), agent, SAMPLING_TIME);
+        sec += SAMPLING_TIME;
+    }
+    std::cout << "behavior: scripts " << sched.get_script_num() << ", ticks " << ticks << ", resumed " << resume;
+    std::cout << ", scheduler [ms/tick] " << t_sched * 1000.0 / ticks;
+    std::cout << ", [ns/script] " << t_sched * 1.0e9 / ((double) ticks * agent_num) << std::endl;
+    return 0;
+}
+
+// 領域分割の rank 番目のタイルを受け持つプロセスの処理
+//   エージェント ID の一様乱数で初期位置を決め（受け持ちのタイルの位置のエージェントだけを加える），
+//   近くのエージェントからの斥力とランダムな入力で駆動する
+int domain_worker(const char *name, int rank, int ticks, int agent_num) {
+    crlDomain dom;
+    if (!dom.open(name, rank)) return 1;
+    ac::field_environment_t env;
+    ac::init(env);
+    env.X_MAX = env.Y_MAX = FIELD_MAX;
+    env.X_MIN = env.Y_MIN = -FIELD_MAX;
+    env.X_SIZE = env.Y_SIZE = 2.0 * FIELD_MAX;
+    ac::agent_physical_t phys;
+    ac::init_physical_param(phys);
+    for (long id = 0; id < agent_num; id++) {
+        crlDomain::agent_t a = {};
+        a.ID = id;
+        for (int d = 0; d < U_SIZE; d++)
+            a.STAT[d] = -FIELD_MAX + 2.0 * FIELD_MAX * (ac::stream_key(GOLDEN_SEED, d, id) >> 11) * 0x1.0p-53;
+        if (dom.tile_of(a.STAT) != rank) continue; // 他のタイルのプロセスが加える
+        a.PHYS = phys;
+        dom.add(a);
+    }
+    if (!dom.exchange()) return 1; // 境界付近のエージェントを隣のタイルに写す
+
+    crlAgentArray world;
+    crlForce force;
+    force.set_cutoff(DOMAIN_HALO);
+    for (int t = 0; t < ticks; t++) {
+        // 受け持ち (owned) の後ろにハローを並べる
+        std::vector<crlDomain::agent_t> &own = dom.owned();
+        const std::vector<crlDomain::agent_t> &halo = dom.halo();
+        world.init((int) (own.size() + halo.size()), env);
+        for (int i = 0; i < world.size(); i++) {
+            const crlDomain::agent_t &a = (i < (int) own.size()) ? own[i] : halo[i - own.size()];
+            world.set_stat(i, a.STAT);
+            world.set_physical_parameters(i, a.PHYS);
+        }
+        force.compute(world, [](int, int, const double *r, double r2, double *fi, double *fj) {
+            const double k = 2.0 * (DOMAIN_HALO / sqrt(r2) - 1.0); // 近いほど強い斥力
+            for (int d = 0; d < U_SIZE; d++) {
+                fi[d] = -k * r[d];
+                fj[d] = k * r[d];
+            }
+        });
+        force.to_input(world);
+        for (int i = 0; i < (int) own.size(); i++) // ランダムな入力（ID と時刻で決まる）
+            for (int d = 0; d < U_SIZE; d++)
+                world.u(d)[i] += 2.0 * ((ac::stream_key(GOLDEN_SEED + 1, t, own[i].ID * U_SIZE + d) >> 11) * 0x1.0p-53) - 1.0;
+        world.drive_all(SAMPLING_TIME);
+        for (int i = 0; i < (int) own.size(); i++)
+            world.get_stat(i, own[i].STAT);
+        if (!dom.exchange()) return 1;
+    }
+    std::cout << "domain: tile " << rank << " [" << dom.get_tile_min(0) << ", " << dom.get_tile_max(0) << ") x [";
+    std::cout << dom.get_tile_min(1) << ", " << dom.get_tile_max(1) << "), agents " << dom.owned().size();
+    std::cout << ", halo " << dom.halo().size() << std::endl;
+    return 0;
+}
+
+// フィールドを tx x ty のタイルに分割し，タイルごとのプロセスで ticks ステップ実行する（描画なし）
+int run_domain(int tx, int ty, int ticks, int agent_num) {
+#ifdef __linux__
+    const std::string name = "/crl_domain_" + std::to_string(getpid());
+    ac::field_environment_t env;
+    ac::init(env);
+    env.X_MAX = env.Y_MAX = FIELD_MAX;
+    env.X_MIN = env.Y_MIN = -FIELD_MAX;
+    env.X_SIZE = env.Y_SIZE = 2.0 * FIELD_MAX;
+    const int tiles[U_SIZE] = {tx, ty};
+    const long capacity = crlDomain::inbox_capacity(env, tiles, DOMAIN_HALO, agent_num);
+    if (!crlDomain::create(name, env, tiles, DOMAIN_HALO, capacity)) return 1;
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<pid_t> child;
+    for (int rank = 0; rank < tx * ty; rank++) {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            const int ret = domain_worker(name.c_str(), rank, ticks, agent_num);
+            std::cout.flush();
+            _exit(ret);
+        }
+        child.push_back(pid);
+    }
+    int fail = 0;
+    for (pid_t pid : child) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) fail++;
+    }
+    crlDomain::unlink(name);
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "domain: tiles " << tx << " x " << ty << ", agents " << agent_num << ", ticks " << ticks;
+    std::cout << ", wall [s] " << sec << ", failed " << fail << std::endl;
+    return fail ? 1 : 0;
+#else
+    std::cerr << "#error: --domain is supported only on Linux. @run_domain()" << std::endl;
+    return 1;
+#endif
+}
+
+int main(int argc, char **argv) {
+
+    // 回帰チェック用（描画なし）
+    //   --golden-record <file> [ticks] [seed] : 固定シードで軌道を記録
+    //   --golden-check <file> [tol]           : 記録済みの軌道と比較（tol = 0: ビット単位）
+    if (argc >= 3 && strcmp(argv[1], "--golden-record") == 0) {
+        int ticks = (argc >= 4) ? atoi(argv[3]) : GOLDEN_TICKS;
+        unsigned int seed = (argc >= 5) ? (unsigned int) strtoul(argv[4], nullptr, 10) : GOLDEN_SEED;
+        return run_golden(argv[2], false, ticks, seed, 0.0);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--golden-check") == 0) {
+        double tol = (argc >= 4) ? atof(argv[3]) : 0.0;
+        return run_golden(argv[2], true, 0, 0, tol);
+    }
+    // ベンチマーク（描画なし）: --bench [ticks] [agent_num]
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+        int ticks = (argc >= 3) ? atoi(argv[2]) : BENCH_TICKS;
+        int agent_num = (argc >= 4) ? atoi(argv[3]) : AGENT_NUM;
+        if (ticks < 1 || agent_num < 1) {
+            std::cerr << "#error: ticks: " << ticks << ", agent_num: " << agent_num << " @main()" << std::endl;
+            return 1;
+        }
+        return run_bench(ticks, agent_num);
+    }
+    // アンサンブル（描画なし）: --ensemble [worlds] [ticks] [agent_num] [seed]
+    if (argc >= 2 && strcmp(argv[1], "--ensemble") == 0) {
+        int worlds = (argc >= 3) ? atoi(argv[2]) : ENSEMBLE_WORLDS;
+        int ticks = (argc >= 4) ? atoi(argv[3]) : BENCH_TICKS;
+        int agent_num = (argc >= 5) ? atoi(argv[4]) : AGENT_NUM;
+        unsigned int seed = (argc >= 6) ? (unsigned int) strtoul(argv[5], nullptr, 10) : GOLDEN_SEED;
+        if (worlds < 1 || ticks < 1 || agent_num < 1) {
+            std::cerr << "#error: worlds: " << worlds << ", ticks: " << ticks << ", agent_num: " << agent_num;
+            std::cerr << " @main()" << std::endl;
+            return 1;
+        }
+        return run_ensemble(worlds, ticks, agent_num, seed);
+    }
+    // パラメータスイープ（描画なし）: --sweep <file> [points] [ticks]
+    if (argc >= 3 && strcmp(argv[1], "--sweep") == 0) {
+        long points = (argc >= 4) ? atol(argv[3]) : 0;
+        int ticks = (argc >= 5) ? atoi(argv[4]) : BENCH_TICKS;
+        if (points < 0 || ticks < 1) {
+            std::cerr << "#error: points: " << points << ", ticks: " << ticks << " @main()" << std::endl;
+            return 1;
+        }
+        return run_sweep(argv[2], points, ticks);
+    }
+    // コルーチンによる行動（描画なし）: --behavior [ticks] [agent_num]
+    if (argc >= 2 && strcmp(argv[1], "--behavior") == 0) {
+        int ticks = (argc >= 3) ? atoi(argv[2]) : BENCH_TICKS;
+        int agent_num = (argc >= 4) ? atoi(argv[3]) : AGENT_NUM;
+        if (ticks < 1 || agent_num < 1) {
+            std::cerr << "#error: ticks: " << ticks << ", agent_num: " << agent_num << " @main()" << std::endl;
+            return 1;
+        }
+        return run_behavior(ticks, agent_num);
+    }
+    // 領域分割（描画なし，Linux のみ）: --domain <tiles_x> <tiles_y> [ticks] [agent_num]
+    if (argc >= 4 && strcmp(argv[1], "--domain") == 0) {
+        int tx = atoi(argv[2]), ty = atoi(argv[3]);
+        int ticks = (argc >= 5) ? atoi(argv[4]) : BENCH_TICKS;
+        int agent_num = (argc >= 6) ? atoi(argv[5]) : 10000;
+        if (tx < 1 || ty < 1 || ticks < 1 || agent_num < 1) {
+            std::cerr << "#error: tiles: " << tx << " x " << ty << ", ticks: " << ticks << ", agent_num: " << agent_num;
+            std::cerr << " @main()" << std::endl;
+            return 1;
+        }
+        return run_domain(tx, ty, ticks, agent_num);
+    }
+
+    // 操作者の入力の再生（描画なし）: --replay <file> [pace]
+    if (argc >= 3 && strcmp(argv[1], "--replay") == 0) {
+        bool pace = (argc >= 4) && atoi(argv[3]) != 0;
+        return run_replay(argv[2], pace);
+    }
+    // 操作者の入力の記録（描画あり）: --record <file>
+    const char *record_file = (argc >= 3 && strcmp(argv[1], "--record") == 0) ? argv[2] : nullptr;
 
     g_wnd.init(AGENT_NUM, FIELD_MAX);
+    // ジョイスティック: CRL_JOYSTICK=/dev/input/js0 のように指定すると入力スレッドでイベントを読み切る
+    const char *js_dev = getenv("CRL_JOYSTICK");
+    if (js_dev != nullptr && g_js.init(js_dev)) g_js.start();
     g_wnd.set_shakedown(false); // 慣らし運転モードを終了
     // メインループをスレッドで呼び出し
     // 2つめの引数（int型）は再生倍率
-    std::thread th1(main_loop, 1);
+    std::thread th1(main_loop, 1, record_file);
+    ac::set_affinity(th1, cpu_list("CRL_CPU_SIM"));
+    ac::set_affinity_self(cpu_list("CRL_CPU_RENDER"));
 
     // GLFWの設定（画面サイズの設定可能・正方形がおすすめ）
     g_wnd.execute("multi agent sim", 640, 640);
@@ -0,0 +1,35 @@
+/***************************************************************************
+ * crlTest.hpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * test/ のテスト（ctest）で使う検査
+ *   CRL_CHECK(a == b);          // 偽なら "#error: ..." を出力して失敗を数える
+ *   return crl_test_result();   // 失敗がなければ 0
+ *****************************************************************************/
+
+#ifndef CRL_TEST_HPP
+#define CRL_TEST_HPP
+
+#include <iostream>
+
+inline int &crl_test_fail() {
+    static int fail = 0;
+    return fail;
+}
+
+#define CRL_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << "#error: " << #cond << " @" << __FILE__ << ":" << __LINE__ << std::endl; \
+            crl_test_fail()++; \
+        } \
+    } while (0)
+
+inline int crl_test_result() {
+    if (crl_test_fail() > 0) std::cerr << "#error: " << crl_test_fail() << " check(s) failed." << std::endl;
+    return crl_test_fail() > 0 ? 1 : 0;
+}
+
+#endif // CRL_TEST_HPP
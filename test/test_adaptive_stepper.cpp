@@ -0,0 +1,130 @@
+/***************************************************************************
+ * test_adaptive_stepper.cpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * crlAdaptiveStepper: 孤立したエージェントは drive_all() と一致し，各エージェントは1ステップに
+ * 合計 smpl_time だけ駆動され，刻みごとの接触の解決で重なりが生じないこと
+ *****************************************************************************/
+
+#include <cstring>
+#include "crlAdaptiveStepper.hpp"
+#include "crlTest.hpp"
+
+#define DT 0.033
+
+static void make_field(ac::field_environment_t &env) {
+    ac::init(env);
+    env.X_MAX = env.Y_MAX = 100.0;
+    env.X_MIN = env.Y_MIN = -100.0;
+    env.X_SIZE = env.Y_SIZE = 200.0;
+}
+
+// 孤立したエージェントだけなら drive_all() とビット単位で一致する
+static void test_isolated() {
+    ac::field_environment_t env;
+    make_field(env);
+    crlAgentArray a, b;
+    a.init(64, env);
+    for (int i = 0; i < 64; i++) {
+        a.pos(0)[i] = -96.0 + 24.0 * (i % 8);
+        a.pos(1)[i] = -96.0 + 24.0 * (i / 8);
+        a.vel(0)[i] = 0.1 * i;
+    }
+    b = a;
+    crlAdaptiveStepper st;
+    for (int t = 0; t < 50; t++) {
+        for (int i = 0; i < 64; i++) {
+            a.u(0)[i] = b.u(0)[i] = 3.0 * sin(0.1 * t + i);
+            a.u(1)[i] = b.u(1)[i] = 3.0 * cos(0.1 * t + i);
+        }
+        CRL_CHECK(st.drive(a, DT));
+        CRL_CHECK(st.get_level_num(0) == 64);
+        b.drive_all(DT);
+    }
+    for (int d = 0; d < 2; d++) {
+        CRL_CHECK(std::memcmp(a.pos(d), b.pos(d), 64 * sizeof(ac::real_t)) == 0);
+        CRL_CHECK(std::memcmp(a.vel(d), b.vel(d), 64 * sizeof(ac::real_t)) == 0);
+    }
+}
+
+// 近接したエージェントは細かい刻みで駆動され，刻みごとにコールバックが呼ばれる
+//   刻みの合計は全エージェントで smpl_time（1ステップに1回だけ駆動され，同じ時刻にそろう）
+static void test_substep() {
+    ac::field_environment_t env;
+    make_field(env);
+    crlAgentArray w;
+    const int num = 40;
+    w.init(num, env);
+    for (int i = 0; i < num; i++) {
+        w.pos(0)[i] = (i < 20) ? 4.5 * i : -80.0 + 30.0 * (i - 20) / 4;
+        w.pos(1)[i] = (i < 20) ? 0.0 : 50.0 + 30.0 * ((i - 20) % 4);
+        w.vel(0)[i] = (i % 2) ? -20.0 : 20.0;
+    }
+    crlAdaptiveStepper st;
+    st.set_max_level(4);
+    std::vector<double> sum(num);
+    long calls = 0;
+    for (int t = 0; t < 20; t++) {
+        sum.assign(num, 0.0);
+        CRL_CHECK(st.drive(w, DT, [&](crlAgentArray &world, const std::vector<int> &active, double h) {
+            calls++;
+            for (int i : active) {
+                sum[i] += h;
+                world.u(0)[i] = -0.1 * world.pos(0)[i]; // 現在の状態から入力を計算し直す
+                world.u(1)[i] = -0.1 * world.pos(1)[i];
+            }
+        }));
+        for (int i = 0; i < num; i++)
+            CRL_CHECK(fabs(sum[i] - DT) < 1.0e-15);
+    }
+    int fine = 0;
+    for (int l = 1; l <= st.get_max_level(); l++)
+        fine += st.get_level_num(l);
+    CRL_CHECK(fine > 0);
+    CRL_CHECK(calls > 20);
+}
+
+// 刻みごとに接触を解決すると，すり抜け・重なりが生じない
+static void test_contact() {
+    ac::field_environment_t env;
+    make_field(env);
+    ac::agent_physical_t ap;
+    ac::init_physical_param(ap);
+    ap.RADIUS = 0.2;
+    crlAgentArray w;
+    const int num = 16;
+    w.init(num, env);
+    for (int i = 0; i < num; i++) {
+        w.set_physical_parameters(i, ap);
+        w.pos(0)[i] = 1.0 * i; // 隙間 0.6，1ステップで 1.5 進む
+        w.vel(0)[i] = (i % 2) ? -45.0 : 45.0;
+    }
+    crlAdaptiveStepper st;
+    st.set_max_level(6);
+    st.set_contact(true);
+    int contact = 0;
+    for (int t = 0; t < 30; t++) {
+        CRL_CHECK(st.drive(w, DT));
+        contact += st.get_contact_num();
+        for (int i = 0; i < num; i++) {
+            for (int j = i + 1; j < num; j++) {
+                double n = 0.0;
+                for (int d = 0; d < 2; d++) {
+                    const double dx = ac::min_image(w.pos(d)[j] - w.pos(d)[i], 200.0);
+                    n += dx * dx;
+                }
+                CRL_CHECK(sqrt(n) >= 0.4 - 1.0e-9);
+            }
+        }
+    }
+    CRL_CHECK(contact > 0);
+}
+
+int main() {
+    test_isolated();
+    test_substep();
+    test_contact();
+    return crl_test_result();
+}
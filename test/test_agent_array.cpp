@@ -0,0 +1,132 @@
+/***************************************************************************
+ * test_agent_array.cpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * crlAgentArray::drive_all(): SIMD 幅（1, AVX2: 4, AVX-512: 8）によらず drive_scalar() と
+ * crlAgentCore::drive_core() にビット単位で一致し，drive_all(dt, pool) もワーカー数によらず一致すること
+ * （-ffp-contract=off でビルドする。SIMD 版は test_agent_array_avx2, test_agent_array_avx512）
+ *****************************************************************************/
+
+#include <random>
+#include <cstring>
+#include "crlAgent.hpp"
+#include "crlAgentArray.hpp"
+#include "crlTest.hpp"
+
+#define DT 0.033
+#define TEST_SKIP 77 // この CPU では実行できない（ctest の SKIP_RETURN_CODE）
+
+// drive_core() を呼ぶため
+struct test_agent_t : public crlAgent {
+    using crlAgentCore::drive_core;
+};
+
+// 飽和・フィールドの端・小さな入力を含む状態と物理パラメータ（SIMD の端数が出る数）
+static void make_agents(std::vector<test_agent_t> &agent, int num) {
+    std::mt19937_64 rng(28);
+    std::uniform_real_distribution<double> uni(-1.0, 1.0);
+    agent.resize(num);
+    for (int i = 0; i < num; i++) {
+        agent[i].init(i, 0, 100.0);
+        ac::agent_physical_t ap;
+        ac::init_physical_param(ap);
+        ap.M = 1.0 + 0.5 * (i % 3);
+        ap.D = 0.5 * (i % 4);
+        ap.U_MAX = 20.0 + 40.0 * (i % 2);
+        ap.V_MAX = 10.0 + 50.0 * ((i / 2) % 2);
+        agent[i].set_physical_parameters(ap);
+        double st[crlAgentArray::STAT] = {};
+        for (int d = 0; d < U_SIZE; d++) {
+            st[d] = (i % 5 == 0) ? 99.9 * (d ? -1.0 : 1.0) : 100.0 * uni(rng); // 端の近く
+            st[U_SIZE + d] = 70.0 * uni(rng);
+        }
+        agent[i].set_stat(st);
+    }
+}
+
+static double input(int i, int d, int t) {
+    if (i % 7 == 0) return 1.0e-4 * (d + 1); // 飽和の判定を下回る小さな入力
+    return 80.0 * sin(0.37 * i + 1.3 * d + 0.1 * t);
+}
+
+// drive_all() と drive_scalar(), crlAgentCore::drive_core() の比較
+static void test_core(int num) {
+    std::vector<test_agent_t> agent;
+    make_agents(agent, num);
+    crlAgentArray a, b;
+    CRL_CHECK(a.gather(agent));
+    CRL_CHECK(b.gather(agent));
+    std::vector<double> u(U_SIZE), stat;
+    double st[crlAgentArray::STAT];
+    int mismatch = 0;
+    for (int t = 0; t < 40; t++) {
+        for (int i = 0; i < num; i++) {
+            for (int d = 0; d < U_SIZE; d++)
+                a.u(d)[i] = b.u(d)[i] = u[d] = input(i, d, t);
+            agent[i].drive_core(stat, u, DT);
+        }
+        a.drive_all(DT);
+        for (int i = 0; i < num; i++)
+            b.drive_scalar(i, DT);
+        for (int i = 0; i < num; i++) {
+            double sa[crlAgentArray::STAT], sb[crlAgentArray::STAT];
+            a.get_stat(i, sa);
+            b.get_stat(i, sb);
+            agent[i].get_stat(st);
+            if (std::memcmp(sa, sb, sizeof(sa)) != 0 || std::memcmp(sa, st, sizeof(sa)) != 0) mismatch++;
+        }
+    }
+    CRL_CHECK(mismatch == 0);
+}
+
+// drive_all(dt, pool) と drive_all(dt) の比較（place() の後も同じ）
+static void test_pool(int num) {
+    std::vector<test_agent_t> agent;
+    make_agents(agent, num);
+    crlAgentArray ref;
+    CRL_CHECK(ref.gather(agent));
+    const int workers[] = {1, 2, 3, 4};
+    std::vector<crlAgentArray> w(4);
+    std::vector<crlThreadPool> pool(4);
+    for (int k = 0; k < 4; k++) {
+        CRL_CHECK(pool[k].init(workers[k]));
+        CRL_CHECK(w[k].gather(agent));
+        w[k].place(pool[k]);
+    }
+    for (int t = 0; t < 20; t++) {
+        for (int i = 0; i < num; i++) {
+            for (int d = 0; d < U_SIZE; d++) {
+                ref.u(d)[i] = input(i, d, t);
+                for (int k = 0; k < 4; k++)
+                    w[k].u(d)[i] = ref.u(d)[i];
+            }
+        }
+        ref.drive_all(DT);
+        for (int k = 0; k < 4; k++)
+            w[k].drive_all(DT, pool[k]);
+    }
+    for (int k = 0; k < 4; k++) {
+        for (int d = 0; d < U_SIZE; d++) {
+            CRL_CHECK(std::memcmp(w[k].pos(d), ref.pos(d), num * sizeof(ac::real_t)) == 0);
+            CRL_CHECK(std::memcmp(w[k].vel(d), ref.vel(d), num * sizeof(ac::real_t)) == 0);
+            CRL_CHECK(std::memcmp(w[k].acc(d), ref.acc(d), num * sizeof(ac::real_t)) == 0);
+        }
+    }
+}
+
+int main() {
+#if defined(__AVX512F__)
+    if (!__builtin_cpu_supports("avx512f")) return TEST_SKIP;
+    CRL_CHECK(crlAgentArray::SIMD_WIDTH == 8);
+#elif defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2")) return TEST_SKIP;
+    CRL_CHECK(crlAgentArray::SIMD_WIDTH == 4);
+#else
+    CRL_CHECK(crlAgentArray::SIMD_WIDTH == 1);
+#endif
+    test_core(1003);
+    test_pool(5003);
+    return crl_test_result();
+}
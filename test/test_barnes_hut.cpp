@@ -0,0 +1,138 @@
+/***************************************************************************
+ * test_barnes_hut.cpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * crlBarnesHut: theta = 0 で直接の総和と一致し（丸め誤差のみ），theta > 0 の近似誤差が小さく，
+ * 並列の build(), compute() が逐次とビット単位で一致すること（2次元, 3次元）
+ *****************************************************************************/
+
+#include <random>
+#include <cstring>
+#include "crlBarnesHut.hpp"
+#include "crlTest.hpp"
+
+// 軟化した逆二乗の引力
+static void kernel(const double *r, double r2, double w, double *f, int dim) {
+    const double s = r2 + 0.01;
+    const double k = w / (s * sqrt(s));
+    for (int d = 0; d < dim; d++)
+        f[d] += k * r[d];
+}
+
+template<int DIM>
+struct bh_kernel_t {
+    void operator()(const double *r, double r2, double w, double *f) const { kernel(r, r2, w, f, DIM); }
+};
+
+template<int DIM>
+static void make_world(crlAgentArrayT<DIM> &world, std::vector<double> &w, int num, int seed) {
+    ac::field_environment_t env;
+    ac::init(env);
+    world.init(num, env);
+    w.resize(num);
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    for (int i = 0; i < num; i++) {
+        // 半分は一様，半分は塊にして木を深くする
+        for (int d = 0; d < DIM; d++) {
+            const double min = ac::field_min(env, d), size = ac::field_max(env, d) - min;
+            world.pos(d)[i] = (i % 2) ? min + uni(rng) * size : 30.0 + 5.0 * uni(rng);
+        }
+        w[i] = 0.5 + uni(rng);
+    }
+}
+
+// 直接の総和（最小イメージ）
+template<int DIM>
+static void direct(const crlAgentArrayT<DIM> &world, const double *w, std::vector<double> *F) {
+    const int num = world.size();
+    for (int d = 0; d < DIM; d++)
+        F[d].assign(num, 0.0);
+    for (int i = 0; i < num; i++) {
+        double f[DIM] = {}, r[DIM];
+        for (int j = 0; j < num; j++) {
+            if (j == i) continue;
+            double r2 = 0.0;
+            for (int d = 0; d < DIM; d++) {
+                const double size = ac::field_max(world.get_env(), d) - ac::field_min(world.get_env(), d);
+                r[d] = ac::min_image(world.pos(d)[j] - world.pos(d)[i], size);
+                r2 += r[d] * r[d];
+            }
+            kernel(r, r2, w[j], f, DIM);
+        }
+        for (int d = 0; d < DIM; d++)
+            F[d][i] = f[d];
+    }
+}
+
+// 相対誤差 |F - F_direct| / |F_direct| の最大値と平均
+template<int DIM>
+static void error(const crlBarnesHutT<DIM> &bh, const std::vector<double> *F, double &max_err, double &mean_err) {
+    const int num = (int) F[0].size();
+    max_err = mean_err = 0.0;
+    for (int i = 0; i < num; i++) {
+        double e2 = 0.0, n2 = 0.0;
+        for (int d = 0; d < DIM; d++) {
+            const double e = bh.get_field(i, d) - F[d][i];
+            e2 += e * e;
+            n2 += F[d][i] * F[d][i];
+        }
+        const double e = sqrt(e2 / n2);
+        max_err = std::max(max_err, e);
+        mean_err += e / num;
+    }
+}
+
+template<int DIM>
+static void test_accuracy(int num) {
+    crlAgentArrayT<DIM> world;
+    std::vector<double> w, F[DIM];
+    make_world(world, w, num, 10 + DIM);
+    direct(world, w.data(), F);
+    crlBarnesHutT<DIM> bh;
+    double max_err, mean_err;
+    CRL_CHECK(bh.set_theta(0.0));
+    CRL_CHECK(bh.build(world, w.data()));
+    bh.compute(world, bh_kernel_t<DIM>());
+    error(bh, F, max_err, mean_err);
+    CRL_CHECK(max_err < 1.0e-10); // 足す順序による丸め誤差のみ
+    CRL_CHECK(bh.set_theta(0.5));
+    CRL_CHECK(bh.build(world, w.data()));
+    bh.compute(world, bh_kernel_t<DIM>());
+    error(bh, F, max_err, mean_err);
+    CRL_CHECK(mean_err < 2.0e-2);
+}
+
+// 並列の build(), compute() は逐次とビット単位で一致する
+template<int DIM>
+static void test_parallel(int num) {
+    crlAgentArrayT<DIM> world;
+    std::vector<double> w;
+    make_world(world, w, num, 20 + DIM);
+    crlBarnesHutT<DIM> ref;
+    CRL_CHECK(ref.set_theta(0.5));
+    CRL_CHECK(ref.build(world, w.data()));
+    ref.compute(world, bh_kernel_t<DIM>());
+    const int workers[] = {1, 2, 4, 7};
+    for (int n : workers) {
+        crlThreadPool pool;
+        CRL_CHECK(pool.init(n));
+        crlBarnesHutT<DIM> bh;
+        CRL_CHECK(bh.set_theta(0.5));
+        CRL_CHECK(bh.build(world, w.data(), pool));
+        bh.compute(world, bh_kernel_t<DIM>(), pool);
+        CRL_CHECK(bh.get_node_num() == ref.get_node_num());
+        for (int d = 0; d < DIM; d++)
+            CRL_CHECK(std::memcmp(bh.field(d), ref.field(d), num * sizeof(double)) == 0);
+    }
+}
+
+int main() {
+    test_accuracy<2>(3000);
+    test_accuracy<3>(2000);
+    test_parallel<2>(6000);
+    test_parallel<3>(6000);
+    return crl_test_result();
+}
@@ -0,0 +1,164 @@
+/***************************************************************************
+ * test_collision.cpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * crlCollision: 接触時刻の解析解，格子による判定が全ての組の判定と一致すること，
+ * 速いエージェントがすり抜けないこと（フィールドの端をまたぐ場合を含む），
+ * 並列の drive(world, dt, pool) がワーカー数によらず drive() とビット単位で一致すること
+ *****************************************************************************/
+
+#include <random>
+#include <cstring>
+#include "crlCollision.hpp"
+#include "crlTest.hpp"
+
+#define DT 0.033
+
+static void test_contact_time() {
+    const double r0[2] = {10.0, 0.0}, v[2] = {-20.0, 0.0};
+    CRL_CHECK(fabs(crlCollision::contact_time(r0, v, 2.0) - 0.4) < 1.0e-15); // |10 - 20 t| = 2
+    const double away[2] = {20.0, 0.0};
+    CRL_CHECK(crlCollision::contact_time(r0, away, 2.0) == 2.0); // 離れていく
+    const double miss[2] = {-20.0, 0.0}, r1[2] = {10.0, 5.0};
+    CRL_CHECK(crlCollision::contact_time(r1, miss, 2.0) == 2.0); // 横をすれ違う
+    const double r2[2] = {1.0, 0.0};
+    CRL_CHECK(crlCollision::contact_time(r2, v, 2.0) == 0.0); // 重なっていてさらに近づく
+}
+
+// 格子による判定と全ての組の判定の比較（最初の接触時刻と相手）
+static void test_brute_force() {
+    ac::field_environment_t env;
+    ac::init(env);
+    const int num = 2000;
+    crlAgentArray world;
+    world.init(num, env);
+    std::mt19937_64 rng(30);
+    std::uniform_real_distribution<double> uni(-1.0, 1.0);
+    for (int i = 0; i < num; i++) {
+        for (int d = 0; d < 2; d++) {
+            world.pos(d)[i] = 100.0 * uni(rng);
+            world.vel(d)[i] = 50.0 * uni(rng);
+            world.u(d)[i] = 50.0 * uni(rng);
+        }
+    }
+    crlCollision col;
+    std::vector<double> p0[2], dr[2];
+    for (int d = 0; d < 2; d++)
+        p0[d].assign(world.pos(d), world.pos(d) + num);
+    col.begin(world);
+    world.drive_all(DT);
+    for (int d = 0; d < 2; d++) {
+        dr[d].resize(num);
+        for (int i = 0; i < num; i++)
+            dr[d][i] = ac::min_image(world.pos(d)[i] - p0[d][i], 200.0);
+    }
+    const int contact = col.resolve(world, DT);
+    int brute_contact = 0, mismatch = 0;
+    for (int i = 0; i < num; i++) {
+        double toi = 2.0;
+        int partner = -1;
+        for (int j = 0; j < num; j++) {
+            if (j == i) continue;
+            double r0[2], v[2];
+            for (int d = 0; d < 2; d++) {
+                r0[d] = ac::min_image(p0[d][j] - p0[d][i], 200.0);
+                v[d] = dr[d][j] - dr[d][i];
+            }
+            const double t = crlCollision::contact_time(r0, v, world.get_radius(i) + world.get_radius(j));
+            if (t <= 1.0 && t < toi) { // j の昇順なので同じ時刻なら番号の小さい相手
+                toi = t;
+                partner = j;
+            }
+        }
+        if (partner >= 0) brute_contact++;
+        if (toi != col.get_toi(i) || partner != col.get_partner(i)) mismatch++;
+    }
+    CRL_CHECK(contact > 0);
+    CRL_CHECK(contact == brute_contact);
+    CRL_CHECK(mismatch == 0);
+}
+
+// 1ステップで相手を飛び越える速さでも，接触位置で止まる（x = 99 と x = -99 の組はフィールドの端をまたぐ）
+static void test_tunnelling() {
+    ac::field_environment_t env;
+    ac::init(env);
+    ac::agent_physical_t ap;
+    ac::init_physical_param(ap);
+    ap.RADIUS = 0.3;
+    crlAgentArray world;
+    world.init(4, env);
+    const double x[4] = {-10.0, -9.0, 99.0, -99.0}, v[4] = {50.0, -50.0, 50.0, -50.0};
+    for (int i = 0; i < 4; i++) {
+        world.set_physical_parameters(i, ap);
+        world.pos(0)[i] = x[i];
+        world.pos(1)[i] = 0.0;
+        world.vel(0)[i] = v[i];
+    }
+    crlCollision col;
+    int contact = 0;
+    for (int t = 0; t < 5; t++) {
+        for (int i = 0; i < 4; i++)
+            world.u(0)[i] = v[i];
+        contact += col.drive(world, DT);
+        for (int k = 0; k < 4; k += 2) {
+            // 相対位置の向きが入れ替わらず，重ならない
+            const double gap = ac::min_image(world.pos(0)[k + 1] - world.pos(0)[k], 200.0);
+            CRL_CHECK(gap >= 0.6 - 1.0e-9);
+        }
+    }
+    CRL_CHECK(contact >= 4);
+}
+
+// 並列の drive() と逐次の drive() の比較（同じ時刻の接触が多い密な世界）
+static void test_pool() {
+    ac::field_environment_t env;
+    ac::init(env);
+    const int num = 5000;
+    crlAgentArray ref;
+    ref.init(num, env);
+    std::mt19937_64 rng(40);
+    std::uniform_real_distribution<double> uni(-1.0, 1.0);
+    for (int i = 0; i < num; i++) {
+        for (int d = 0; d < 2; d++) {
+            ref.pos(d)[i] = 100.0 * uni(rng);
+            ref.vel(d)[i] = 50.0 * uni(rng);
+        }
+    }
+    const int workers[] = {1, 2, 3, 4};
+    std::vector<crlAgentArray> w(4, ref);
+    std::vector<crlThreadPool> pool(4);
+    std::vector<crlCollision> col(4);
+    crlCollision ref_col;
+    for (int k = 0; k < 4; k++)
+        CRL_CHECK(pool[k].init(workers[k]));
+    for (int t = 0; t < 10; t++) {
+        for (int i = 0; i < num; i++) {
+            for (int d = 0; d < 2; d++) {
+                ref.u(d)[i] = 30.0 * sin(0.3 * i + d + 0.1 * t);
+                for (int k = 0; k < 4; k++)
+                    w[k].u(d)[i] = ref.u(d)[i];
+            }
+        }
+        const int contact = ref_col.drive(ref, DT);
+        for (int k = 0; k < 4; k++)
+            CRL_CHECK(col[k].drive(w[k], DT, pool[k]) == contact);
+    }
+    for (int k = 0; k < 4; k++) {
+        for (int d = 0; d < 2; d++) {
+            CRL_CHECK(std::memcmp(w[k].pos(d), ref.pos(d), num * sizeof(ac::real_t)) == 0);
+            CRL_CHECK(std::memcmp(w[k].vel(d), ref.vel(d), num * sizeof(ac::real_t)) == 0);
+        }
+        for (int i = 0; i < num; i++)
+            CRL_CHECK(col[k].get_partner(i) == ref_col.get_partner(i));
+    }
+}
+
+int main() {
+    test_contact_time();
+    test_brute_force();
+    test_tunnelling();
+    test_pool();
+    return crl_test_result();
+}
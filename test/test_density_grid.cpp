@@ -0,0 +1,96 @@
+/***************************************************************************
+ * test_density_grid.cpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * crlDensityGrid::count(): 端をまたぐ矩形を含む問い合わせを全探索と比べる（2次元, 3次元）
+ *****************************************************************************/
+
+#include <random>
+#include "crlDensityGrid.hpp"
+#include "crlTest.hpp"
+
+// 全探索: エージェントのセル [c, c + w) が，軸ごとの区間 [lo, hi]（lo > hi なら端をまたぐ）に重なるか
+template<int DIM>
+static int brute_count(const crlDensityGridT<DIM> &map, const ac::field_environment_t &env,
+                       const crlAgentArrayT<DIM> &world, const double *lo, const double *hi) {
+    int sum = 0;
+    for (int i = 0; i < world.size(); i++) {
+        bool in = true;
+        for (int d = 0; d < DIM && in; d++) {
+            const double min = ac::field_min(env, d), size = ac::field_max(env, d) - min;
+            const double w = map.get_cell_width(d);
+            const double c = min + w * map.cell_index(world.pos(d)[i], d);
+            const double h = (lo[d] > hi[d]) ? hi[d] + size : hi[d];
+            bool hit = false;
+            for (int s = -2; s <= 2; s++) // セルを周期的にずらして区間と比べる
+                hit = hit || (c + s * size <= h && c + w + s * size > lo[d]);
+            in = hit;
+        }
+        if (in) sum++;
+    }
+    return sum;
+}
+
+template<int DIM>
+static void test_random(int num, double cell_size, int query_num) {
+    ac::field_environment_t env;
+    ac::init(env);
+    crlAgentArrayT<DIM> world;
+    world.init(num, env);
+    std::mt19937_64 rng(DIM * 1000 + num);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    for (int i = 0; i < num; i++)
+        for (int d = 0; d < DIM; d++)
+            world.pos(d)[i] = ac::field_min(env, d) + uni(rng) * (ac::field_max(env, d) - ac::field_min(env, d));
+    crlDensityGridT<DIM> map;
+    CRL_CHECK(map.init(env, cell_size));
+    CRL_CHECK(map.update(world));
+    int mismatch = 0;
+    for (int q = 0; q < query_num; q++) {
+        double lo[DIM], hi[DIM];
+        for (int d = 0; d < DIM; d++) {
+            const double min = ac::field_min(env, d), size = ac::field_max(env, d) - min;
+            lo[d] = min + uni(rng) * size;
+            switch (q % 4) {
+                case 0: hi[d] = min + uni(rng) * size; break; // 任意（lo > hi なら端をまたぐ）
+                case 1: hi[d] = lo[d] - uni(rng) * cell_size; break; // 端をまたいで lo と同じか隣のセル
+                case 2: hi[d] = lo[d] + uni(rng) * cell_size; break; // 狭い範囲
+                default: hi[d] = lo[d] + (uni(rng) * 1.4 - 0.2) * size; break; // フィールド外・全体
+            }
+        }
+        if (map.count(lo, hi) != brute_count(map, env, world, lo, hi)) mismatch++;
+    }
+    CRL_CHECK(mismatch == 0);
+}
+
+// 同じセルの lo > hi（端をまたいでほぼ全体）を1セルと数えていた問題
+static void test_same_cell_wrap() {
+    ac::field_environment_t env;
+    ac::init(env);
+    crlAgentArray world;
+    const int num = 3000;
+    world.init(num, env);
+    std::mt19937_64 rng(3000);
+    std::uniform_real_distribution<double> uni(-100.0, 100.0);
+    for (int i = 0; i < num; i++) {
+        world.pos(0)[i] = uni(rng);
+        world.pos(1)[i] = uni(rng);
+    }
+    crlDensityGrid map;
+    CRL_CHECK(map.init(env, 1.0));
+    CRL_CHECK(map.update(world));
+    const double lo[2] = {69.69, 66.57}, hi[2] = {88.91, 66.51};
+    const int n = map.count(lo, hi);
+    CRL_CHECK(n == brute_count(map, env, world, lo, hi));
+    CRL_CHECK(n > 200);
+}
+
+int main() {
+    test_same_cell_wrap();
+    test_random<2>(3000, 1.0, 4000);
+    test_random<2>(500, 7.3, 4000);
+    test_random<3>(2000, 5.0, 2000);
+    return crl_test_result();
+}
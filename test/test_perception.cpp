@@ -0,0 +1,205 @@
+/***************************************************************************
+ * test_perception.cpp
+ *
+ * Copyright (C) 2023 - Hiroshi IGARASHI
+ * Oct. 19, 2026
+ *
+ * crlPerception: 視野内の近傍と最も近い相手 nearest() を全探索と比べ，
+ * update(world, tick, pool) がワーカー数によらず update() と一致すること。
+ * 観測ノイズ (SIGHT_SIGMA > 0) は (シード, 時刻, 観測者) で再現でき，平均 0・標準偏差 SIGHT_SIGMA で，
+ * 見える・見えないの判定は変えないこと
+ *****************************************************************************/
+
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include "crlPerception.hpp"
+#include "crlTest.hpp"
+
+// 視野角度・視野範囲・半径がまちまちの世界（num が小さいと視野内に誰もいないエージェントが多い）
+static void make_world(crlAgentArray &world, int num, int seed) {
+    ac::field_environment_t env;
+    ac::init(env);
+    world.init(num, env);
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uni(-1.0, 1.0);
+    for (int i = 0; i < num; i++) {
+        ac::agent_physical_t ap;
+        ac::init_physical_param(ap);
+        ap.RADIUS = 1.0 + 0.5 * (i % 3);
+        ap.SIGHT_RANGE = 5.0 + 5.0 * (i % 4);
+        ap.SIGHT_ANGLE = (i % 2) ? 360.0 : 90.0 + 30.0 * (i % 5);
+        world.set_physical_parameters(i, ap);
+        for (int d = 0; d < 2; d++) {
+            world.pos(d)[i] = 100.0 * uni(rng);
+            world.vel(d)[i] = (i % 6 == 0) ? 0.0 : 10.0 * uni(rng); // 止まっていれば全方向
+        }
+    }
+}
+
+static void rel_of(const crlAgentArray &world, int i, int j, double *r) {
+    for (int d = 0; d < 2; d++)
+        r[d] = ac::min_image(world.pos(d)[j] - world.pos(d)[i], 200.0);
+}
+
+// 全探索: i から見えるエージェント（番号順）
+static std::vector<int> brute_sight(const crlAgentArray &world, int i) {
+    std::vector<int> nbr;
+    const double h[2] = {world.vel(0)[i], world.vel(1)[i]};
+    const double hn = sqrt(h[0] * h[0] + h[1] * h[1]);
+    for (int j = 0; j < world.size(); j++) {
+        if (j == i) continue;
+        double r[2];
+        rel_of(world, i, j, r);
+        const double rn = sqrt(r[0] * r[0] + r[1] * r[1]);
+        if (rn - world.get_radius(i) - world.get_radius(j) >= world.get_sight_range(i)) continue;
+        if (world.get_sight_angle(i) < 360.0 && hn >= 0.001) {
+            const double angle = acos(std::max(-1.0, std::min(1.0, (h[0] * r[0] + h[1] * r[1]) / (hn * rn))));
+            if (angle * 180.0 / M_PI > 0.5 * world.get_sight_angle(i)) continue;
+        }
+        nbr.push_back(j);
+    }
+    return nbr;
+}
+
+// 全探索: 視野内で最も近い相手，いなければ全体で最も近い相手（表面間の距離，同じなら番号の小さい方）
+static int brute_nearest(const crlAgentArray &world, int i) {
+    std::vector<int> cand = brute_sight(world, i);
+    if (cand.empty()) {
+        for (int j = 0; j < world.size(); j++)
+            if (j != i) cand.push_back(j);
+    }
+    int best = -1;
+    double best_d = INFINITY;
+    for (int j : cand) {
+        double r[2];
+        rel_of(world, i, j, r);
+        const double dj = sqrt(r[0] * r[0] + r[1] * r[1]) - world.get_radius(j);
+        if (dj < best_d) {
+            best_d = dj;
+            best = j;
+        }
+    }
+    return best;
+}
+
+static void test_brute_force(int num) {
+    crlAgentArray world;
+    make_world(world, num, num);
+    crlPerception per;
+    CRL_CHECK(per.update(world));
+    int mismatch = 0, nearest_mismatch = 0, unseen = 0;
+    for (int i = 0; i < num; i++) {
+        std::vector<int> nbr;
+        for (int k = per.begin(i); k < per.end(i); k++)
+            nbr.push_back(per.get_neighbor(k));
+        std::sort(nbr.begin(), nbr.end());
+        if (nbr != brute_sight(world, i)) mismatch++;
+        if (per.get_neighbor_num(i) == 0) unseen++;
+        double rel[2], r[2];
+        const int j = per.nearest(world, i, rel);
+        if (j != brute_nearest(world, i)) {
+            nearest_mismatch++;
+            continue;
+        }
+        rel_of(world, i, j, r);
+        if (rel[0] != r[0] || rel[1] != r[1]) nearest_mismatch++;
+    }
+    CRL_CHECK(mismatch == 0);
+    CRL_CHECK(nearest_mismatch == 0);
+    CRL_CHECK(unseen > 0); // 視野外を探す場合も調べている
+}
+
+// update(world, tick, pool) と update(world, tick) の比較
+static void test_pool(int num) {
+    crlAgentArray world;
+    make_world(world, num, 35);
+    crlPerception ref;
+    CRL_CHECK(ref.update(world, 7));
+    const int workers[] = {1, 2, 3, 4};
+    for (int n : workers) {
+        crlThreadPool pool;
+        CRL_CHECK(pool.init(n));
+        crlPerception per;
+        CRL_CHECK(per.update(world, 7, pool));
+        CRL_CHECK(per.get_total_num() == ref.get_total_num());
+        if (per.get_total_num() != ref.get_total_num()) continue;
+        CRL_CHECK(std::memcmp(per.offset(), ref.offset(), (num + 1) * sizeof(int)) == 0);
+        CRL_CHECK(std::memcmp(per.neighbor(), ref.neighbor(), ref.get_total_num() * sizeof(int)) == 0);
+        for (int d = 0; d < 2; d++)
+            CRL_CHECK(std::memcmp(per.rel(d), ref.rel(d), ref.get_total_num() * sizeof(double)) == 0);
+    }
+}
+
+// 観測ノイズ: ワーカー数・計算順序によらず再現でき，時刻・シードが変われば変わる
+static void test_noise(int num) {
+    const double sigma = 0.5;
+    crlAgentArray world;
+    make_world(world, num, 36);
+    crlPerception exact;
+    CRL_CHECK(exact.update(world, 3));
+    for (int i = 0; i < num; i++) {
+        ac::agent_physical_t ap;
+        ac::init_physical_param(ap);
+        ap.RADIUS = world.get_radius(i);
+        ap.SIGHT_RANGE = world.get_sight_range(i);
+        ap.SIGHT_ANGLE = world.get_sight_angle(i);
+        ap.SIGHT_SIGMA = sigma;
+        world.set_physical_parameters(i, ap);
+    }
+    crlPerception ref, other_tick, other_seed;
+    ref.set_seed(42);
+    other_tick.set_seed(42);
+    other_seed.set_seed(43);
+    CRL_CHECK(ref.update(world, 3));
+    CRL_CHECK(other_tick.update(world, 4));
+    CRL_CHECK(other_seed.update(world, 3));
+    const int total = ref.get_total_num();
+    CRL_CHECK(total > 1000);
+    // 近傍は真の位置で判定するのでノイズがなくても同じ
+    CRL_CHECK(total == exact.get_total_num());
+    if (total != exact.get_total_num()) return;
+    CRL_CHECK(std::memcmp(ref.neighbor(), exact.neighbor(), total * sizeof(int)) == 0);
+    // ノイズの標本平均・標準偏差
+    double sum = 0.0, sum2 = 0.0;
+    for (int d = 0; d < 2; d++) {
+        for (int k = 0; k < total; k++) {
+            const double e = ref.get_rel(k, d) - exact.get_rel(k, d);
+            sum += e;
+            sum2 += e * e;
+        }
+    }
+    const double mean = sum / (2 * total), sd = sqrt(sum2 / (2 * total) - mean * mean);
+    CRL_CHECK(fabs(mean) < 5.0 * sigma / sqrt(2.0 * total));
+    CRL_CHECK(fabs(sd - sigma) < 0.05 * sigma);
+    // 時刻・シードが変われば別の乱数列
+    CRL_CHECK(std::memcmp(ref.rel(0), other_tick.rel(0), total * sizeof(double)) != 0);
+    CRL_CHECK(std::memcmp(ref.rel(0), other_seed.rel(0), total * sizeof(double)) != 0);
+    // ワーカー数によらず同じ観測値
+    const int workers[] = {1, 2, 3, 4};
+    for (int n : workers) {
+        crlThreadPool pool;
+        CRL_CHECK(pool.init(n));
+        crlPerception per;
+        per.set_seed(42);
+        CRL_CHECK(per.update(world, 3, pool));
+        CRL_CHECK(per.get_total_num() == total);
+        if (per.get_total_num() != total) continue;
+        for (int d = 0; d < 2; d++)
+            CRL_CHECK(std::memcmp(per.rel(d), ref.rel(d), total * sizeof(double)) == 0);
+        // 最も近い相手も観測値から
+        for (int i = 0; i < num; i += 97) {
+            double a[2], b[2];
+            CRL_CHECK(per.nearest(world, i, a) == ref.nearest(world, i, b));
+            CRL_CHECK(a[0] == b[0] && a[1] == b[1]);
+        }
+    }
+}
+
+int main() {
+    test_brute_force(50);   // 疎: 視野内に誰もいないエージェントが多い
+    test_brute_force(3000); // 密
+    test_pool(5000);
+    test_noise(3000);
+    return crl_test_result();
+}